@@ -3,7 +3,6 @@
 
 import functools
 import math
-import fractions
 import random
 random.seed("Seed string")
 
@@ -25,6 +24,12 @@ devices = [
         #( 18, 1000, 0.376, 2000, 1),
         #( 61,  200, 0.376, 1000, 1),
         #(2, 1000, 10, 1000, 0),
+        # PowerBlade advertising scheduler with unchanged data, one packet per
+        #   ADV_INTERVAL_IDLE_MS (50 ms * ADV_FLEET_SIZE, 1 s to 10 s)
+        #( 80, 4000, 0.376, 4000, 0),
+        # same fleet with a tenth of the loads changing, fresh data every 200 ms
+        #( 8,  200, 0.376, 1000, 0),
+        #( 72, 4000, 0.376, 4000, 0),
         ]
 
 # start all devices at the same moment or at a random time in their interval
@@ -76,7 +81,7 @@ for (count, interval, length, data_interval, eddystone) in devices:
         in_eddystones += [0]
 
 # calculate actual GCD of advertising intervals
-iter_step = functools.reduce(fractions.gcd, intervals)
+iter_step = functools.reduce(math.gcd, intervals)
 
 # iterate for duration
 curr_time = 0
@@ -123,7 +128,7 @@ while curr_time < duration:
     transmissions += len(updated_indices)
     successes += len(updated_indices)
     for tx_index in updated_indices:
-        if in_eddystones[index] == 0:
+        if in_eddystones[tx_index] == 0:
             count_per_datas[tx_index] += 1
         for other_index in range(len(times)):
             # don't test against yourself
@@ -143,7 +148,7 @@ while curr_time < duration:
                 # packet collision
                 collisions += 1
                 successes -= 1
-                if in_eddystones[index] == 0:
+                if in_eddystones[tx_index] == 0:
                     count_per_datas[tx_index] -= 1
                 if debug:
                     print("Packet 1: " + str(tx_start_time) + '-' + str(tx_end_time))
@@ -0,0 +1,39 @@
+#ifndef POWERBLADE_ARENA_H_
+#define POWERBLADE_ARENA_H_
+
+#include "powerblade_test.h"
+#include "uart_types.h"
+
+/**************************************************************************
+   ARENA SECTION
+ **************************************************************************/
+// Capture, local calibration, and normal reporting are never active at the
+// same time (see pb_state_t), so their buffers share the UARTLEN bytes of
+// txBuf, split into UARTBLOCK sized blocks.
+//
+//   pb_state                  use
+//   ------------------------  ---------------------------------------------
+//   pb_normal                 block 0: 1Hz reports (adv + add. data)
+//                             ARENA_SPARE on: fast mode record packet
+//   pb_capture, pb_data       all blocks, raw V/I samples
+//   pb_armed                  block 0: 1Hz reports
+//                             blocks 1 and up: pre/post-trigger ring
+//   pb_local1 - pb_local_done block 0 only, calibration sums are scalars
+//
+// Anything kept past block 0 is lost as soon as a capture starts.
+#define ARENA_BLOCKS		(UARTLEN / UARTBLOCK)
+#define ARENA_BLOCK_HDR		(ADLEN + UARTOVHD + 1)	// UART overhead, adv data, data type
+#define ARENA_SPARE			UARTBLOCK				// First byte past block 0
+
+// Compile-time checks, a negative array size fails the build
+#define ARENA_CHECK(name, cond)	typedef char arena_check_##name[(cond) ? 1 : -1]
+
+ARENA_CHECK(blocks, UARTLEN == ARENA_BLOCKS * UARTBLOCK);
+ARENA_CHECK(block_fits, ARENA_BLOCK_HDR + SAMDATA_MAX_LEN <= UARTBLOCK);
+#if defined (ADC8)
+ARENA_CHECK(capture_fits, ARENA_BLOCKS * SAMDATA_MAX_LEN >= 5040);
+#else
+ARENA_CHECK(capture_fits, ARENA_BLOCKS * SAMDATA_MAX_LEN >= 2 * 2520);
+#endif
+
+#endif // POWERBLADE_ARENA_H_
@@ -0,0 +1,25 @@
+#ifndef POWERBLADE_CLOCK_H_
+#define POWERBLADE_CLOCK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblade_test.h"
+
+/**************************************************************************
+   CLOCK GOVERNOR SECTION
+ **************************************************************************/
+// Raise MCLK to 24MHz for heavy work in the main loop and drop it back to
+// 4MHz before sleeping. ISRs that land in between just run faster. Both do
+// nothing unless CLOCK_BOOST is defined
+uint16_t clockBoosts;		// Boosts since reset, for ISS/scope measurements
+
+// While held, SMCLK = MCLK = 24MHz for the backscatter tag and boost and
+// restore leave the clock alone. Sleep in LPM1 meanwhile, LPM3 stops SMCLK
+bool clockHeld;
+
+void clock_boost(void);
+void clock_restore(void);
+void clock_hold(bool hold);
+
+#endif // POWERBLADE_CLOCK_H_
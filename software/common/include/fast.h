@@ -0,0 +1,31 @@
+#ifndef POWERBLADE_FAST_H_
+#define POWERBLADE_FAST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblade_test.h"
+#include "uart_types.h"
+#include "arena.h"
+
+/**************************************************************************
+   FAST REPORTING SECTION
+ **************************************************************************/
+// In fast mode a power record is sent every fastDiv cycles, in addition to
+// the 1Hz packet. Records are short packets with no advertisement data,
+// built in the spare part of the arena so they never touch block 0
+#define FAST_OFFSET			ARENA_SPARE
+#define FAST_MAX_SECONDS	60				// Longest run per START_FAST
+#define FAST_PACKET_LEN		(UARTOVHD + 1 + FAST_DATA_LEN)
+
+bool fastEnabled;
+bool fastEnded;			// Stopped by the time limit or energy guard, nRF not told yet
+
+bool fast_start(uint8_t div, uint8_t seconds);
+void fast_stop(void);
+void fast_cycle(int32_t power, uint32_t voltAmps);
+void fast_send(void);
+void fast_frame(void);
+void fast_second(void);
+
+#endif // POWERBLADE_FAST_H_
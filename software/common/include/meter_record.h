@@ -0,0 +1,22 @@
+#ifndef POWERBLADE_METER_RECORD_H_
+#define POWERBLADE_METER_RECORD_H_
+
+#include <stdint.h>
+
+/**************************************************************************
+   METERING RECORD SECTION
+ **************************************************************************/
+// One second of measurements, same fields and scales as the BLE
+// advertisement (low_power/main.c). The backscatter tag (powerblade/meter.h)
+// carries the same record, so it is kept apart from either radio
+typedef struct {
+	uint32_t sequence;			// Since power on
+	uint32_t scale;
+	uint8_t vrms;
+	uint8_t flags;
+	uint16_t true_power;
+	uint16_t apparent_power;
+	uint32_t watt_hours;
+} meter_t;
+
+#endif // POWERBLADE_METER_RECORD_H_
@@ -109,17 +109,45 @@
 #define ADC_VMIN	0x73
 //#define ADC_VCHG	0xDB
 #define ADC_VCHG	0xC0
+#define ADC_VFAST	0xA0
 #define ADC_VCC2	0x80
 #else
 #define ADC_VMIN	0x1CD
 //#define ADC_VCHG	0xDB
 #define ADC_VCHG	0x302
+#define ADC_VFAST	0x280
 #define ADC_VCC2	0x200
 #endif
 
+// ADC_VFAST (between VMIN and VCHG) ends fast reporting while there is
+//  still margin before the nRF is cut off
 #define V_VCC2		ADC_VCC2
 #define I_VCC2		ADC_VCC2
 
+/**************************************************************************
+   ADC RATE SECTION
+ **************************************************************************/
+// Conversions are scheduled on the TA0 tick. Each channel is converted once
+// every _DIV ticks. V_SENSE is always followed by I_SENSE
+#define ADC_TICK	13		// ACLK ticks, 2520Hz
+#define VCC_DIV		252		// VCC_SENSE at 10Hz, the supercap moves over seconds
+#define VI_DIV		1		// V_SENSE and I_SENSE at 2520Hz (SAMCOUNT per 60Hz cycle)
+
+/**************************************************************************
+   CLOCK SECTION
+ **************************************************************************/
+// MCLK is DCO/2 = 4MHz. Define CLOCK_BOOST to run the per-cycle math and the
+// per-second rollup at the full 24MHz DCO, dropping back before the next
+// sleep. It stays off until clock-compare or a scope shows it saves charge.
+// Timers and the UART run from ACLK, so only MCLK changes. The backscatter
+// tag (UPLINK_GEN2) needs SMCLK at 24MHz while it hears a carrier and holds
+// DIV_HOLD meanwhile
+#define DCO_SLOW	DCOFSEL0 + DCOFSEL1						// 8MHz
+#define DCO_FAST	DCORSEL + DCOFSEL0 + DCOFSEL1			// 24MHz
+#define DIV_SLOW	DIVA_0 + DIVS_1 + DIVM_1				// ACLK = XT1, SMCLK = MCLK = DCO/2
+#define DIV_FAST	DIVA_0 + DIVS_1 + DIVM_0				// MCLK = DCO, SMCLK = DCO/2
+#define DIV_HOLD	DIVA_0 + DIVS_0 + DIVM_0				// SMCLK = MCLK = DCO
+
 /**************************************************************************
    SENSING CONSTANTS SECTION
  **************************************************************************/
@@ -150,7 +178,10 @@
 #define UARTBLOCK	528
 #define ADLEN		19
 #define UARTOVHD	4
-#define RXLEN		30
+#define RXLEN		30			// Fits a batch of messages from the nRF (UART_BATCH_LEN)
+
+// Time to wait for the nRF ready byte after enabling it (ACLK ticks, ~15ms)
+#define NRF_BOOT_TIMEOUT	500
 
 /**************************************************************************
    STATE MACHINE SECTION
@@ -162,7 +193,8 @@ typedef enum {
 	pb_local2,		// Collect integrate samples, calculate curoff_local
 	pb_local3,		// Calculate power, use to calculate pscale_local
 	pb_local_done,	// Local calibration done, write values to config
-	pb_data
+	pb_data,
+	pb_armed		// Triggered capture, storing pre-trigger samples until the trigger fires
 } pb_state_t;
 
 
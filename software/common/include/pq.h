@@ -0,0 +1,40 @@
+#ifndef POWERBLADE_PQ_H_
+#define POWERBLADE_PQ_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**************************************************************************
+   POWER QUALITY SECTION
+ **************************************************************************/
+// Per-cycle Vrms is compared against a slowly tracked nominal. Levels are
+// fractions of nominal in 1/128 units
+#define PQ_SAG			115		// Sag below ~90%
+#define PQ_SAG_END		118		// ...until back above ~92%
+#define PQ_SWELL		141		// Swell above ~110%
+#define PQ_SWELL_END	138		// ...until back below ~108%
+#define PQ_INTERRUPT	13		// Interruption below ~10%
+#define PQ_NOM_SHIFT	8		// Nominal tracks in-band Vrms with a 256 cycle time constant
+#define PQ_WARMUP		60		// Cycles before the nominal is trusted
+#define PQ_LOG_LEN		8
+
+typedef enum {
+	pq_none = 0,
+	pq_sag = 1,
+	pq_swell = 2,
+	pq_interruption = 3
+} pq_type_t;
+
+typedef struct {
+	uint8_t type;		// pq_type_t
+	uint16_t duration;	// Cycles, saturates at 0xFFFF
+	uint16_t extreme;	// Lowest (sag, interruption) or highest (swell) cycle Vrms, unscaled
+	uint32_t sequence;	// Sequence number when the event ended
+} PowerBladePQEvent_t;
+
+void pq_init(void);
+void pq_cycle(uint16_t vrms, uint32_t sequence);
+bool pq_ready(void);
+uint8_t pq_stuff(unsigned int offset);
+
+#endif // POWERBLADE_PQ_H_
@@ -0,0 +1,35 @@
+#ifndef POWERBLADE_SAMPLE_RING_H_
+#define POWERBLADE_SAMPLE_RING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**************************************************************************
+   SAMPLE RING SECTION
+ **************************************************************************/
+// Single producer (ADC ISR), single consumer (main loop) ring of V/I pairs.
+// Each side only writes its own index, so no locking is needed
+#define SAMPLE_RING_LEN		16		// Must be a power of two, at most 128
+#define SAMPLE_RING_MASK	(SAMPLE_RING_LEN - 1)
+
+#if defined (ADC8)
+typedef int8_t sample_t;
+#else
+typedef int16_t sample_t;
+#endif
+
+typedef struct {
+	sample_t voltage;
+	sample_t current;
+} PowerBladeSample_t;
+
+// Ring statistics
+uint16_t ring_overruns;		// Samples dropped because the ring was full, since power on
+uint8_t ring_high_water;	// Most samples ever waiting in the ring
+bool ring_overrun;			// A sample was dropped since this was last cleared
+
+void sample_ring_init(void);
+bool sample_ring_push(sample_t voltage, sample_t current);
+bool sample_ring_pop(sample_t* voltage, sample_t* current);
+
+#endif // POWERBLADE_SAMPLE_RING_H_
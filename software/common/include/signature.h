@@ -0,0 +1,41 @@
+#ifndef POWERBLADE_SIGNATURE_H_
+#define POWERBLADE_SIGNATURE_H_
+
+/**************************************************************************
+   TURN-ON SIGNATURE SECTION
+ **************************************************************************/
+// A turn-on is a per-cycle power step above the running baseline.
+// Power values are per-cycle true power, same scale as true_power
+#define SIG_STEP			150		// ~10W at the default pscale
+#define SIG_BASE_SHIFT		6		// Baseline tracks idle power with a 64 cycle time constant
+#define SIG_SETTLE_SHIFT	4		// Settled when cycle-to-cycle change is under 1/16
+#define SIG_STABLE_CYCLES	4		// ...for this many cycles in a row
+#define SIG_MAX_SETTLE		600		// Give up waiting to settle after 10s and measure anyway
+
+// Current harmonics measured on the first settled cycle (fundamental first)
+#define SIG_BINS			4
+#define SIG_HARMONICS		(SIG_BINS - 1)
+
+typedef enum {
+	sig_idle,
+	sig_settling,		// Tracking inrush peak until power stops changing
+	sig_measure,		// Accumulating harmonics over one settled cycle
+	sig_done			// Waiting to be reported
+} sig_state_t;
+
+typedef struct {
+	uint16_t inrush;					// Peak current magnitude from turn-on to settling
+	uint16_t settle;					// Cycles from turn-on until power settled
+	uint8_t crest;						// Settled current crest factor, 1/32 units
+	uint8_t pf;							// Settled power factor, percent
+	uint8_t harmonics[SIG_HARMONICS];	// 3rd, 5th, 7th current harmonics, percent of fundamental
+	uint16_t power;						// Settled per-cycle true power, unscaled
+} PowerBladeSignature_t;
+
+void signature_init(void);
+void signature_sample(int16_t current, uint8_t phase);
+void signature_cycle(int32_t power, uint16_t irms, uint8_t vrms);
+bool signature_ready(void);
+uint8_t signature_stuff(unsigned int offset);
+
+#endif // POWERBLADE_SIGNATURE_H_
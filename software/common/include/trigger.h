@@ -0,0 +1,38 @@
+#ifndef POWERBLADE_TRIGGER_H_
+#define POWERBLADE_TRIGGER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "arena.h"
+#include "sample_ring.h"
+
+/**************************************************************************
+   TRIGGERED CAPTURE SECTION
+ **************************************************************************/
+// While armed, raw V/I values are written round-robin into arena blocks
+// TRIG_FIRST_BLOCK and up, in the same layout as a sample data download.
+// Once the trigger fires, TRIG_POST more values are stored and the ring is
+// frozen at the next block boundary, so the oldest value starts a block
+#define TRIG_FIRST_BLOCK	1		// Block 0 keeps carrying 1Hz reports while armed
+#define TRIG_BLOCKS			(ARENA_BLOCKS - TRIG_FIRST_BLOCK)
+#define TRIG_PER_BLOCK		(SAMDATA_MAX_LEN / sizeof(sample_t))	// V and I values per block
+#define TRIG_LEN			(TRIG_BLOCKS * TRIG_PER_BLOCK)
+#define TRIG_POST			(6 * TRIG_PER_BLOCK)	// ~300ms after, leaving ~150ms before
+#define TRIG_BASE_SHIFT		6		// Power step baseline time constant, cycles
+
+typedef enum {
+	trig_off = 0,
+	trig_didt = 1,		// Any raw current sample (di/dt, before integration) above threshold
+	trig_power = 2		// Per-cycle true power step above baseline, same scale as true_power
+} trig_mode_t;
+
+bool trigger_arm(uint8_t mode, uint16_t threshold);
+void trigger_store(sample_t value, bool isCurrent);
+void trigger_current(sample_t current);
+void trigger_cycle(int32_t power);
+bool trigger_done(void);
+unsigned int trigger_first_block(void);
+uint16_t trigger_position(void);
+
+#endif // POWERBLADE_TRIGGER_H_
@@ -2,8 +2,11 @@
 #define POWERBLADE_UART_H_
 
 #include "powerblade_test.h"
+#include "arena.h"
 
+// Transmit buffer, shared by the modes as laid out in arena.h
 char txBuf[UARTLEN];
+
 char captureType;
 char captureBuf[RXLEN - 4];
 
@@ -11,10 +14,15 @@ char rxBuf[RXLEN];
 int rxCt;
 int savedCount;
 
+// nRF boot handshake
+bool nordicWaiting;
+bool nordicReady;
+
 void uart_init(void);
 void uart_enable(bool enable);
 void uart_stuff(unsigned int offset, char* srcbuf, unsigned int len);
 void uart_send(int offset, uint16_t uart_len);
+bool uart_busy(void);
 
 int processMessage(void);
 
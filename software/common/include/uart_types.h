@@ -11,6 +11,7 @@
 #define GET_CONF        0x10
 #define SET_CONF        0x11
 #define GET_VER         0x12
+#define GET_STATS       0x13
 #define SET_SEQ         0x1C
 #define CLR_WH          0x1D
 #define START_SAMDATA   0x20
@@ -19,13 +20,40 @@
 #define START_LOCALC	0x23
 #define CONT_LOCALC		0x24
 #define DONE_LOCALC		0x25
+#define START_TRIGGER	0x26
+#define DONE_TRIGGER	0x27
+#define START_FAST		0x28
+#define FAST_DATA		0x29
+#define DONE_FAST		0x2A
+#define EVENT_SIG		0x30
+#define EVENT_PQ		0x31
 #define UART_NAK        0xFF
+#define UART_READY      0xFE    // unframed byte from nRF once booted
 
 
 /**************************************************************************
    UART DATA LENGTHS SECTION
  **************************************************************************/
 #define SAMDATA_MAX_LEN 504
+#define EVENT_SIG_LEN   11
+#define EVENT_PQ_LEN    15
+#define STATS_LEN       7
+#define START_TRIGGER_LEN 3
+#define DONE_TRIGGER_LEN 2
+#define START_FAST_LEN  2
+#define FAST_DATA_LEN   6
+
+
+/**************************************************************************
+   UART BATCH SECTION
+ **************************************************************************/
+// From this MSP software version (low four bits of the advertised flags) the
+// nRF may send several messages back to back in one window, up to
+// UART_BATCH_LEN bytes in all. The MSP handles them in order and puts each
+// reply after the last in the same packet, so a reply item's length is set
+// by its type. Sample blocks (CONT_SAMDATA) fill the packet and end it
+#define UART_BATCH_VERSION  5
+#define UART_BATCH_LEN      30
 
 
 /**************************************************************************
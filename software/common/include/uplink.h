@@ -0,0 +1,37 @@
+#ifndef POWERBLADE_UPLINK_H_
+#define POWERBLADE_UPLINK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "meter_record.h"
+
+/**************************************************************************
+   UPLINK SECTION
+ **************************************************************************/
+// Each second's record goes out over one radio. uplink_nrf boots the nRF
+// and sends it the UART frame transmit() builds, to advertise over BLE.
+// With UPLINK_GEN2 the image also carries the backscatter tag
+// (powerblade/tag.c), which puts the record in its EPC and user memory for
+// any Gen2 reader about, for microwatts instead of the nRF's milliwatts.
+// Both use eUSCI_A0 on P2.0 and P2.1, so one runs at a time
+typedef enum {
+	uplink_nrf,
+	uplink_gen2
+} uplink_t;
+
+#define UPLINK_READ_HOLD	5		// Seconds a reader counts as there after it last read the EPC
+#define UPLINK_PROBE		30		// Seconds on the nRF between one second listens for a reader
+
+uplink_t uplink;
+meter_t uplink_rec;			// Record in the next nRF frame
+
+// nRF state, the boot handshake is in uart.c
+bool nordicRunning;			// nRF has booted since it was last powered on
+uint16_t sendCount;			// Frames waiting for the main loop to send
+
+void uplink_init(void);
+void uplink_second(const meter_t* rec, bool nrf_ok, bool extra);
+void uplink_nrf_off(void);
+
+#endif // POWERBLADE_UPLINK_H_
@@ -0,0 +1,47 @@
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblade_test.h"
+#include "clock.h"
+
+// CSCTL0 is left unlocked by main(). The DCO range is switched while MCLK is
+// still divided by 2, so MCLK never goes above 24MHz in between. The FR57xx
+// FRAM controller adds its own wait states above 8MHz
+void clock_boost(void) {
+#if defined (CLOCK_BOOST)
+	__disable_interrupt();
+	if(!clockHeld) {
+		CSCTL1 = DCO_FAST;
+		CSCTL3 = DIV_FAST;
+		clockBoosts++;
+	}
+	__enable_interrupt();
+#endif
+}
+
+void clock_restore(void) {
+#if defined (CLOCK_BOOST)
+	__disable_interrupt();
+	if(!clockHeld) {
+		CSCTL3 = DIV_SLOW;
+		CSCTL1 = DCO_SLOW;
+	}
+	__enable_interrupt();
+#endif
+}
+
+// The tag's ISRs hold and release the clock as the carrier comes and goes,
+// so boost and restore check the hold with interrupts off. Same order as
+// above, MCLK is divided by 2 whenever the DCO range changes
+void clock_hold(bool hold) {
+	clockHeld = hold;
+	if(hold) {
+		CSCTL1 = DCO_FAST;
+		CSCTL3 = DIV_HOLD;
+	}
+	else {
+		CSCTL3 = DIV_SLOW;
+		CSCTL1 = DCO_SLOW;
+	}
+}
@@ -0,0 +1,108 @@
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblade_test.h"
+#include "fast.h"
+#include "uart.h"
+#include "uart_types.h"
+
+ARENA_CHECK(fast_fits, FAST_OFFSET + FAST_PACKET_LEN <= UARTLEN);
+
+uint8_t fastDiv;			// Cycles per record
+uint8_t fastCount;
+uint8_t fastSeconds;		// Seconds left
+uint16_t fastRecord;		// Record number since START_FAST, lets the client spot gaps
+int32_t fastPower;
+uint32_t fastVoltAmps;
+bool fastPending;			// Record built, waiting for the UART
+bool fastSending;			// Last packet handed to the UART was a record
+
+bool fast_start(uint8_t div, uint8_t seconds) {
+	if(div == 0 || div > 60 || seconds == 0) {
+		return 0;
+	}
+	fastDiv = div;
+	fastSeconds = (seconds > FAST_MAX_SECONDS) ? FAST_MAX_SECONDS : seconds;
+	fastCount = 0;
+	fastRecord = 0;
+	fastPower = 0;
+	fastVoltAmps = 0;
+	fastPending = 0;
+	fastSending = 0;
+	fastEnded = 0;
+	fastEnabled = 1;
+	return 1;
+}
+
+void fast_stop(void) {
+	if(fastEnabled) {
+		fastEnabled = 0;
+		fastPending = 0;
+		fastEnded = 1;
+	}
+}
+
+// Called once per cycle with that cycle's true power and Irms*Vrms
+void fast_cycle(int32_t power, uint32_t voltAmps) {
+	if(!fastEnabled) {
+		return;
+	}
+	fastPower += power;
+	fastVoltAmps += voltAmps;
+	if(++fastCount < fastDiv) {
+		return;
+	}
+
+	// Average over the record, same units as the advertised values
+	uint16_t truePowerFast = (fastPower > 0) ? (uint16_t)(fastPower / fastDiv) : 0;
+	uint16_t apparentPowerFast = (uint16_t)(fastVoltAmps / fastDiv);
+	if(apparentPowerFast < truePowerFast) {
+		apparentPowerFast = truePowerFast;
+	}
+	fastCount = 0;
+	fastPower = 0;
+	fastVoltAmps = 0;
+
+	// Never rewrite a record the UART is still sending, skip this one instead.
+	//  A record still waiting on the UART is replaced. Either way the gap
+	//  shows in fastRecord
+	if(fastSending && uart_busy()) {
+		fastRecord++;
+		return;
+	}
+
+	uint16_t fastLen = FAST_PACKET_LEN;
+	uint8_t adLen = 0;
+	char data_type = FAST_DATA;
+	uart_stuff(FAST_OFFSET + OFFSET_UARTLEN, (char*) &fastLen, sizeof(fastLen));
+	uart_stuff(FAST_OFFSET + OFFSET_ADLEN, (char*) &adLen, sizeof(adLen));
+	uart_stuff(FAST_OFFSET + 3, &data_type, sizeof(data_type));
+	uart_stuff(FAST_OFFSET + 4, (char*) &fastRecord, sizeof(fastRecord));
+	uart_stuff(FAST_OFFSET + 6, (char*) &truePowerFast, sizeof(truePowerFast));
+	uart_stuff(FAST_OFFSET + 8, (char*) &apparentPowerFast, sizeof(apparentPowerFast));
+	fastRecord++;
+	fastPending = 1;
+}
+
+// Called for every sample, sends a waiting record once the UART is free
+void fast_send(void) {
+	if(fastPending && !uart_busy()) {
+		fastPending = 0;
+		fastSending = 1;
+		uart_send(FAST_OFFSET, FAST_PACKET_LEN);
+	}
+}
+
+// Called before any other packet is handed to the UART. Records built while
+// it goes out are queued rather than skipped
+void fast_frame(void) {
+	fastSending = 0;
+}
+
+// Called once per second, enforces the time limit
+void fast_second(void) {
+	if(fastEnabled && --fastSeconds == 0) {
+		fast_stop();
+	}
+}
@@ -0,0 +1,132 @@
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblade_test.h"
+#include "pq.h"
+#include "uart.h"
+#include "uart_types.h"
+
+// Event totals and the most recent events survive power loss
+#pragma PERSISTENT(pq_counts)
+uint16_t pq_counts[3] = {0, 0, 0};		// Sags, swells, interruptions
+#pragma PERSISTENT(pq_log)
+PowerBladePQEvent_t pq_log[PQ_LOG_LEN] = {{0}};
+#pragma PERSISTENT(pq_log_next)
+uint8_t pq_log_next = 0;
+#pragma PERSISTENT(pq_unreported)
+uint8_t pq_unreported = 0;				// Newest log entries not yet sent
+
+uint32_t pq_nominal;		// Nominal Vrms, 8 fractional bits
+uint8_t pq_warmup;
+pq_type_t pq_state;
+uint16_t pq_duration;
+uint16_t pq_extreme;
+
+void pq_init(void) {
+	pq_nominal = 0;
+	pq_warmup = 0;
+	pq_state = pq_none;
+}
+
+static void pq_end(uint32_t sequence) {
+	PowerBladePQEvent_t* entry = &pq_log[pq_log_next];
+	entry->type = pq_state;
+	entry->duration = pq_duration;
+	entry->extreme = pq_extreme;
+	entry->sequence = sequence;
+
+	if(pq_counts[pq_state - 1] < 0xFFFF) {
+		pq_counts[pq_state - 1]++;
+	}
+	pq_log_next = (pq_log_next + 1) % PQ_LOG_LEN;
+	if(pq_unreported < PQ_LOG_LEN) {
+		pq_unreported++;
+	}
+	pq_state = pq_none;
+}
+
+// Called once per cycle with that cycle's Vrms
+void pq_cycle(uint16_t vrms, uint32_t sequence) {
+	if(pq_warmup < PQ_WARMUP) {
+		// Start the nominal from the first cycles rather than from zero
+		pq_warmup++;
+		pq_nominal = (pq_warmup == 1) ? ((uint32_t)vrms << 8) : pq_nominal + ((((int32_t)vrms << 8) - (int32_t)pq_nominal) >> 3);
+		return;
+	}
+
+	// Compare vrms*128 against nominal*level, both with 8 fractional bits
+	uint32_t level = (uint32_t)vrms << 15;
+	uint32_t nom = pq_nominal;
+
+	switch(pq_state) {
+	case pq_none:
+		if(level < nom * PQ_INTERRUPT) {
+			pq_state = pq_interruption;
+		}
+		else if(level < nom * PQ_SAG) {
+			pq_state = pq_sag;
+		}
+		else if(level > nom * PQ_SWELL) {
+			pq_state = pq_swell;
+		}
+		else {
+			pq_nominal += (((int32_t)vrms << 8) - (int32_t)pq_nominal) >> PQ_NOM_SHIFT;
+			break;
+		}
+		pq_duration = 1;
+		pq_extreme = vrms;
+		break;
+	case pq_sag:
+	case pq_interruption:
+		if(level >= nom * PQ_SAG_END) {
+			pq_end(sequence);
+			break;
+		}
+		if(level < nom * PQ_INTERRUPT) {		// A sag that keeps dropping is an interruption
+			pq_state = pq_interruption;
+		}
+		if(vrms < pq_extreme) {
+			pq_extreme = vrms;
+		}
+		if(pq_duration < 0xFFFF) {
+			pq_duration++;
+		}
+		break;
+	case pq_swell:
+		if(level <= nom * PQ_SWELL_END) {
+			pq_end(sequence);
+			break;
+		}
+		if(vrms > pq_extreme) {
+			pq_extreme = vrms;
+		}
+		if(pq_duration < 0xFFFF) {
+			pq_duration++;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+bool pq_ready(void) {
+	return pq_unreported > 0;
+}
+
+// Stuff the oldest unreported event and the totals into txBuf at offset.
+// Returns length
+uint8_t pq_stuff(unsigned int offset) {
+	PowerBladePQEvent_t* entry = &pq_log[(pq_log_next + PQ_LOG_LEN - pq_unreported) % PQ_LOG_LEN];
+	uart_stuff(offset, (char*) &entry->type, sizeof(entry->type));
+	uart_stuff(offset + 1, (char*) &entry->duration, sizeof(entry->duration));
+	uart_stuff(offset + 3, (char*) &entry->extreme, sizeof(entry->extreme));
+	uart_stuff(offset + 5, (char*) &entry->sequence, sizeof(entry->sequence));
+	int i;
+	for(i = 0; i < 3; i++) {
+		uart_stuff(offset + 9 + 2*i, (char*) &pq_counts[i], sizeof(pq_counts[i]));
+	}
+
+	pq_unreported--;
+	return EVENT_PQ_LEN;
+}
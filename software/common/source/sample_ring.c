@@ -0,0 +1,57 @@
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sample_ring.h"
+
+typedef char sample_ring_len_check[((SAMPLE_RING_LEN & SAMPLE_RING_MASK) == 0 && SAMPLE_RING_LEN <= 128) ? 1 : -1];
+
+PowerBladeSample_t ring[SAMPLE_RING_LEN];
+
+// Free-running indices, masked on access. Their difference is the fill level
+volatile uint8_t ringWrite;		// Only written by the producer
+volatile uint8_t ringRead;		// Only written by the consumer
+
+void sample_ring_init(void) {
+	ringWrite = 0;
+	ringRead = 0;
+	ring_overruns = 0;
+	ring_high_water = 0;
+	ring_overrun = 0;
+}
+
+// Called from the ADC ISR. If the main loop has fallen a full ring behind the
+// new sample is dropped so the samples already waiting stay consistent
+bool sample_ring_push(sample_t voltage, sample_t current) {
+	uint8_t fill = (uint8_t)(ringWrite - ringRead);
+	if(fill >= SAMPLE_RING_LEN) {
+		if(ring_overruns < 0xFFFF) {
+			ring_overruns++;
+		}
+		ring_overrun = 1;
+		return 0;
+	}
+
+	PowerBladeSample_t* slot = &ring[ringWrite & SAMPLE_RING_MASK];
+	slot->voltage = voltage;
+	slot->current = current;
+	ringWrite++;
+
+	if(fill + 1 > ring_high_water) {
+		ring_high_water = fill + 1;
+	}
+	return 1;
+}
+
+// Called from the main loop, returns 0 once the ring is empty
+bool sample_ring_pop(sample_t* voltage, sample_t* current) {
+	if(ringRead == ringWrite) {
+		return 0;
+	}
+
+	PowerBladeSample_t* slot = &ring[ringRead & SAMPLE_RING_MASK];
+	*voltage = slot->voltage;
+	*current = slot->current;
+	ringRead++;
+	return 1;
+}
@@ -0,0 +1,168 @@
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblade_test.h"
+#include "signature.h"
+#include "uart.h"
+#include "uart_types.h"
+
+// Defined in main.c
+uint32_t SquareRoot64(uint64_t a_nInput);
+
+// One cycle of cos/sin at SAMCOUNT samples per cycle, scaled by 127
+static const int8_t sig_cos[SAMCOUNT] = {
+	127, 126, 121, 114, 105, 93, 79, 64, 46, 28, 9, -9, -28, -46,
+	-63, -79, -93, -105, -114, -121, -126, -127, -126, -121, -114, -105, -93, -79,
+	-64, -46, -28, -9, 9, 28, 46, 63, 79, 93, 105, 114, 121, 126
+};
+static const int8_t sig_sin[SAMCOUNT] = {
+	0, 19, 37, 55, 72, 86, 99, 110, 118, 124, 127, 127, 124, 118,
+	110, 99, 86, 72, 55, 37, 19, 0, -19, -37, -55, -72, -86, -99,
+	-110, -118, -124, -127, -127, -124, -118, -110, -99, -86, -72, -55, -37, -19
+};
+static const uint8_t sig_bin[SIG_BINS] = {1, 3, 5, 7};
+
+sig_state_t sig_state;
+PowerBladeSignature_t sig;
+
+int32_t sig_baseline;		// Idle per-cycle power
+int32_t sig_prev;			// Last cycle power while settling
+uint16_t sig_cycles;		// Cycles since turn-on
+uint8_t sig_stable;			// Consecutive settled cycles
+uint16_t sig_peak;			// Peak current magnitude in the current cycle
+
+// Harmonic accumulators, only used in sig_measure
+int32_t sig_re[SIG_BINS];
+int32_t sig_im[SIG_BINS];
+
+void signature_init(void) {
+	sig_state = sig_idle;
+	sig_baseline = 0;
+	sig_peak = 0;
+}
+
+// Called for every sample with the offset-corrected, integrated current and
+// its position (0 to SAMCOUNT-1) within the current cycle
+void signature_sample(int16_t current, uint8_t phase) {
+	uint16_t mag = (current < 0) ? -current : current;
+	if(mag > sig_peak) {
+		sig_peak = mag;
+	}
+
+	if(sig_state == sig_measure) {
+		int i;
+		for(i = 0; i < SIG_BINS; i++) {
+			uint8_t index = (uint8_t)(((uint16_t)sig_bin[i] * phase) % SAMCOUNT);
+			sig_re[i] += (int32_t)current * sig_cos[index];
+			sig_im[i] += (int32_t)current * sig_sin[index];
+		}
+	}
+}
+
+static uint32_t signature_mag(int i) {
+	int32_t re = sig_re[i] >> 7;
+	int32_t im = sig_im[i] >> 7;
+	return SquareRoot64((uint64_t)((int64_t)re * re) + (uint64_t)((int64_t)im * im));
+}
+
+static void signature_finish(int32_t power, uint16_t irms, uint8_t vrms) {
+	// Crest factor and power factor of the settled cycle
+	uint32_t crest = irms ? (((uint32_t)sig_peak << 5) / irms) : 0;
+	sig.crest = (crest > 0xFF) ? 0xFF : (uint8_t)crest;
+	uint32_t va = (uint32_t)irms * vrms;
+	uint32_t pf = (va && power > 0) ? ((uint32_t)power * 100 / va) : 0;
+	sig.pf = (pf > 100) ? 100 : (uint8_t)pf;
+	sig.power = (power > 0) ? (uint16_t)power : 0;
+
+	// Harmonics as a percentage of the fundamental
+	uint32_t fund = signature_mag(0);
+	int i;
+	for(i = 1; i < SIG_BINS; i++) {
+		uint32_t pct = fund ? (signature_mag(i) * 100 / fund) : 0;
+		sig.harmonics[i-1] = (pct > 0xFF) ? 0xFF : (uint8_t)pct;
+	}
+}
+
+// Called once per cycle with that cycle's true power, Irms, and Vrms
+void signature_cycle(int32_t power, uint16_t irms, uint8_t vrms) {
+	switch(sig_state) {
+	case sig_idle:
+		if(power - sig_baseline > SIG_STEP) {		// Turn-on
+			sig_state = sig_settling;
+			sig.inrush = sig_peak;
+			sig_cycles = 0;
+			sig_stable = 0;
+			sig_prev = power;
+		}
+		else {
+			sig_baseline += (power - sig_baseline) >> SIG_BASE_SHIFT;
+		}
+		break;
+	case sig_settling:
+	{
+		sig_cycles++;
+		if(sig_peak > sig.inrush) {
+			sig.inrush = sig_peak;
+		}
+
+		if(power - sig_baseline < (SIG_STEP >> 1)) {	// Turned back off, not an event
+			sig_state = sig_idle;
+			break;
+		}
+
+		int32_t delta = power - sig_prev;
+		if(delta < 0) {
+			delta = -delta;
+		}
+		sig_prev = power;
+		if(delta < (power >> SIG_SETTLE_SHIFT)) {
+			sig_stable++;
+		}
+		else {
+			sig_stable = 0;
+		}
+
+		if(sig_stable >= SIG_STABLE_CYCLES || sig_cycles >= SIG_MAX_SETTLE) {
+			sig.settle = sig_cycles - sig_stable;
+			int i;
+			for(i = 0; i < SIG_BINS; i++) {
+				sig_re[i] = 0;
+				sig_im[i] = 0;
+			}
+			sig_state = sig_measure;
+		}
+		break;
+	}
+	case sig_measure:
+		signature_finish(power, irms, vrms);
+		sig_baseline = power;
+		sig_state = sig_done;
+		break;
+	case sig_done:
+	default:
+		break;
+	}
+
+	sig_peak = 0;
+}
+
+bool signature_ready(void) {
+	return sig_state == sig_done;
+}
+
+// Stuff the signature into txBuf at offset and release it. Returns length
+uint8_t signature_stuff(unsigned int offset) {
+	uart_stuff(offset, (char*) &sig.inrush, sizeof(sig.inrush));
+	uart_stuff(offset + 2, (char*) &sig.settle, sizeof(sig.settle));
+	uart_stuff(offset + 4, (char*) &sig.crest, sizeof(sig.crest));
+	uart_stuff(offset + 5, (char*) &sig.pf, sizeof(sig.pf));
+	int i;
+	for(i = 0; i < SIG_HARMONICS; i++) {
+		uart_stuff(offset + 6 + i, (char*) &sig.harmonics[i], sizeof(sig.harmonics[i]));
+	}
+	uart_stuff(offset + 6 + SIG_HARMONICS, (char*) &sig.power, sizeof(sig.power));
+
+	sig_state = sig_idle;
+	return EVENT_SIG_LEN;
+}
@@ -0,0 +1,128 @@
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblade_test.h"
+#include "trigger.h"
+#include "uart.h"
+
+ARENA_CHECK(trig_post, TRIG_POST < TRIG_LEN && (TRIG_PER_BLOCK & 1) == 0);
+
+trig_mode_t trigMode;
+uint16_t trigThreshold;
+
+volatile unsigned int trigIndex;	// Next value in the ring, 0 to TRIG_LEN-1
+unsigned int trigBlock;				// Arena block and byte offset of trigIndex
+unsigned int trigOffset;
+unsigned int trigFill;				// Values stored since arming, saturates at the pre-trigger length
+volatile bool trigFired;
+volatile unsigned int trigAt;		// trigIndex when the trigger fired
+unsigned int trigPost;				// Values left to store after the trigger
+volatile bool trigDone;
+
+int32_t trigBaseline;
+bool trigBaselineValid;
+
+bool trigger_arm(uint8_t mode, uint16_t threshold) {
+	if(mode != trig_didt && mode != trig_power) {
+		return 0;
+	}
+	trigMode = (trig_mode_t)mode;
+	trigThreshold = threshold;
+
+	trigIndex = 0;
+	trigBlock = TRIG_FIRST_BLOCK;
+	trigOffset = 0;
+	trigFill = 0;
+	trigFired = 0;
+	trigPost = TRIG_POST;
+	trigDone = 0;
+	trigBaselineValid = 0;
+	return 1;
+}
+
+static void trigger_fire(void) {
+	// Only fire once the pre-trigger window has been filled
+	if(!trigFired && trigFill >= TRIG_LEN - TRIG_POST) {
+		trigAt = trigIndex;
+		trigFired = 1;
+	}
+}
+
+// Called from the ADC ISR with each raw V and I value while armed. V goes to
+// even and I to odd positions, so arming mid-pair skips to the next V
+void trigger_store(sample_t value, bool isCurrent) {
+	if(trigDone || isCurrent != (trigIndex & 1)) {
+		return;
+	}
+
+	uart_stuff(trigBlock*UARTBLOCK + OFFSET_DATATYPE + 1 + trigOffset, (char*) &value, sizeof(value));
+
+	trigIndex++;
+	trigOffset += sizeof(value);
+	if(trigOffset == SAMDATA_MAX_LEN) {
+		trigOffset = 0;
+		trigBlock++;
+		if(trigBlock == ARENA_BLOCKS) {
+			trigBlock = TRIG_FIRST_BLOCK;
+			trigIndex = 0;
+		}
+	}
+	if(trigFill < TRIG_LEN - TRIG_POST) {
+		trigFill++;
+	}
+
+	// Freeze as soon as the post window is stored and a block is complete.
+	// Checking only on the next value would store it over the oldest block
+	if(trigFired) {
+		if(trigPost > 0) {
+			trigPost--;
+		}
+		if(trigPost == 0 && trigOffset == 0) {
+			trigDone = 1;
+		}
+	}
+}
+
+// Called from the ADC ISR with the offset-corrected raw current. The current
+// sensor measures di/dt, so a large raw sample is a fast current change
+void trigger_current(sample_t current) {
+	if(trigMode == trig_didt) {
+		uint16_t mag = (current < 0) ? -current : current;
+		if(mag > trigThreshold) {
+			trigger_fire();
+		}
+	}
+}
+
+// Called once per cycle with that cycle's true power. The samples making up
+// this cycle may still be a few ring entries behind trigIndex
+void trigger_cycle(int32_t power) {
+	if(trigMode != trig_power) {
+		return;
+	}
+	if(!trigBaselineValid) {
+		trigBaseline = power;
+		trigBaselineValid = 1;
+	}
+	if(power - trigBaseline > (int32_t)trigThreshold) {
+		trigger_fire();
+	}
+	else if(!trigFired) {
+		trigBaseline += (power - trigBaseline) >> TRIG_BASE_SHIFT;
+	}
+}
+
+bool trigger_done(void) {
+	return trigDone;
+}
+
+// Block holding the oldest value, the first to download
+unsigned int trigger_first_block(void) {
+	return TRIG_FIRST_BLOCK + trigIndex / TRIG_PER_BLOCK;
+}
+
+// Values from the start of the download to the trigger
+uint16_t trigger_position(void) {
+	return (uint16_t)((trigAt + TRIG_LEN - trigIndex) % TRIG_LEN);
+}
@@ -3,18 +3,20 @@
 #include <stdbool.h>
 
 #include "uart.h"
+#include "uart_types.h"
 #include "checksum.h"
 
 //void uart_send(char* buf, unsigned int len);
-char* txBufSave;
-unsigned int txLen;
-int txCt;
+// Kept to this file, the backscatter tag has its own reply length (UPLINK_GEN2)
+static char* txBufSave;
+static unsigned int txLen;
+static int txCt;
 
 int capCt;
 
 void uart_init(void) {
 	UCA0CTL1 |= UCSWRST;						// Put UART into reset
-	UCA0CTL1 |= UCSSEL_1;						// Set to SMCLK
+	UCA0CTL1 |= UCSSEL_1;						// Set to ACLK, baud rate holds while MCLK is scaled
 	UCA0BR0 = 3;								// Baud configuration for 9600
 	UCA0BR1 = 0;
 	UCA0MCTLW = 0x9200;
@@ -30,6 +32,8 @@ void uart_init(void) {
 	// Initialize UART receive count
 	rxCt = 0;
 	savedCount = 0;
+	nordicWaiting = 0;
+	nordicReady = 0;
 }
 
 void uart_enable(bool enable) {
@@ -61,14 +65,21 @@ void uart_send(int offset, uint16_t uart_len) {
 	UCA0TXBUF = txBufSave[txCt++];
 }
 
+// True until the last byte of the current transmission has left
+bool uart_busy(void) {
+	return (UCA0IE & (UCTXIE + UCTXCPTIE)) != 0;
+}
+
+// Takes the first message in rxBuf. The nRF may send several back to back
+// in one window (UART_BATCH_VERSION), the rest are kept for the next call
 int processMessage(void) {
 	// Check if message is long enough
 	if(rxCt <= 2) {
 		return 0;
 	}
 
-	// Capture rx length
-	int rxLen = (rxBuf[0] << 8) + rxBuf[1];
+	// Capture rx length, rxBuf is char (signed) so take the bytes unsigned
+	int rxLen = ((uint8_t)rxBuf[0] << 8) + (uint8_t)rxBuf[1];
 
 	// Check if we have received the entire message
 	if(rxLen > rxCt) {
@@ -77,7 +88,7 @@ int processMessage(void) {
 
 	int rxIndex;
 	capCt = 0;
-	if(additive_checksum((uint8_t*)rxBuf, rxLen - 1) == rxBuf[rxLen - 1]){
+	if(rxLen >= UARTOVHD && additive_checksum((uint8_t*)rxBuf, rxLen - 1) == (uint8_t)rxBuf[rxLen - 1]){
 
 		captureType = rxBuf[2];
 
@@ -85,21 +96,43 @@ int processMessage(void) {
 		for(rxIndex = 3; rxIndex < (rxLen-1); rxIndex++){
 			captureBuf[capCt++] = rxBuf[rxIndex];
 		}
+
+		// Move any later messages to the front
+		__disable_interrupt();
+		for(rxIndex = rxLen; rxIndex < rxCt; rxIndex++) {
+			rxBuf[rxIndex - rxLen] = rxBuf[rxIndex];
+		}
+		rxCt -= rxLen;
+		__enable_interrupt();
+	}
+	else {
+		rxCt = 0;							// Later messages can't be framed either
 	}
-	rxCt = 0;
 
 	return capCt + 1;
 }
 
 #pragma vector=USCI_A0_VECTOR
 __interrupt void USCI_A0_ISR(void) {
+	uint8_t rxByte;
 
 	switch (__even_in_range(UCA0IV, 8)) {
 	case 0:
 		break;								// No interrupt
 	case 2: 								// RX interrupt
 		P1OUT |= (BIT2 + BIT3);
-		rxBuf[rxCt++] = UCA0RXBUF;
+		rxByte = UCA0RXBUF;
+		if(rxCt == 0 && rxByte == UART_READY) {	// Can never start a message (length < 256)
+			if(nordicWaiting) {
+				TA1CCTL0 = 0;					// Cancel the boot timeout
+				nordicWaiting = 0;
+				nordicReady = 1;
+				__bic_SR_register_on_exit(LPM3_bits);
+			}
+		}
+		else if(rxCt < RXLEN) {
+			rxBuf[rxCt++] = rxByte;
+		}
 		P1OUT &= ~(BIT2 + BIT3);
 		break;
 	case 4:									// TX interrupt
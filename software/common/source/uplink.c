@@ -0,0 +1,124 @@
+#include <msp430.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "powerblade_test.h"
+#include "uart.h"
+#include "uplink.h"
+
+#if defined (UPLINK_GEN2)
+#include "meter.h"
+#include "tag.h"
+
+static uint16_t readsLast;
+static uint8_t readAge;			// Seconds since the tag last sent its EPC, up to UPLINK_READ_HOLD
+static uint8_t probeCount;
+#endif
+
+// Starts on the nRF. The tag is set up here (it seeds its RNG from the
+// ADC), so this runs before the ADC is set up for sensing
+void uplink_init(void) {
+	uplink = uplink_nrf;
+	nordicRunning = 0;
+	sendCount = 0;
+#if defined (UPLINK_GEN2)
+	tag_init();
+	readsLast = 0;
+	readAge = UPLINK_READ_HOLD;
+	probeCount = 0;
+#endif
+}
+
+#if defined (UPLINK_GEN2)
+// Cheapest radio that can carry this second. The nRF if the frame carries
+// more than the record, as replies to its commands, events and captures
+// only go that way, or if it is still sending. Otherwise the tag while a
+// reader has read it lately and the nRF when none has, with the tag
+// listening for a second every UPLINK_PROBE in case one has come along.
+// The tag alone when the supply is too low for the nRF
+static uplink_t uplink_choose(bool nrf_ok, bool extra) {
+	if(tag_reads != readsLast) {
+		readsLast = tag_reads;
+		readAge = 0;
+	}
+	else if(readAge < UPLINK_READ_HOLD) {
+		readAge++;
+	}
+
+	if(!nrf_ok) {
+		return uplink_gen2;
+	}
+	if(extra || (uplink == uplink_nrf && uart_busy())) {
+		return uplink_nrf;
+	}
+	if(readAge < UPLINK_READ_HOLD) {
+		probeCount = 0;
+		return uplink_gen2;
+	}
+	if(uplink == uplink_nrf && ++probeCount >= UPLINK_PROBE) {
+		probeCount = 0;
+		return uplink_gen2;
+	}
+	return uplink_nrf;
+}
+
+// Hand eUSCI_A0 and its pins over. The nRF is off while the tag runs
+static void uplink_select(uplink_t link) {
+	if(link == uplink) {
+		return;
+	}
+	if(link == uplink_gen2) {
+		uplink_nrf_off();
+		sendCount = 0;
+		uplink = uplink_gen2;
+		tag_start();
+	}
+	else {
+		tag_stop();
+		uplink = uplink_nrf;
+		uart_init();
+	}
+}
+#endif
+
+// Send this second's record. nrf_ok is the supply being up to running the
+// nRF, extra the UART frame carrying more than the record
+void uplink_second(const meter_t* rec, bool nrf_ok, bool extra) {
+#if defined (UPLINK_GEN2)
+	uplink_select(uplink_choose(nrf_ok, extra));
+	if(uplink == uplink_gen2) {
+		meter_set(rec);						// Staged into the EPC while the tag is idle
+		return;
+	}
+#endif
+	if(!nrf_ok) {
+		return;
+	}
+	uplink_rec = *rec;
+
+	// Boot the nordic and enable its UART
+	SYS_EN_OUT &= ~SYS_EN_PIN;
+	uart_enable(1);
+
+	if(nordicRunning) {
+		// Already booted and listening, send right away
+		sendCount++;
+	}
+	else {
+		// Wait for the ready byte, falling back to the boot delay
+		nordicWaiting = 1;
+		TA1CCR0 = TA1R + NRF_BOOT_TIMEOUT;
+		TA1CCTL0 = CCIE;
+	}
+}
+
+// Power the nRF down, and let go of its UART pins unless the tag has them
+void uplink_nrf_off(void) {
+	if(uplink == uplink_nrf) {
+		uart_enable(0);
+	}
+	SYS_EN_OUT |= SYS_EN_PIN;
+	nordicRunning = 0;
+	nordicWaiting = 0;
+	TA1CCTL0 = 0;
+}
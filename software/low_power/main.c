@@ -23,12 +23,20 @@
 #include "uart_types.h"
 #include "checksum.h"
 #include "uart.h"
+#include "signature.h"
+#include "sample_ring.h"
+#include "trigger.h"
+#include "pq.h"
+#include "fast.h"
+#include "clock.h"
+#include "uplink.h"
 
 //#define NORDICDEBUG
 
 // Transmission variables
 bool ready;
 bool senseEnabled;
+volatile bool fastLowVcc;		// Set by the ADC ISR, fast mode is stopped from the main loop
 
 // Variable for integration
 int16_t agg_current;
@@ -38,23 +46,23 @@ int16_t agg_current_local;
 uint8_t sampleCount;
 uint8_t measCount;
 
-// Global variables used interrupt-to-interrupt
-#define BACKLOG_LEN		16
-#if defined (ADC8)
-int8_t current[BACKLOG_LEN];
-int8_t voltage[BACKLOG_LEN];
-int8_t savedCurrent;
-int8_t savedVoltage;
-#else
-int16_t current[BACKLOG_LEN];
-int16_t voltage[BACKLOG_LEN];
-int16_t savedCurrent;
-int16_t savedVoltage;
-#endif
-uint8_t currentWriteCount;
-uint8_t currentReadCount;
-uint8_t voltageWriteCount;
-uint8_t voltageReadCount;
+// ADC rate scheduler, ticks until each channel is next due
+uint16_t vccCount;
+uint16_t viCount;
+bool viDue;						// V/I conversion chained after VCC this tick
+
+// Interrupt counts, free running. Differenced once per second for GET_STATS
+uint16_t timerWakeups;
+uint16_t adcWakeups;
+uint16_t timerWakeupsLast;
+uint16_t adcWakeupsLast;
+uint16_t timerPerSecond;
+uint16_t adcPerSecond;
+
+// Global variables used interrupt-to-interrupt (samples pass through sample_ring)
+sample_t pendingVoltage;		// Voltage waiting for its current sample
+sample_t savedCurrent;
+sample_t savedVoltage;
 int32_t acc_p_ave;
 uint32_t acc_i_rms;
 uint32_t acc_v_rms;
@@ -65,7 +73,7 @@ uint32_t voltAmpsToAverage;
 uint16_t uart_len;
 uint8_t ad_len = ADLEN;
 uint8_t powerblade_id = 2;
-const char msp_software_version = 3;
+const char msp_software_version = 5;
 
 // Transmitted values
 uint32_t sequence;
@@ -85,10 +93,6 @@ int32_t curoff_local;
 int32_t curoff_count;
 int32_t vscale_local;
 int32_t pscale_local;
-int16_t vsamp[2400];
-int16_t isamp[2400];
-uint16_t vSampOffset;
-uint16_t iSampOffset;
 uint16_t wattageSetpoint;
 uint16_t voltageSetpoint;
 
@@ -107,7 +111,9 @@ PowerBladeConfig_t pb_config = { .voff = -1, .ioff = -16, .curoff = 0x0000, .psc
 int dataIndex;
 pb_state_t pb_state;
 int txIndex;
-bool dataComplete;
+int dataBlocks;			// Blocks sent so far in this download
+int dataBlocksTotal;
+int dataFirstBlock;		// Block to start a download at, if none have been sent yet
 int pb_toggle;
 
 uint32_t SquareRoot(uint32_t a_nInput) {
@@ -152,9 +158,7 @@ uint32_t SquareRoot64(uint64_t a_nInput) {
 	return res;
 }
 
-// Variables and functions for keeping computation and transmission out of interrupts
-uint16_t tryCount;
-uint16_t sendCount;
+// Functions for keeping computation and transmission out of interrupts
 void transmitTry(void);
 void transmit(void);
 
@@ -191,14 +195,18 @@ int main(void) {
 	pb_toggle = 0;
 	ready = 0;
 	senseEnabled = 0;
-	tryCount = 0;
-	sendCount = 0;
 
 	// Zero all sensing values
-	currentWriteCount = 0;
-	currentReadCount = 0;
-	voltageWriteCount = 0;
-	voltageReadCount = 0;
+	sample_ring_init();
+	vccCount = 1;
+	viCount = 1;
+	viDue = 0;
+	timerWakeups = 0;
+	adcWakeups = 0;
+	timerWakeupsLast = 0;
+	adcWakeupsLast = 0;
+	timerPerSecond = 0;
+	adcPerSecond = 0;
 	//wattHours = 0;
 	sampleCount = 0;
 	measCount = 0;
@@ -207,6 +215,12 @@ int main(void) {
 	//sequence = 0;
 	txIndex = 0;
 
+	// Start looking for turn-on and power quality events
+	signature_init();
+	pq_init();
+	fastEnabled = 0;
+	fastEnded = 0;
+
 	// Initialize scale value (can be updated later)
 	scale = pb_config.pscale;
 	scale = (scale<<8)+pb_config.vscale;
@@ -214,9 +228,9 @@ int main(void) {
 
 	// Clock Setup
 	CSCTL0_H = 0xA5;							// Input CSKEY password to change clock settings
-	CSCTL1 = DCOFSEL0 + DCOFSEL1;             	// Set DCO to 8MHz
+	CSCTL1 = DCO_SLOW;             				// Set DCO to 8MHz
 	CSCTL2 = SELA_0 + SELS_3 + SELM_3;        	// Set ACLK = XT1, SMCLK = MCLK = DCO
-	CSCTL3 = DIVA_0 + DIVS_1 + DIVM_1;        	// Set ACLK = XT1/1 (32768Hz), SMCLK = MCLK = DCO/2 (4MHz)
+	CSCTL3 = DIV_SLOW;        					// Set ACLK = XT1/1 (32768Hz), SMCLK = MCLK = DCO/2 (4MHz)
 	CSCTL4 |= XT1DRIVE_0;						// Set XT1 LF, lowest current consumption
 	CSCTL4 &= ~XT1OFF;							// Turn on XT1
 	do {										// Test XT1 for correct initialization
@@ -225,6 +239,9 @@ int main(void) {
 	} while (SFRIFG1 & OFIFG);              	// Test oscillator fault flag
 	// XT1 test passed
 
+	// Radios for the per-second record, before the ADC (tag RNG seed)
+	uplink_init();
+
 	// Set up UART
 	uart_init();
 
@@ -241,9 +258,10 @@ int main(void) {
 	ADC10IE |= ADC10IE0;                   		// Enable ADC conv complete interrupt
 
 	// ADC conversion trigger signal - TimerA0.0
-	TA0CCR0 = 13;								// Timer Period
+	TA0CCR0 = ADC_TICK;							// Timer Period
 	TA0CCTL0 = CCIE;               				// TA0CCR0 interrupt
 	TA0CTL = TASSEL_1 + MC_2 + TACLR;          	// TA0 set to ACLK (32kHz), up mode
+	// With UPLINK_GEN2, TA0CCR1 times the tag's inventoried flags (tag.c)
 
 	// Wait timer for transmissions
   	TA1CTL = TASSEL_1 + MC_2 + TACLR;			// ACLK, up mode
@@ -252,29 +270,65 @@ int main(void) {
 	__bis_SR_register(LPM3_bits + GIE);        	// Enter LPM3 w/ interrupts
 
 	while(1) {
-		while(tryCount > 0) {
-			tryCount--;
+		while(sample_ring_pop(&savedVoltage, &savedCurrent)) {
 			transmitTry();
 		}
-		while(sendCount > 0) {
+		if(nordicReady) {						// nRF signaled it is booted
+			nordicReady = 0;
+			nordicRunning = 1;
+			sendCount++;
+		}
+		while(sendCount > 0 && !uart_busy()) {	// Wait out any fast record
 			sendCount--;
 			transmit();
 		}
-		__bis_SR_register(LPM3_bits + GIE);
+
+		// LPM3 stops SMCLK, which the tag needs while it hears a reader
+		__disable_interrupt();
+		__bis_SR_register((clockHeld ? LPM1_bits : LPM3_bits) + GIE);
 	}
 }
 
 #pragma vector=TIMER0_A0_VECTOR
 __interrupt void TIMERA0_ISR(void) {
 	TA0CCTL0 &= ~CCIFG;
-	TA0CCR0 += 13;
 	P1OUT |= BIT2;
+	timerWakeups++;
 
-	// Start with VCC_SENSE
-	ADC10CTL0 &= ~ADC10ENC;
-	ADC10MCTL0 = VCCMCTL0;
-	ADC10CTL0 |= ADC10ENC;
-	ADC10CTL0 += ADC10SC;
+	// Find which channels are due on this tick
+	bool vccDue = 0;
+	if(--vccCount == 0) {
+		vccCount = VCC_DIV;
+		vccDue = 1;
+	}
+	viDue = 0;
+	if(senseEnabled && --viCount == 0) {
+		viCount = VI_DIV;
+		viDue = 1;
+	}
+
+	if(senseEnabled) {
+		TA0CCR0 += ADC_TICK;
+	}
+	else {
+		// Only VCC_SENSE is running, sleep straight through to its next conversion
+		TA0CCR0 += ADC_TICK * vccCount;
+		vccCount = 1;
+	}
+
+	if(vccDue) {
+		// VCC_SENSE first, the ADC ISR chains V_SENSE if it is also due
+		ADC10CTL0 &= ~ADC10ENC;
+		ADC10MCTL0 = VCCMCTL0;
+		ADC10CTL0 |= ADC10ENC;
+		ADC10CTL0 += ADC10SC;
+	}
+	else if(viDue) {
+		ADC10CTL0 &= ~ADC10ENC;
+		ADC10MCTL0 = VMCTL0;
+		ADC10CTL0 |= ADC10ENC;
+		ADC10CTL0 += ADC10SC;
+	}
 
 	P1OUT &= ~BIT2;
 }
@@ -283,6 +337,10 @@ __interrupt void TIMERA0_ISR(void) {
 __interrupt void TIMERA1_ISR(void) {
 	P1OUT |= (BIT2 + BIT3);
 	TA1CCTL0 = 0;
+
+	// No ready byte before the timeout, assume the nRF is up anyway
+	nordicWaiting = 0;
+	nordicRunning = 1;
 	sendCount++;
 	__bic_SR_register_on_exit(LPM3_bits);
 	P1OUT &= ~(BIT2 + BIT3);
@@ -296,28 +354,24 @@ void transmit(void) {
 	uart_stuff(blockOffset + OFFSET_UARTLEN, (char*) &uart_len, sizeof(uart_len));
 	uart_stuff(blockOffset + OFFSET_ADLEN, (char*) &ad_len, sizeof(ad_len));
 	uart_stuff(blockOffset + OFFSET_PBID, (char*) &powerblade_id, sizeof(powerblade_id));
-	uart_stuff(blockOffset + OFFSET_SEQ, (char*) &sequence, sizeof(sequence));
+	// Record as it was at the end of the second
+	uart_stuff(blockOffset + OFFSET_SEQ, (char*) &uplink_rec.sequence, sizeof(uplink_rec.sequence));
 
-	uart_stuff(blockOffset + OFFSET_SCALE, (char*) &scale, sizeof(scale));
+	uart_stuff(blockOffset + OFFSET_SCALE, (char*) &uplink_rec.scale, sizeof(uplink_rec.scale));
 
-	uart_stuff(blockOffset + OFFSET_VRMS, (char*) &Vrms, sizeof(Vrms));
-
-	// XXX this is kind of cheating
-	if(apparentPower < truePower) {
-		apparentPower = truePower;
-	}
+	uart_stuff(blockOffset + OFFSET_VRMS, (char*) &uplink_rec.vrms, sizeof(uplink_rec.vrms));
 
-	uart_stuff(blockOffset + OFFSET_TP, (char*) &truePower, sizeof(truePower));
-	uart_stuff(blockOffset + OFFSET_AP, (char*) &apparentPower, sizeof(apparentPower));
+	uart_stuff(blockOffset + OFFSET_TP, (char*) &uplink_rec.true_power, sizeof(uplink_rec.true_power));
+	uart_stuff(blockOffset + OFFSET_AP, (char*) &uplink_rec.apparent_power, sizeof(uplink_rec.apparent_power));
 
-	uint32_t wattHoursSend = (uint32_t)(wattHours >> pb_config.whscale);
-	uart_stuff(blockOffset + OFFSET_WH, (char*) &wattHoursSend, sizeof(wattHoursSend));
+	uart_stuff(blockOffset + OFFSET_WH, (char*) &uplink_rec.watt_hours, sizeof(uplink_rec.watt_hours));
 
-	uart_stuff(blockOffset + OFFSET_FLAGS, (char*) &flags, sizeof(flags));
+	uart_stuff(blockOffset + OFFSET_FLAGS, (char*) &uplink_rec.flags, sizeof(uplink_rec.flags));
 
 	// About to transmit, reset the watchdog timer
 	WDTCTL = WDTPW + WDTSSEL_1 + WDTCNTCL + WDTIS_3;
 
+	fast_frame();
 	uart_send(blockOffset, uart_len);
 
 	P1OUT &= ~BIT3;
@@ -327,14 +381,13 @@ void transmitTry(void) {
 
 	P1OUT |= BIT3;
 
-	// Save voltage and current before next interrupt happens
-	savedCurrent = current[currentReadCount++];
-	if(currentReadCount == BACKLOG_LEN) {
-		currentReadCount = 0;
+	// Send a waiting fast record once the UART is free
+	if(fastLowVcc) {
+		fastLowVcc = 0;
+		fast_stop();
 	}
-	savedVoltage = voltage[voltageReadCount++];
-	if(voltageReadCount == BACKLOG_LEN) {
-		voltageReadCount = 0;
+	if(nordicRunning) {
+		fast_send();
 	}
 
 	// Integrate current
@@ -359,22 +412,47 @@ void transmitTry(void) {
 	acc_p_ave += ((int64_t)savedVoltage * new_current);
 	acc_v_rms += (uint64_t)((int32_t)savedVoltage * (int32_t)savedVoltage);
 
+	if(pb_state == pb_normal) {
+		signature_sample((int16_t)new_current, sampleCount);
+	}
+
 	sampleCount++;
 	if (sampleCount == SAMCOUNT) { 				// Entire AC wave sampled (60 Hz)
 		// Reset sampleCount once per wave
 		sampleCount = 0;
 
+		// Run the cycle math at full speed, the ring holds samples meanwhile
+		clock_boost();
+
 		// Increment energy calc
-		wattHoursToAverage += (int32_t)(acc_p_ave / SAMCOUNT);
+		int32_t cyclePower = (int32_t)(acc_p_ave / SAMCOUNT);
+		wattHoursToAverage += cyclePower;
 		acc_p_ave = 0;
 
 		// Calculate Irms, Vrms, and apparent power
 		uint16_t Irms = (uint16_t) SquareRoot64(acc_i_rms / SAMCOUNT);
-		Vrms = (uint8_t) SquareRoot64(acc_v_rms / SAMCOUNT);
+		uint16_t cycleVrms = (uint16_t) SquareRoot64(acc_v_rms / SAMCOUNT);
+		Vrms = (uint8_t) cycleVrms;
 		voltAmpsToAverage += (uint32_t) (Irms * Vrms);
 		acc_i_rms = 0;
 		acc_v_rms = 0;
 
+		if(pb_state == pb_normal) {
+			signature_cycle(cyclePower, Irms, Vrms);
+		}
+		else if(pb_state == pb_armed) {
+			trigger_cycle(cyclePower);
+		}
+
+		if(pb_state == pb_normal) {
+			fast_cycle(cyclePower, (uint32_t)Irms * Vrms);
+		}
+
+		// Voltage offsets are not settled during local calibration
+		if(pb_state != pb_local1 && pb_state != pb_local2 && pb_state != pb_local3) {
+			pq_cycle(cycleVrms, sequence);
+		}
+
 		measCount++;
 		if (measCount >= 60) { 					// Another second has passed
 			measCount = 0;
@@ -408,148 +486,235 @@ void transmitTry(void) {
 				rxCt = 0;	// Clear any message received in this time
 				uart_len = UARTBLOCK;
 				pb_state = pb_data;
+				dataBlocks = 1;
+				dataBlocksTotal = ARENA_BLOCKS;
 				char data_type = CONT_SAMDATA;
 				uart_stuff(OFFSET_DATATYPE+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
 			}
+			else if(pb_state == pb_armed && trigger_done()) {
+				// Triggered capture is frozen, report the trigger and wait for CONT_SAMDATA
+				rxCt = 0;	// Clear any message received in this time
+				pb_state = pb_data;
+				dataBlocks = 0;
+				dataBlocksTotal = TRIG_BLOCKS;
+				dataFirstBlock = trigger_first_block();
+				uint16_t trigPosition = trigger_position();
+				uart_len += 1 + DONE_TRIGGER_LEN;
+				char data_type = DONE_TRIGGER;
+				uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
+				uart_stuff(OFFSET_DATATYPE + 1, (char*)&trigPosition, sizeof(trigPosition));
+			}
 			else if(processMessage() > 0) {
-				switch(captureType) {
-				case GET_CONF:
-					uart_len += 1 + sizeof(pb_config);	// Add length of data type AND length of pb_config
-					uart_stuff(OFFSET_DATATYPE+(txIndex*UARTBLOCK), &captureType, sizeof(captureType));
-					memcpy(txBuf + 1 + OFFSET_DATATYPE+(txIndex*UARTBLOCK), &pb_config, sizeof(pb_config));
-					break;
-				case SET_CONF:
-					// XXX do we want to do any bounds-checking on this?
-					memcpy(&pb_config, captureBuf, sizeof(pb_config));
-					scale = pb_config.pscale;
-					scale = (scale<<8)+pb_config.vscale;
-					scale = (scale<<8)+pb_config.whscale;
-					flags |= 0x80;
-					break;
-				case GET_VER:
-					uart_len += 2;						// Add length of data type and version
-					uart_stuff(OFFSET_DATATYPE+(txIndex*UARTBLOCK), &captureType, sizeof(captureType));
-					uart_stuff(1 + OFFSET_DATATYPE+(txIndex*UARTBLOCK), (char*)&msp_software_version, sizeof(msp_software_version));
-					break;
-				case SET_SEQ:
-				{
-					//sequence = captureBuf[0];
-					uart_len += 1;
-					char data_type = UART_NAK;
-					uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
-					break;
-				}
-				case CLR_WH:
-				{
-					//wattHours = 0;
-					uart_len += 1;
-					char data_type = UART_NAK;
-					uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
-					break;
-				}
-				default:
-					switch(pb_state) {
-
-					case pb_normal:
-						switch(captureType) {
-						case START_SAMDATA:
-						{
-							pb_state = pb_capture;
-							dataIndex = 0;
-							uart_len += 1;
-							char data_type = START_SAMDATA;
-							uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
-							break;
-						}
-						case START_LOCALC:
-						{
-							pb_state = pb_local1;
-							vSampOffset = 0;
-							iSampOffset = 0;
-							dataIndex = 0;
-							memcpy(&wattageSetpoint, captureBuf, sizeof(wattageSetpoint));
-							memcpy(&voltageSetpoint, captureBuf + sizeof(wattageSetpoint), sizeof(voltageSetpoint));
-							uart_len += 1;
-							char data_type = START_LOCALC;
-							uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
-							break;
-						}
-						default:
-							break;
-						}
+				// The nRF may batch several messages (UART_BATCH_VERSION). Each reply
+				// follows the last, until one fills the block
+				do {
+					unsigned int reply = uart_len - 1;		// Offset in the block for this reply
+					switch(captureType) {
+					case GET_CONF:
+						uart_len += 1 + sizeof(pb_config);	// Add length of data type AND length of pb_config
+						uart_stuff(reply+(txIndex*UARTBLOCK), &captureType, sizeof(captureType));
+						memcpy(txBuf + 1 + reply+(txIndex*UARTBLOCK), &pb_config, sizeof(pb_config));
 						break;
-
-					case pb_data:
-						switch(captureType) {
-						case CONT_SAMDATA:
-							if(dataComplete) {
+					case SET_CONF:
+						// XXX do we want to do any bounds-checking on this?
+						memcpy(&pb_config, captureBuf, sizeof(pb_config));
+						scale = pb_config.pscale;
+						scale = (scale<<8)+pb_config.vscale;
+						scale = (scale<<8)+pb_config.whscale;
+						flags |= 0x80;
+						break;
+					case GET_VER:
+						uart_len += 2;						// Add length of data type and version
+						uart_stuff(reply+(txIndex*UARTBLOCK), &captureType, sizeof(captureType));
+						uart_stuff(1 + reply+(txIndex*UARTBLOCK), (char*)&msp_software_version, sizeof(msp_software_version));
+						break;
+					case GET_STATS:
+						uart_len += 1 + STATS_LEN;			// Add length of data type and statistics
+						uart_stuff(reply+(txIndex*UARTBLOCK), &captureType, sizeof(captureType));
+						uart_stuff(1 + reply+(txIndex*UARTBLOCK), (char*)&ring_overruns, sizeof(ring_overruns));
+						uart_stuff(3 + reply+(txIndex*UARTBLOCK), (char*)&ring_high_water, sizeof(ring_high_water));
+						uart_stuff(4 + reply+(txIndex*UARTBLOCK), (char*)&timerPerSecond, sizeof(timerPerSecond));
+						uart_stuff(6 + reply+(txIndex*UARTBLOCK), (char*)&adcPerSecond, sizeof(adcPerSecond));
+						break;
+					case DONE_FAST:
+					{
+						// nRF ended fast mode, acknowledge whether or not it was running
+						fast_stop();
+						fastEnded = 0;
+						uart_len += 1;
+						char data_type = DONE_FAST;
+						uart_stuff(reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+						break;
+					}
+					case SET_SEQ:
+					{
+						//sequence = captureBuf[0];
+						uart_len += 1;
+						char data_type = UART_NAK;
+						uart_stuff(reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+						break;
+					}
+					case CLR_WH:
+					{
+						//wattHours = 0;
+						uart_len += 1;
+						char data_type = UART_NAK;
+						uart_stuff(reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+						break;
+					}
+					default:
+						switch(pb_state) {
+
+						case pb_normal:
+							switch(captureType) {
+							case START_SAMDATA:
+							{
+								pb_state = pb_capture;
+								dataIndex = 0;
 								uart_len += 1;
-								txIndex = 0;
-								pb_state = pb_normal;
-								dataComplete = 0;
-								char data_type = DONE_SAMDATA;
-								uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
+								char data_type = START_SAMDATA;
+								uart_stuff(reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+								break;
 							}
-							else {
-								uart_len = UARTBLOCK;
-								txIndex++;
-								char data_type = CONT_SAMDATA;
-								uart_stuff(OFFSET_DATATYPE+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
-								if(txIndex == 9) {
-									dataComplete = 1;
+							case START_LOCALC:
+							{
+								pb_state = pb_local1;
+								dataIndex = 0;
+								memcpy(&wattageSetpoint, captureBuf, sizeof(wattageSetpoint));
+								memcpy(&voltageSetpoint, captureBuf + sizeof(wattageSetpoint), sizeof(voltageSetpoint));
+								uart_len += 1;
+								char data_type = START_LOCALC;
+								uart_stuff(reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+								break;
+							}
+							case START_FAST:
+							{
+								// Cycles per record, then seconds to run
+								char data_type = DONE_FAST;
+								if(fast_start(captureBuf[0], captureBuf[1])) {
+									data_type = START_FAST;
 								}
+								uart_len += 1;
+								uart_stuff(reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+								break;
+							}
+							case START_TRIGGER:
+							{
+								// Mode, then threshold (big-endian)
+								uint16_t threshold = ((uint16_t)(uint8_t)captureBuf[1] << 8) + (uint8_t)captureBuf[2];
+								char data_type = DONE_SAMDATA;
+								if(trigger_arm(captureBuf[0], threshold)) {
+									pb_state = pb_armed;
+									data_type = START_TRIGGER;
+								}
+								uart_len += 1;
+								uart_stuff(reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+								break;
+							}
+							default:
+								break;
 							}
 							break;
-						case UART_NAK:
-							uart_len = UARTBLOCK;
-							break;
-						default:
-							break;
-						}
-						break;
 
-					case pb_local1:
-					case pb_local2:
-					case pb_local3:
-						switch(captureType) {
-						case CONT_LOCALC:
-						{
-							uart_len += 1;
-							char data_type = CONT_LOCALC;
-							uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
-							break;
-						}
-						default:
+						case pb_armed:
+							switch(captureType) {
+							case DONE_SAMDATA:
+							{
+								// Cancelled before the trigger fired
+								pb_state = pb_normal;
+								uart_len += 1;
+								char data_type = DONE_SAMDATA;
+								uart_stuff(reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+								break;
+							}
+							default:
+								break;
+							}
 							break;
-						}
-						break;
 
-					case pb_local_done:
-						switch(captureType) {
-						case CONT_LOCALC:
-						{
-							uart_len += 1;
-							char data_type = DONE_LOCALC;
-							uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
-							pb_config.voff = voff_local;
-							pb_config.ioff = ioff_local;
-							pb_config.curoff = curoff_local;
-							pb_config.vscale = vscale_local;
-							pb_config.pscale = pscale_local;
-							scale = pb_config.pscale;
-							scale = (scale<<8)+pb_config.vscale;
-							scale = (scale<<8)+pb_config.whscale;
-							flags &= 0x3F;	// Clear any previous calibration
-							flags |= 0x40;
+						case pb_data:
+							switch((uint8_t)captureType) {		// UART_NAK is above 0x7F
+							case CONT_SAMDATA:
+								if(dataBlocks >= dataBlocksTotal) {
+									uart_len += 1;
+									txIndex = 0;
+									pb_state = pb_normal;
+									char data_type = DONE_SAMDATA;
+									uart_stuff(reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+								}
+								else {
+									uart_len = UARTBLOCK;
+									if(dataBlocks == 0) {
+										txIndex = dataFirstBlock;
+									}
+									else {
+										txIndex++;
+										if(txIndex == ARENA_BLOCKS) {	// Triggered capture wraps
+											txIndex = TRIG_FIRST_BLOCK;
+										}
+									}
+									dataBlocks++;
+									char data_type = CONT_SAMDATA;
+									uart_stuff(OFFSET_DATATYPE+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+								}
+								break;
+							case UART_NAK:
+								uart_len = UARTBLOCK;
+								break;
+							default:
+								break;
+							}
 							break;
-						}
-						default:
+
+						case pb_local1:
+						case pb_local2:
+						case pb_local3:
+							switch(captureType) {
+							case CONT_LOCALC:
+							{
+								uart_len += 1;
+								char data_type = CONT_LOCALC;
+								uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
+								break;
+							}
+							default:
+								break;
+							}
 							break;
-						}
 
+						case pb_local_done:
+							switch(captureType) {
+							case CONT_LOCALC:
+							{
+								uart_len += 1;
+								char data_type = DONE_LOCALC;
+								uart_stuff(reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+								pb_config.voff = voff_local;
+								pb_config.ioff = ioff_local;
+								pb_config.curoff = curoff_local;
+								pb_config.vscale = vscale_local;
+								pb_config.pscale = pscale_local;
+								scale = pb_config.pscale;
+								scale = (scale<<8)+pb_config.vscale;
+								scale = (scale<<8)+pb_config.whscale;
+								flags &= 0x3F;	// Clear any previous calibration
+								flags |= 0x40;
+
+								// New configuration follows, saving the nRF a GET_CONF round trip
+								uart_len += 1 + sizeof(pb_config);
+								data_type = GET_CONF;
+								uart_stuff(1 + reply+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+								memcpy(txBuf + 2 + reply+(txIndex*UARTBLOCK), &pb_config, sizeof(pb_config));
+								break;
+							}
+							default:
+								break;
+							}
+
+						}
+						break;
 					}
-					break;
-				}
+				} while(uart_len < UARTBLOCK && processMessage() > 0);
 			}
 			else {
 				if(savedCount > 0) {	// Had partial message for multiple bookends
@@ -558,6 +723,54 @@ void transmitTry(void) {
 			}
 			savedCount = rxCt;
 
+			// Interrupts taken over the last second
+			timerPerSecond = timerWakeups - timerWakeupsLast;
+			timerWakeupsLast += timerPerSecond;
+			adcPerSecond = adcWakeups - adcWakeupsLast;
+			adcWakeupsLast += adcPerSecond;
+
+			// Flag whether the sample ring dropped anything in the last second.
+			// Taken with interrupts off so an overrun between read and clear isn't lost
+			bool overrun;
+			__disable_interrupt();
+			overrun = ring_overrun;
+			ring_overrun = 0;
+			__enable_interrupt();
+			if(overrun) {
+				flags |= 0x10;
+			}
+			else {
+				flags &= ~0x10;
+			}
+
+			// Fast mode only runs in normal operation, for a limited time
+			if(pb_state != pb_normal) {
+				fast_stop();
+			}
+			fast_second();
+
+			// Tell the nRF fast mode ended if nothing else is being sent
+			if(fastEnded && uart_len == ADLEN + UARTOVHD) {
+				fastEnded = 0;
+				uart_len += 1;
+				char data_type = DONE_FAST;
+				uart_stuff(OFFSET_DATATYPE+(txIndex*UARTBLOCK), &data_type, sizeof(data_type));
+			}
+
+			// Report a turn-on signature if nothing else is being sent
+			if(pb_state == pb_normal && uart_len == ADLEN + UARTOVHD && signature_ready()) {
+				char data_type = EVENT_SIG;
+				uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
+				uart_len += 1 + signature_stuff(OFFSET_DATATYPE + 1);
+			}
+
+			// Same for power quality events
+			if(pb_state == pb_normal && uart_len == ADLEN + UARTOVHD && pq_ready()) {
+				char data_type = EVENT_PQ;
+				uart_stuff(OFFSET_DATATYPE, &data_type, sizeof(data_type));
+				uart_len += 1 + pq_stuff(OFFSET_DATATYPE + 1);
+			}
+
 			// Increment sequence number for transmission
 			sequence++;
 
@@ -577,20 +790,28 @@ void transmitTry(void) {
 			wattHoursToAverage = 0;
 			voltAmpsToAverage = 0;
 
+			// XXX this is kind of cheating
+			if(apparentPower < truePower) {
+				apparentPower = truePower;
+			}
+
+			// The second's record, for whichever radio is cheapest now
+			meter_t rec;
+			rec.sequence = sequence;
+			rec.scale = scale;
+			rec.vrms = Vrms;
+			rec.flags = flags;
+			rec.true_power = truePower;
+			rec.apparent_power = apparentPower;
+			rec.watt_hours = (uint32_t)(wattHours >> pb_config.whscale);
+
 #if defined (NORDICDEBUG)
 			ready = 1;
 #endif
-			if (ready == 1) {
-				// Boot the nordic and enable its UART
-				SYS_EN_OUT &= ~SYS_EN_PIN;
-				uart_enable(1);
-
-				// Delay for a bit to allow nordic to boot
-				// TODO this is only required the first time
-				TA1CCR0 = TA1R + 500;
-				TA1CCTL0 = CCIE;
-			}
+			uplink_second(&rec, ready, uart_len != ADLEN + UARTOVHD || pb_state != pb_normal || fastEnabled);
 		}
+
+		clock_restore();
 	}
 	P1OUT &= ~BIT3;
 }
@@ -606,6 +827,8 @@ __interrupt void ADC10_ISR(void) {
 
 	unsigned char ADC_Channel;
 
+	adcWakeups++;
+
 	switch (__even_in_range(ADC10IV, 12)) {
 	case 12:
 		ADC_Result = ADC10MEM0;
@@ -644,6 +867,9 @@ __interrupt void ADC10_ISR(void) {
 				}
 #endif
 			}
+			else if(pb_state == pb_armed) {
+				trigger_store(tempCurrent, 1);
+			}
 			else if(pb_state == pb_local1) {
 				if(dataIndex >= 60 && dataIndex < 4980) {
 					ioff_local += tempCurrent;
@@ -661,18 +887,17 @@ __interrupt void ADC10_ISR(void) {
 
 			// After its been stored for raw sample transmission, apply offset
 			if(pb_state == pb_local2 || pb_state == pb_local3) {
-				current[currentWriteCount++] = tempCurrent - ioff_local;
+				tempCurrent -= ioff_local;
 			}
 			else {
-				current[currentWriteCount++] = tempCurrent - pb_config.ioff;
-			}
-			if(currentWriteCount == BACKLOG_LEN) {
-				currentWriteCount = 0;
+				tempCurrent -= pb_config.ioff;
+				if(pb_state == pb_armed) {
+					trigger_current(tempCurrent);
+				}
 			}
 
-			// Current is the last measurement, attempt transmission
-			//transmitTry();
-			tryCount++;
+			// Current is the last measurement, hand the pair to the main loop
+			sample_ring_push(pendingVoltage, tempCurrent);
 			__bic_SR_register_on_exit(LPM3_bits);
 			break;
 		}
@@ -710,6 +935,9 @@ __interrupt void ADC10_ISR(void) {
 				}
 #endif
 			}
+			else if(pb_state == pb_armed) {
+				trigger_store(tempVoltage, 0);
+			}
 			else if(pb_state == pb_local1) {
 				if(dataIndex >= 60 && dataIndex < 4980) {
 					voff_local += tempVoltage;
@@ -720,13 +948,10 @@ __interrupt void ADC10_ISR(void) {
 
 			// After its been stored for raw sample transmission, apply offset
 			if(pb_state == pb_local2 || pb_state == pb_local3) {
-				voltage[voltageWriteCount++] = tempVoltage - voff_local;
+				pendingVoltage = tempVoltage - voff_local;
 			}
 			else {
-				voltage[voltageWriteCount++] = tempVoltage - pb_config.voff;
-			}
-			if(voltageWriteCount == BACKLOG_LEN) {
-				voltageWriteCount = 0;
+				pendingVoltage = tempVoltage - pb_config.voff;
 			}
 
 			// Enable next sample
@@ -742,11 +967,13 @@ __interrupt void ADC10_ISR(void) {
 			// Perform Vcap measurements
 			if (ADC_Result < ADC_VMIN) {
 #if !defined (NORDICDEBUG)
-				uart_enable(0);
-				SYS_EN_OUT |= SYS_EN_PIN;
+				uplink_nrf_off();
 				ready = 0;
 #endif
-			} else if (ready == 0) {
+			} else if (ADC_Result < ADC_VFAST) {
+				fastLowVcc = 1;						// Not enough energy for fast reporting
+			}
+			if (ADC_Result >= ADC_VMIN && ready == 0) {
 				if (ADC_Result > ADC_VCHG) {
 					SEN_EN_OUT |= SEN_EN_PIN;
 					senseEnabled = 1;
@@ -766,8 +993,8 @@ __interrupt void ADC10_ISR(void) {
 #endif
 
 			// Enable next sample
-			// After VCC_SENSE do V_SENSE
-			if(senseEnabled == 1) {
+			// After VCC_SENSE do V_SENSE, if it is due this tick
+			if(senseEnabled == 1 && viDue) {
 				ADC10CTL0 &= ~ADC10ENC;
 				ADC10MCTL0 = VMCTL0;
 				ADC10CTL0 |= ADC10ENC;
@@ -0,0 +1,38 @@
+#!/usr/bin/env python
+#
+# Generate an ADC replay table for msp430sim
+#
+# Rows are taken at the TA0 sample rate. V_SENSE is a sine around mid-scale,
+# I_SENSE is the output of the di/dt sensor (the derivative of the load
+# current) and VCC_SENSE holds the supercap at a fixed level. Columns are
+# 10-bit codes for VERSION33 inputs: A0 voltage, A4 current, A5 VCC.
+
+import argparse
+import math
+import random
+
+parser = argparse.ArgumentParser(description='Generate an ADC replay table for msp430sim')
+parser.add_argument('--seconds', type=float, default=10, help='table length')
+parser.add_argument('--rate', type=float, default=32768.0 / 13, help='rows per second')
+parser.add_argument('--freq', type=float, default=60, help='line frequency')
+parser.add_argument('--vpeak', type=float, default=170, help='voltage peak in ADC codes')
+parser.add_argument('--ipeak', type=float, default=0, help='di/dt peak in ADC codes')
+parser.add_argument('--phase', type=float, default=0, help='current lag in degrees')
+parser.add_argument('--vcc', type=int, default=0x380, help='VCC_SENSE code')
+parser.add_argument('--noise', type=float, default=0, help='peak uniform noise in codes')
+parser.add_argument('--seed', type=int, default=1)
+args = parser.parse_args()
+
+random.seed(args.seed)
+
+def code(x):
+	x += random.uniform(-args.noise, args.noise)
+	return max(0, min(0x3FF, int(round(0x200 + x))))
+
+print('# rate %f' % args.rate)
+print('# inch 0 4 5')
+for n in range(int(args.seconds * args.rate)):
+	w = 2 * math.pi * args.freq * n / args.rate
+	v = args.vpeak * math.sin(w)
+	i = args.ipeak * math.cos(w - math.radians(args.phase))
+	print('%d %d %d' % (code(v), code(i), args.vcc))
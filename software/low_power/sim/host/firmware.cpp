@@ -0,0 +1,130 @@
+/*
+ * The metering firmware built for the host, for hostsim
+ *
+ * main.c and the common sources are compiled here as one unit against
+ * msp430.h in this directory, main() renamed to fw_main(). Registers go
+ * through the msp430sim peripheral models. The firmware runs at no cost in
+ * simulated time: when main() enters LPM, the peripherals are advanced to
+ * their next event and the pending ISRs are called until one clears CPUOFF
+ * on exit. So hostsim counts interrupts and checks the output, but has no
+ * cycle counts.
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include "iss.h"
+}
+#include "msp430.h"
+
+#define main fw_main
+#include "main.c"
+#undef main
+#include "checksum.c"
+#include "clock.c"
+#include "fast.c"
+#include "pq.c"
+#include "sample_ring.c"
+#include "signature.c"
+#include "trigger.c"
+#include "uart.c"
+#include "uplink.c"
+
+struct sim* fw_sim;
+uint64_t fw_isr_runs[IRQ_COUNT];
+uint64_t fw_lpm_exits;
+
+static double fw_seconds;
+static jmp_buf fw_end;
+static unsigned sr_on_exit;			// Status register the running ISR returns to
+
+// Firmware variables --expect-zero can check
+static const struct {
+	const char* name;
+	const void* addr;
+	size_t size;
+} fw_symbols[] = {
+	{ "ring_overruns", &ring_overruns, sizeof(ring_overruns) },
+	{ "ring_overrun", &ring_overrun, sizeof(ring_overrun) },
+	{ "clockBoosts", &clockBoosts, sizeof(clockBoosts) },
+};
+
+static void fw_isr(irq_t irq) {
+	switch(irq) {
+	case irq_usci_a0:	USCI_A0_ISR(); break;
+	case irq_adc10:		ADC10_ISR(); break;
+	case irq_ta0_ccr0:	TIMERA0_ISR(); break;
+	case irq_ta1_ccr0:	TIMERA1_ISR(); break;
+	default:
+		fprintf(stderr, "hostsim: %s pending but the firmware has no handler\n", irq_name(irq));
+		longjmp(fw_end, 2);
+	}
+}
+
+void fw_sr_bis_on_exit(unsigned bits) {
+	sr_on_exit |= bits;
+}
+
+void fw_sr_bic_on_exit(unsigned bits) {
+	sr_on_exit &= ~bits;
+}
+
+// main() entering LPM: run ISRs until one wakes it, or the time is up
+void fw_sr_bis(unsigned bits) {
+	sim_t* s = (sim_t*) fw_sim;
+	if(!(bits & CPUOFF)) {
+		return;
+	}
+	for(;;) {
+		bool wake = 0;
+		int irq;
+		while((irq = periph_pending(s)) >= 0) {
+			periph_accept(s, (irq_t) irq);
+			fw_isr_runs[irq]++;
+			sr_on_exit = bits;
+			fw_isr((irq_t) irq);
+			if(!(sr_on_exit & CPUOFF)) {
+				wake = 1;
+			}
+		}
+		if(s->halted) {
+			longjmp(fw_end, 2);
+		}
+		if(wake) {
+			fw_lpm_exits++;
+			return;
+		}
+		double next = periph_next_event(s);
+		if(next < 0 || next > fw_seconds) {
+			periph_run_to(s, fw_seconds);
+			longjmp(fw_end, 1);
+		}
+		periph_run_to(s, next > s->time ? next : s->time);
+	}
+}
+
+// Run the firmware from reset for the given time, non-zero if it stopped early
+extern "C" int fw_run(sim_t* s, double seconds) {
+	fw_sim = (struct sim*) s;
+	fw_seconds = seconds;
+	int r = setjmp(fw_end);
+	if(r == 0) {
+		fw_main();
+		return 2;
+	}
+	return r == 1 ? 0 : r;
+}
+
+extern "C" bool fw_symbol(const char* name, uint32_t* value) {
+	size_t i;
+	for(i = 0; i < sizeof(fw_symbols) / sizeof(fw_symbols[0]); i++) {
+		if(strcmp(name, fw_symbols[i].name) == 0) {
+			*value = 0;
+			memcpy(value, fw_symbols[i].addr, fw_symbols[i].size);
+			return 1;
+		}
+	}
+	return 0;
+}
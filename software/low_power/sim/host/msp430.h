@@ -0,0 +1,234 @@
+/*
+ * Stand-in for the TI device header when the metering firmware is built for
+ * the host (hostsim). Each register is a proxy that reads and writes through
+ * the msp430sim peripheral models, so the firmware sees the same timers, ADC
+ * and UART as on the ISS. Built as C++ for the operator overloads only
+ */
+
+#ifndef HOSTSIM_MSP430_H_
+#define HOSTSIM_MSP430_H_
+#include <stdint.h>
+#include <stdbool.h>
+
+extern "C" {
+struct sim;
+uint16_t periph_read(struct sim* s, uint16_t addr, bool byte);
+void periph_write(struct sim* s, uint16_t addr, uint16_t val, bool byte);
+}
+
+// firmware.cpp
+extern struct sim* fw_sim;
+void fw_sr_bis(unsigned bits);
+void fw_sr_bis_on_exit(unsigned bits);
+void fw_sr_bic_on_exit(unsigned bits);
+
+// One peripheral register, byte or word wide
+struct fw_reg_t {
+	uint16_t addr;
+	bool byte;
+
+	operator uint16_t() const { return periph_read(fw_sim, addr, byte); }
+	const fw_reg_t& operator=(unsigned v) const { periph_write(fw_sim, addr, (uint16_t) v, byte); return *this; }
+	const fw_reg_t& operator|=(unsigned v) const { return *this = (uint16_t) *this | v; }
+	const fw_reg_t& operator&=(unsigned v) const { return *this = (uint16_t) *this & v; }
+	const fw_reg_t& operator^=(unsigned v) const { return *this = (uint16_t) *this ^ v; }
+	const fw_reg_t& operator+=(unsigned v) const { return *this = (uint16_t) *this + v; }
+	const fw_reg_t& operator-=(unsigned v) const { return *this = (uint16_t) *this - v; }
+};
+#define R16(a)	(fw_reg_t{(a), false})
+#define R8(a)	(fw_reg_t{(a), true})
+
+// Registers, at their MSP430FR5738 addresses
+#define SFRIE1		R16(0x0100)
+#define SFRIFG1		R16(0x0102)
+#define WDTCTL		R16(0x015C)
+#define CSCTL0		R16(0x0160)
+#define CSCTL0_H	R8(0x0161)
+#define CSCTL1		R16(0x0162)
+#define CSCTL2		R16(0x0164)
+#define CSCTL3		R16(0x0166)
+#define CSCTL4		R16(0x0168)
+#define CSCTL5		R16(0x016A)
+#define REFCTL0		R16(0x01B0)
+#define P1IN		R8(0x0200)
+#define P2IN		R8(0x0201)
+#define P1OUT		R8(0x0202)
+#define P2OUT		R8(0x0203)
+#define P1DIR		R8(0x0204)
+#define P2DIR		R8(0x0205)
+#define P1REN		R8(0x0206)
+#define P2REN		R8(0x0207)
+#define P1SEL0		R8(0x020A)
+#define P2SEL0		R8(0x020B)
+#define P1SEL1		R8(0x020C)
+#define P2SEL1		R8(0x020D)
+#define P1IES		R8(0x0218)
+#define P2IES		R8(0x0219)
+#define P1IE		R8(0x021A)
+#define P2IE		R8(0x021B)
+#define P1IFG		R8(0x021C)
+#define P2IFG		R8(0x021D)
+#define P2IV		R16(0x021E)
+#define PJIN		R16(0x0320)
+#define PJOUT		R16(0x0322)
+#define PJDIR		R16(0x0324)
+#define PJREN		R16(0x0326)
+#define PJSEL0		R16(0x032A)
+#define PJSEL1		R16(0x032C)
+#define TA0CTL		R16(0x0340)
+#define TA0CCTL0	R16(0x0342)
+#define TA0CCTL1	R16(0x0344)
+#define TA0CCTL2	R16(0x0346)
+#define TA0R		R16(0x0350)
+#define TA0CCR0		R16(0x0352)
+#define TA0CCR1		R16(0x0354)
+#define TA0CCR2		R16(0x0356)
+#define TA0IV		R16(0x036E)
+#define TA1CTL		R16(0x0380)
+#define TA1CCTL0	R16(0x0382)
+#define TA1CCTL1	R16(0x0384)
+#define TA1CCTL2	R16(0x0386)
+#define TA1R		R16(0x0390)
+#define TA1CCR0		R16(0x0392)
+#define TA1CCR1		R16(0x0394)
+#define TA1CCR2		R16(0x0396)
+#define TA1IV		R16(0x03AE)
+#define UCA0CTLW0	R16(0x05C0)
+#define UCA0CTL1	R8(0x05C0)
+#define UCA0CTL0	R8(0x05C1)
+#define UCA0BRW		R16(0x05C6)
+#define UCA0BR0		R8(0x05C6)
+#define UCA0BR1		R8(0x05C7)
+#define UCA0MCTLW	R16(0x05C8)
+#define UCA0STATW	R16(0x05CA)
+#define UCA0RXBUF	R16(0x05CC)
+#define UCA0TXBUF	R16(0x05CE)
+#define UCA0IE		R16(0x05DA)
+#define UCA0IFG		R16(0x05DC)
+#define UCA0IV		R16(0x05DE)
+#define ADC10CTL0	R16(0x0700)
+#define ADC10CTL1	R16(0x0702)
+#define ADC10CTL2	R16(0x0704)
+#define ADC10LO		R16(0x0706)
+#define ADC10HI		R16(0x0708)
+#define ADC10MCTL0	R16(0x070A)
+#define ADC10MEM0	R16(0x0712)
+#define ADC10IE		R16(0x071A)
+#define ADC10IFG	R16(0x071C)
+#define ADC10IV		R16(0x071E)
+
+// Bits
+#define BIT0 0x0001
+#define BIT1 0x0002
+#define BIT2 0x0004
+#define BIT3 0x0008
+#define BIT4 0x0010
+#define BIT5 0x0020
+#define BIT6 0x0040
+#define BIT7 0x0080
+#define BIT8 0x0100
+#define BIT9 0x0200
+#define BITA 0x0400
+#define BITB 0x0800
+#define BITC 0x1000
+#define BITD 0x2000
+#define BITE 0x4000
+#define BITF 0x8000
+
+// Watchdog, clock system
+#define WDTPW		0x5A00
+#define WDTHOLD		0x0080
+#define WDTSSEL_1	0x0020
+#define WDTCNTCL	0x0008
+#define WDTIS_3		0x0003
+#define WDTIS_5		0x0005
+#define OFIFG		0x0002
+
+#define DCORSEL		0x0080
+#define DCOFSEL0	0x0002
+#define DCOFSEL1	0x0004
+#define DCOFSEL_0	0x0000
+#define DCOFSEL_3	0x0006
+#define SELA_0		0x0000
+#define SELA_1		0x0100
+#define SELS_3		0x0030
+#define SELM_3		0x0003
+#define DIVA_0		0x0000
+#define DIVS_0		0x0000
+#define DIVS_1		0x0010
+#define DIVM_0		0x0000
+#define DIVM_1		0x0001
+#define XT1DRIVE_0	0x0000
+#define XT1OFF		0x0001
+#define XT1OFFG		0x0001
+
+// Timer_A
+#define TASSEL_1	0x0100
+#define TASSEL_2	0x0200
+#define MC_0		0x0000
+#define MC_1		0x0010
+#define MC_2		0x0020
+#define TACLR		0x0004
+#define TAIE		0x0002
+#define ID_0		0x0000
+#define CCIE		0x0010
+#define CCIFG		0x0001
+
+// ADC10_B, REF
+#define ADC10SC		0x0001
+#define ADC10ENC	0x0002
+#define ADC10ON		0x0010
+#define ADC10MSC	0x0080
+#define ADC10SHT_2	0x0200
+#define ADC10SHS_0	0x0000
+#define ADC10SHP	0x0200
+#define ADC10BUSY	0x0001
+#define ADC10CONSEQ_0 0x0000
+#define ADC10RES	0x0010
+#define ADC10SREF_0	0x0000
+#define ADC10SREF_1	0x0010
+#define ADC10IE0	0x0001
+#define ADC10INCH_0	0
+#define ADC10INCH_1	1
+#define ADC10INCH_2	2
+#define ADC10INCH_3	3
+#define ADC10INCH_4	4
+#define ADC10INCH_5	5
+#define ADC10INCH_7	7
+#define ADC10INCH_10 10
+#define REFON		0x0001
+
+// eUSCI_A0
+#define UCSWRST		0x0001
+#define UCSSEL_1	0x0040
+#define UCSSEL_2	0x0080
+#define UCRXIE		0x0001
+#define UCTXIE		0x0002
+#define UCTXCPTIE	0x0008
+#define UCBUSY		0x0001
+
+// Status register
+#define GIE			0x0008
+#define CPUOFF		0x0010
+#define OSCOFF		0x0020
+#define SCG0		0x0040
+#define SCG1		0x0080
+#define LPM0_bits	(CPUOFF)
+#define LPM1_bits	(SCG0 + CPUOFF)
+#define LPM3_bits	(SCG1 + SCG0 + CPUOFF)
+#define LPM4_bits	(SCG1 + SCG0 + OSCOFF + CPUOFF)
+
+// ISRs never interrupt main(), they run while main() is in LPM, so masking
+// interrupts has nothing to do
+#define __interrupt
+#define __bis_SR_register(x)			fw_sr_bis(x)
+#define __bis_SR_register_on_exit(x)	fw_sr_bis_on_exit(x)
+#define __bic_SR_register_on_exit(x)	fw_sr_bic_on_exit(x)
+#define __even_in_range(x, y)			((uint16_t)(x))
+#define __enable_interrupt()			((void)0)
+#define __disable_interrupt()			((void)0)
+#define __no_operation()				((void)0)
+#define _nop()							((void)0)
+#define __delay_cycles(x)				((void)(x))
+
+#endif // HOSTSIM_MSP430_H_
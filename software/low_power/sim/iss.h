@@ -0,0 +1,182 @@
+#ifndef MSP430SIM_ISS_H_
+#define MSP430SIM_ISS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/**************************************************************************
+   CPU SECTION
+ **************************************************************************/
+#define PC	0
+#define SP	1
+#define SR	2
+#define CG	3
+
+#define SR_C		0x0001
+#define SR_Z		0x0002
+#define SR_N		0x0004
+#define SR_GIE		0x0008
+#define SR_CPUOFF	0x0010
+#define SR_OSCOFF	0x0020
+#define SR_SCG0		0x0040
+#define SR_SCG1		0x0080
+#define SR_V		0x0100
+
+#define INT_LATENCY	6		// Cycles to accept an interrupt (CPUX)
+
+/**************************************************************************
+   PERIPHERAL SECTION
+ **************************************************************************/
+// Interrupt sources, in priority order (highest first) as on the FR57xx
+typedef enum {
+	irq_usci_a0,
+	irq_adc10,
+	irq_ta0_ccr0,
+	irq_ta0,
+	irq_ta1_ccr0,
+	irq_ta1,
+	IRQ_COUNT
+} irq_t;
+
+typedef struct {
+	uint16_t base;
+	uint16_t ctl;
+	uint16_t r;
+	uint16_t cctl[3];
+	uint16_t ccr[3];
+} sim_timer_t;
+
+// One row of replayed ADC codes per 1/rate seconds, one column per input
+#define REPLAY_INCH		16
+
+typedef struct {
+	uint16_t (*rows)[REPLAY_INCH];
+	unsigned long count;
+	double rate;
+} sim_replay_t;
+
+typedef struct {
+	uint8_t data[64];
+	unsigned len;
+	double time;
+} sim_rx_t;
+
+typedef struct sim {
+	// CPU
+	uint16_t reg[16];
+	uint8_t mem[0x10000];
+	uint64_t cycles;			// MCLK cycles executed, including interrupt entry
+	uint64_t active_cycles;		// Cycles spent out of LPM
+	double time;				// Seconds since reset
+	bool halted;
+	bool trace;
+
+	// Clock system
+	uint16_t csctl[7];
+	double mclk_hz;
+	double smclk_hz;
+	uint64_t aclk_ticks;		// ACLK edges processed so far
+	double active_time;			// Seconds spent out of LPM
+	uint64_t mclk_switches;		// MCLK frequency changes
+	double freq_hz[8];			// Active time split by MCLK frequency
+	double freq_active[8];
+	int freq_count;
+
+	// Watchdog, only checked once the firmware has configured it
+	uint16_t wdtctl;
+	bool wdt_armed;
+	double wdt_cleared;
+	bool wdt_expired;
+
+	// Timers
+	sim_timer_t ta0, ta1;
+
+	// ADC10_B
+	uint16_t adc_ctl0, adc_ctl1, adc_ctl2, adc_mctl0, adc_mem0, adc_ie, adc_ifg;
+	double adc_done;			// Time the running conversion completes, <0 if idle
+	double adc_conv_time;
+	uint64_t adc_conversions[REPLAY_INCH];
+	sim_replay_t replay;
+
+	// MPY32
+	uint32_t mpy_op1;
+	bool mpy_op1_32;			// Operand 1 written through the MPY32 registers
+	uint8_t mpy_mode;			// 0 MPY, 1 MPYS, 2 MAC, 3 MACS
+	uint16_t mpy_op2_lo;
+	uint64_t mpy_base;			// Accumulator before the running MAC
+	uint16_t mpy_res[4];
+	uint16_t mpy_sumext;
+
+	// eUSCI_A0 UART
+	uint16_t uca_ctlw0, uca_brw, uca_mctlw, uca_ie, uca_ifg, uca_rxbuf;
+	double uca_tx_done;			// Time the byte in the shift register finishes, <0 if idle
+	int uca_tx_shift;			// Byte in the shift register
+	int uca_tx_pending;			// Byte waiting in TXBUF behind the shift register, <0 if none
+	uint8_t *tx_log;
+	size_t tx_len, tx_cap;
+	sim_rx_t *rx;
+	unsigned rx_count, rx_next, rx_byte;
+	double rx_next_time;
+
+	// nRF power, SYS_EN on P1.6 (VERSION31 and later, active low)
+	double nrf_ready_delay;		// Boot time before the nRF sends UART_READY, <0 if it never does
+	double nrf_on;				// Time the nRF was last powered, <0 while it is off
+	double nrf_ready_time;		// Time the ready byte arrives, <0 if none is due
+	bool nrf_tx_due;			// Powered, nothing sent to it yet
+	unsigned nrf_boots;
+	double nrf_tx_delay_max;	// Longest wait from power on to the first TX byte
+
+	// Interrupt handlers resolved from the ELF symbol table
+	uint16_t isr_addr[IRQ_COUNT];
+} sim_t;
+
+// iss_cpu.c
+void cpu_reset(sim_t* s, uint16_t entry);
+unsigned cpu_step(sim_t* s);
+void cpu_interrupt(sim_t* s, irq_t irq);
+
+// iss_periph.c
+void periph_reset(sim_t* s);
+uint16_t periph_read(sim_t* s, uint16_t addr, bool byte);
+void periph_write(sim_t* s, uint16_t addr, uint16_t val, bool byte);
+void periph_advance(sim_t* s, unsigned cycles);
+void periph_run_to(sim_t* s, double t);
+double periph_next_event(sim_t* s);
+int periph_pending(sim_t* s);
+void periph_accept(sim_t* s, irq_t irq);
+const char* irq_name(irq_t irq);
+
+// host/firmware.cpp, linked into hostsim instead of loading an image
+int fw_run(sim_t* s, double seconds);
+bool fw_symbol(const char* name, uint32_t* value);
+extern uint64_t fw_isr_runs[IRQ_COUNT];
+extern uint64_t fw_lpm_exits;
+
+// Memory access, peripherals live below 0x1000
+static inline uint16_t mem_read(sim_t* s, uint16_t addr, bool byte) {
+	if(addr < 0x1000) {
+		return periph_read(s, addr, byte);
+	}
+	if(byte) {
+		return s->mem[addr];
+	}
+	addr &= ~1;
+	return s->mem[addr] | (s->mem[addr + 1] << 8);
+}
+
+static inline void mem_write(sim_t* s, uint16_t addr, uint16_t val, bool byte) {
+	if(addr < 0x1000) {
+		periph_write(s, addr, val, byte);
+		return;
+	}
+	if(byte) {
+		s->mem[addr] = (uint8_t)val;
+		return;
+	}
+	addr &= ~1;
+	s->mem[addr] = val & 0xFF;
+	s->mem[addr + 1] = val >> 8;
+}
+
+#endif // MSP430SIM_ISS_H_
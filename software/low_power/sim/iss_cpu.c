@@ -0,0 +1,418 @@
+/*
+ * MSP430 CPU core
+ *
+ * Executes the original MSP430 instruction set (firmware is built with
+ * -mcpu=msp430). Cycle counts follow the MSP430X CPU tables in the FR57xx
+ * family user's guide (SLAU272), which is what the FR5738 runs.
+ */
+
+#include <stdlib.h>
+
+#include "iss.h"
+
+// Source operand classes, used for cycle counts
+enum { SRC_REG, SRC_IND, SRC_INC, SRC_IMM, SRC_IDX, SRC_ABS };
+
+static uint16_t fetch(sim_t* s) {
+	uint16_t w = mem_read(s, s->reg[PC], 0);
+	s->reg[PC] += 2;
+	return w;
+}
+
+static uint16_t reg_read(sim_t* s, int r, bool byte) {
+	uint16_t v = s->reg[r];
+	return byte ? (v & 0xFF) : v;
+}
+
+static void reg_write(sim_t* s, int r, uint16_t v, bool byte) {
+	if(r == CG) {
+		return;
+	}
+	if(byte) {
+		v &= 0xFF;		// Byte writes to a register clear the upper byte
+	}
+	if(r == PC || r == SP) {
+		v &= ~1;
+	}
+	s->reg[r] = v;
+}
+
+// Resolve a source operand. Returns its value, sets its class and, for memory
+// operands, its address
+static uint16_t read_src(sim_t* s, int r, int as, bool byte, int* cls, uint16_t* addr) {
+	*addr = 0;
+	switch(as) {
+	case 0:
+		*cls = SRC_REG;
+		if(r == CG) {
+			return 0;
+		}
+		return reg_read(s, r, byte);
+	case 1:
+		if(r == CG) {
+			*cls = SRC_REG;
+			return 1;
+		}
+		{
+			uint16_t x = fetch(s);
+			if(r == SR) {
+				*cls = SRC_ABS;
+				*addr = x;
+			}
+			else if(r == PC) {
+				*cls = SRC_IDX;
+				*addr = (uint16_t)(s->reg[PC] - 2 + x);
+			}
+			else {
+				*cls = SRC_IDX;
+				*addr = (uint16_t)(s->reg[r] + x);
+			}
+		}
+		return mem_read(s, *addr, byte);
+	case 2:
+		if(r == SR) {
+			*cls = SRC_REG;
+			return 4;
+		}
+		if(r == CG) {
+			*cls = SRC_REG;
+			return 2;
+		}
+		*cls = SRC_IND;
+		*addr = s->reg[r];
+		return mem_read(s, *addr, byte);
+	default:
+		if(r == SR) {
+			*cls = SRC_REG;
+			return 8;
+		}
+		if(r == CG) {
+			*cls = SRC_REG;
+			return byte ? 0xFF : 0xFFFF;
+		}
+		if(r == PC) {
+			*cls = SRC_IMM;
+			uint16_t v = fetch(s);
+			return byte ? (v & 0xFF) : v;
+		}
+		*cls = SRC_INC;
+		*addr = s->reg[r];
+		{
+			uint16_t v = mem_read(s, *addr, byte);
+			s->reg[r] += (byte && r != SP) ? 1 : 2;
+			return v;
+		}
+	}
+}
+
+static void set_nz(sim_t* s, uint32_t r, bool byte) {
+	uint16_t msb = byte ? 0x80 : 0x8000;
+	s->reg[SR] &= ~(SR_N | SR_Z);
+	if(r & msb) {
+		s->reg[SR] |= SR_N;
+	}
+	if(r == 0) {
+		s->reg[SR] |= SR_Z;
+	}
+}
+
+static void set_flag(sim_t* s, uint16_t flag, bool on) {
+	if(on) {
+		s->reg[SR] |= flag;
+	}
+	else {
+		s->reg[SR] &= ~flag;
+	}
+}
+
+static uint16_t alu_add(sim_t* s, uint16_t src, uint16_t dst, unsigned cin, bool byte) {
+	uint32_t mask = byte ? 0xFF : 0xFFFF;
+	uint32_t msb = byte ? 0x80 : 0x8000;
+	uint32_t r = (dst & mask) + (src & mask) + cin;
+	set_flag(s, SR_C, r > mask);
+	r &= mask;
+	set_nz(s, r, byte);
+	set_flag(s, SR_V, ((~(src ^ dst)) & (src ^ r) & msb) != 0);
+	return (uint16_t)r;
+}
+
+static uint16_t alu_dadd(sim_t* s, uint16_t src, uint16_t dst, bool byte) {
+	int digits = byte ? 2 : 4;
+	unsigned carry = s->reg[SR] & SR_C;
+	uint16_t r = 0;
+	int i;
+	for(i = 0; i < digits; i++) {
+		unsigned d = ((src >> (4*i)) & 0xF) + ((dst >> (4*i)) & 0xF) + carry;
+		carry = d > 9;
+		if(carry) {
+			d -= 10;
+		}
+		r |= (d & 0xF) << (4*i);
+	}
+	set_flag(s, SR_C, carry);
+	set_nz(s, r, byte);
+	return r;
+}
+
+static unsigned exec_fmt1(sim_t* s, uint16_t w) {
+	int op = w >> 12;
+	int sreg = (w >> 8) & 0xF;
+	int ad = (w >> 7) & 1;
+	bool byte = (w >> 6) & 1;
+	int as = (w >> 4) & 3;
+	int dreg = w & 0xF;
+
+	int cls;
+	uint16_t saddr;
+	uint16_t src = read_src(s, sreg, as, byte, &cls, &saddr);
+
+	uint16_t daddr = 0;
+	if(ad) {
+		uint16_t x = fetch(s);
+		if(dreg == SR) {
+			daddr = x;
+		}
+		else if(dreg == PC) {
+			daddr = (uint16_t)(s->reg[PC] - 2 + x);
+		}
+		else {
+			daddr = (uint16_t)(s->reg[dreg] + x);
+		}
+	}
+
+	// MOV never reads its destination, peripheral reads can have side effects
+	uint16_t dst = 0;
+	if(op != 0x4) {
+		dst = ad ? mem_read(s, daddr, byte) : reg_read(s, dreg, byte);
+	}
+
+	uint16_t r = dst;
+	bool write = 1;
+	unsigned carry = (s->reg[SR] & SR_C) ? 1 : 0;
+	uint16_t mask = byte ? 0xFF : 0xFFFF;
+	switch(op) {
+	case 0x4:	// MOV
+		r = src;
+		break;
+	case 0x5:	// ADD
+		r = alu_add(s, src, dst, 0, byte);
+		break;
+	case 0x6:	// ADDC
+		r = alu_add(s, src, dst, carry, byte);
+		break;
+	case 0x7:	// SUBC
+		r = alu_add(s, ~src & mask, dst, carry, byte);
+		break;
+	case 0x8:	// SUB
+		r = alu_add(s, ~src & mask, dst, 1, byte);
+		break;
+	case 0x9:	// CMP
+		alu_add(s, ~src & mask, dst, 1, byte);
+		write = 0;
+		break;
+	case 0xA:	// DADD
+		r = alu_dadd(s, src, dst, byte);
+		break;
+	case 0xB:	// BIT
+		r = src & dst;
+		set_nz(s, r, byte);
+		set_flag(s, SR_C, r != 0);
+		set_flag(s, SR_V, 0);
+		write = 0;
+		break;
+	case 0xC:	// BIC
+		r = dst & ~src;
+		break;
+	case 0xD:	// BIS
+		r = dst | src;
+		break;
+	case 0xE:	// XOR
+	{
+		uint16_t msb = byte ? 0x80 : 0x8000;
+		r = (src ^ dst) & mask;
+		set_nz(s, r, byte);
+		set_flag(s, SR_C, r != 0);
+		set_flag(s, SR_V, (src & msb) && (dst & msb));
+		break;
+	}
+	case 0xF:	// AND
+		r = src & dst;
+		set_nz(s, r, byte);
+		set_flag(s, SR_C, r != 0);
+		set_flag(s, SR_V, 0);
+		break;
+	}
+
+	if(write) {
+		if(ad) {
+			mem_write(s, daddr, r, byte);
+		}
+		else {
+			reg_write(s, dreg, r, byte);
+		}
+	}
+
+	// Cycle count from source class and destination mode
+	static const unsigned to_reg[] = {1, 2, 2, 2, 3, 3};
+	static const unsigned to_pc[] = {2, 3, 3, 3, 4, 4};
+	static const unsigned to_mem[] = {4, 5, 5, 5, 6, 6};
+	if(ad) {
+		unsigned c = to_mem[cls];
+		if(op == 0x4 || op == 0x9 || op == 0xB) {
+			c--;		// MOV, CMP, BIT don't write back/read back on the CPUX
+		}
+		return c;
+	}
+	return (dreg == PC) ? to_pc[cls] : to_reg[cls];
+}
+
+static unsigned exec_fmt2(sim_t* s, uint16_t w) {
+	int op = (w >> 7) & 7;
+	bool byte = (w >> 6) & 1;
+	int as = (w >> 4) & 3;
+	int r = w & 0xF;
+
+	if(op == 6) {		// RETI
+		s->reg[SR] = mem_read(s, s->reg[SP], 0);
+		s->reg[SP] += 2;
+		s->reg[PC] = mem_read(s, s->reg[SP], 0);
+		s->reg[SP] += 2;
+		return 5;
+	}
+	if(op == 7) {
+		fprintf(stderr, "msp430sim: illegal instruction %04x at %04x\n", w, (uint16_t)(s->reg[PC] - 2));
+		s->halted = 1;
+		return 1;
+	}
+
+	int cls;
+	uint16_t addr;
+	uint16_t v = read_src(s, r, as, byte, &cls, &addr);
+	bool mem = (as != 0) && cls != SRC_REG && cls != SRC_IMM;
+
+	uint16_t res = v;
+	uint16_t msb = byte ? 0x80 : 0x8000;
+	switch(op) {
+	case 0:		// RRC
+		res = (v >> 1) | ((s->reg[SR] & SR_C) ? msb : 0);
+		set_flag(s, SR_C, v & 1);
+		set_nz(s, res, byte);
+		set_flag(s, SR_V, 0);
+		break;
+	case 1:		// SWPB
+		res = (uint16_t)((v << 8) | (v >> 8));
+		break;
+	case 2:		// RRA
+		res = (v >> 1) | (v & msb);
+		set_flag(s, SR_C, v & 1);
+		set_nz(s, res, byte);
+		set_flag(s, SR_V, 0);
+		break;
+	case 3:		// SXT
+		res = (v & 0x80) ? (v | 0xFF00) : (v & 0x00FF);
+		set_nz(s, res, 0);
+		set_flag(s, SR_C, res != 0);
+		set_flag(s, SR_V, 0);
+		break;
+	case 4:		// PUSH
+		s->reg[SP] -= 2;
+		mem_write(s, s->reg[SP], v, byte);
+		if(cls == SRC_IDX || cls == SRC_ABS) {
+			return 4;
+		}
+		return 3;
+	case 5:		// CALL
+		s->reg[SP] -= 2;
+		mem_write(s, s->reg[SP], s->reg[PC], 0);
+		s->reg[PC] = v & ~1;
+		if(cls == SRC_ABS) {
+			return 6;
+		}
+		return (cls == SRC_IDX) ? 5 : 4;
+	}
+
+	// Rotates, SWPB and SXT write back to their operand
+	if(mem) {
+		mem_write(s, addr, res, byte);
+	}
+	else {
+		reg_write(s, r, res, (op == 3) ? 0 : byte);
+	}
+	if(cls == SRC_IDX || cls == SRC_ABS) {
+		return 4;
+	}
+	return (cls == SRC_REG) ? 1 : 3;
+}
+
+static unsigned exec_jump(sim_t* s, uint16_t w) {
+	int16_t off = w & 0x3FF;
+	if(off & 0x200) {
+		off -= 0x400;
+	}
+	uint16_t sr = s->reg[SR];
+	bool n = sr & SR_N, z = sr & SR_Z, c = sr & SR_C, v = sr & SR_V;
+	bool take = 0;
+	switch((w >> 10) & 7) {
+	case 0: take = !z; break;		// JNE
+	case 1: take = z; break;		// JEQ
+	case 2: take = !c; break;		// JNC
+	case 3: take = c; break;		// JC
+	case 4: take = n; break;		// JN
+	case 5: take = (n == v); break;	// JGE
+	case 6: take = (n != v); break;	// JL
+	case 7: take = 1; break;		// JMP
+	}
+	if(take) {
+		s->reg[PC] += off * 2;
+	}
+	return 2;
+}
+
+void cpu_reset(sim_t* s, uint16_t entry) {
+	int i;
+	for(i = 0; i < 16; i++) {
+		s->reg[i] = 0;
+	}
+	s->reg[PC] = entry;
+	s->cycles = 0;
+	s->active_cycles = 0;
+	s->halted = 0;
+}
+
+// Execute one instruction, returns cycles taken
+unsigned cpu_step(sim_t* s) {
+	uint16_t at = s->reg[PC];
+	uint16_t w = fetch(s);
+	unsigned c;
+
+	if(w >= 0x4000) {
+		c = exec_fmt1(s, w);
+	}
+	else if(w >= 0x2000) {
+		c = exec_jump(s, w);
+	}
+	else if(w >= 0x1000 && w < 0x1400) {
+		c = exec_fmt2(s, w);
+	}
+	else {
+		fprintf(stderr, "msp430sim: unsupported instruction %04x at %04x (MSP430X? build with -mcpu=msp430)\n", w, at);
+		s->halted = 1;
+		c = 1;
+	}
+
+	if(s->trace) {
+		fprintf(stderr, "%04x: %04x  sp=%04x sr=%04x r12=%04x r13=%04x r14=%04x r15=%04x\n",
+				at, w, s->reg[SP], s->reg[SR], s->reg[12], s->reg[13], s->reg[14], s->reg[15]);
+	}
+	return c;
+}
+
+// Accept an interrupt: push PC and SR, clear SR (keeping SCG0), jump to handler
+void cpu_interrupt(sim_t* s, irq_t irq) {
+	s->reg[SP] -= 2;
+	mem_write(s, s->reg[SP], s->reg[PC], 0);
+	s->reg[SP] -= 2;
+	mem_write(s, s->reg[SP], s->reg[SR], 0);
+	s->reg[SR] &= SR_SCG0;
+	s->reg[PC] = s->isr_addr[irq];
+}
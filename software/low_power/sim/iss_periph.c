@@ -0,0 +1,861 @@
+/*
+ * MSP430FR5738 peripheral models
+ *
+ * Only what the PowerBlade firmware touches is modelled: the clock system,
+ * watchdog, Timer_A0/A1 on ACLK, ADC10_B (single conversions, samples come
+ * from a replay table), MPY32 and eUSCI_A0 in UART mode. Anything else below
+ * 0x1000 (ports, SFRs, PMM) reads back what was written. The nRF is powered
+ * while SYS_EN is low and can send UART_READY some time after.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "iss.h"
+
+#define ACLK_HZ		32768.0
+#define VLO_HZ		9400.0
+
+// Clock system
+#define CS_BASE		0x0160
+#define DCORSEL		0x0080
+#define DCOFSEL		0x0006
+
+// Watchdog
+#define WDTCTL_ADDR	0x015C
+#define WDTPW		0x5A00
+#define WDTHOLD		0x0080
+#define WDTSSEL		0x0060
+#define WDTCNTCL	0x0008
+#define WDTIS		0x0007
+
+// Timer_A
+#define TA0_BASE	0x0340
+#define TA1_BASE	0x0380
+#define TA_SIZE		0x30
+#define TAIFG		0x0001
+#define TAIE		0x0002
+#define TACLR		0x0004
+#define TA_MC		0x0030
+#define TA_MC_UP	0x0010
+#define TA_MC_CONT	0x0020
+#define TASSEL		0x0300
+#define TASSEL_ACLK	0x0100
+#define CCIFG		0x0001
+#define CCIE		0x0010
+#define CAP			0x0100
+
+// ADC10_B
+#define ADC_BASE	0x0700
+#define ADC_SIZE	0x20
+#define ADC10SC		0x0001
+#define ADC10ENC	0x0002
+#define ADC10ON		0x0010
+#define ADC10BUSY	0x0001
+#define ADC10RES	0x0010
+#define ADC10INCH	0x000F
+#define ADC10IFG0	0x0001
+
+// MPY32
+#define MPY_BASE	0x04C0
+#define MPY_SIZE	0x30
+
+// eUSCI_A0
+#define UCA_BASE	0x05C0
+#define UCA_SIZE	0x20
+#define UCSWRST		0x0001
+#define UCSSEL		0x00C0
+#define UCSSEL_ACLK	0x0040
+#define UCOS16		0x0001
+#define UCRXIFG		0x0001
+#define UCTXIFG		0x0002
+#define UCTXCPTIFG	0x0008
+
+// nRF enable, P1.6 on VERSION31 and later
+#define SYS_EN_ADDR	0x0202
+#define SYS_EN_PIN	0x40
+#define NRF_READY	0xFE
+
+static const char* irq_names[IRQ_COUNT] = {
+	"USCI_A0_ISR",
+	"ADC10_ISR",
+	"TIMERA0_ISR",
+	"TIMERA0_IV_ISR",
+	"TIMERA1_ISR",
+	"TIMERA1_IV_ISR",
+};
+
+// ISR symbol each interrupt source is resolved to
+const char* irq_name(irq_t irq) {
+	return irq_names[irq];
+}
+
+static uint16_t merge(uint16_t old, uint16_t addr, uint16_t val, bool byte) {
+	if(!byte) {
+		return val;
+	}
+	if(addr & 1) {
+		return (old & 0x00FF) | ((val & 0xFF) << 8);
+	}
+	return (old & 0xFF00) | (val & 0xFF);
+}
+
+static uint16_t pick(uint16_t word, uint16_t addr, bool byte) {
+	if(!byte) {
+		return word;
+	}
+	return (addr & 1) ? (word >> 8) : (word & 0xFF);
+}
+
+/**************************************************************************
+   CLOCK SYSTEM
+ **************************************************************************/
+static double dco_hz(sim_t* s) {
+	static const double low[4] = {5.33e6, 6.67e6, 5.33e6, 8e6};
+	static const double high[4] = {16e6, 20e6, 16e6, 24e6};
+	int sel = (s->csctl[1] & DCOFSEL) >> 1;
+	return (s->csctl[1] & DCORSEL) ? high[sel] : low[sel];
+}
+
+static double clock_source(sim_t* s, int sel) {
+	switch(sel) {
+	case 0: return ACLK_HZ;		// XT1
+	case 1: return VLO_HZ;
+	default: return dco_hz(s);
+	}
+}
+
+static void cs_update(sim_t* s) {
+	double mclk = clock_source(s, s->csctl[2] & 0x7) / (1 << (s->csctl[3] & 0x7));
+	s->smclk_hz = clock_source(s, (s->csctl[2] >> 4) & 0x7) / (1 << ((s->csctl[3] >> 4) & 0x7));
+	if(mclk != s->mclk_hz) {
+		if(s->mclk_hz != 0) {
+			s->mclk_switches++;
+		}
+		s->mclk_hz = mclk;
+	}
+}
+
+/**************************************************************************
+   WATCHDOG
+ **************************************************************************/
+static double wdt_period(sim_t* s) {
+	static const int bits[8] = {31, 27, 23, 19, 15, 13, 9, 6};
+	double clk;
+	switch(s->wdtctl & WDTSSEL) {
+	case 0x0000: clk = s->smclk_hz; break;
+	case 0x0020: clk = ACLK_HZ; break;
+	default: clk = VLO_HZ; break;
+	}
+	return (double)(1UL << bits[s->wdtctl & WDTIS]) / clk;
+}
+
+static void wdt_write(sim_t* s, uint16_t val, bool byte) {
+	if(byte || (val & 0xFF00) != WDTPW) {
+		fprintf(stderr, "msp430sim: WDTCTL written without password (%04x) at %.6fs\n", val, s->time);
+		s->halted = 1;
+		return;
+	}
+	s->wdtctl = val & 0x00F7;
+	s->wdt_armed = !(val & WDTHOLD);
+	s->wdt_cleared = s->time;
+}
+
+/**************************************************************************
+   TIMER_A
+ **************************************************************************/
+static sim_timer_t* timer_at(sim_t* s, uint16_t addr) {
+	if(addr >= TA0_BASE && addr < TA0_BASE + TA_SIZE) {
+		return &s->ta0;
+	}
+	if(addr >= TA1_BASE && addr < TA1_BASE + TA_SIZE) {
+		return &s->ta1;
+	}
+	return NULL;
+}
+
+static uint16_t timer_read(sim_t* s, sim_timer_t* t, uint16_t off) {
+	(void) s;
+	switch(off) {
+	case 0x00: return t->ctl;
+	case 0x02: case 0x04: case 0x06: return t->cctl[(off - 2) / 2];
+	case 0x10: return t->r;
+	case 0x12: case 0x14: case 0x16: return t->ccr[(off - 0x12) / 2];
+	case 0x2E:
+		// Reading TAxIV clears the highest pending flag
+		if((t->cctl[1] & (CCIFG | CCIE)) == (CCIFG | CCIE)) {
+			t->cctl[1] &= ~CCIFG;
+			return 2;
+		}
+		if((t->cctl[2] & (CCIFG | CCIE)) == (CCIFG | CCIE)) {
+			t->cctl[2] &= ~CCIFG;
+			return 4;
+		}
+		if((t->ctl & (TAIFG | TAIE)) == (TAIFG | TAIE)) {
+			t->ctl &= ~TAIFG;
+			return 14;
+		}
+		return 0;
+	default: return 0;
+	}
+}
+
+static void timer_write(sim_timer_t* t, uint16_t off, uint16_t val) {
+	switch(off) {
+	case 0x00:
+		if(val & TACLR) {
+			t->r = 0;
+		}
+		t->ctl = val & ~TACLR;
+		break;
+	case 0x02: case 0x04: case 0x06: t->cctl[(off - 2) / 2] = val; break;
+	case 0x10: t->r = val; break;
+	case 0x12: case 0x14: case 0x16: t->ccr[(off - 0x12) / 2] = val; break;
+	default: break;
+	}
+}
+
+static bool timer_running(sim_timer_t* t) {
+	// Input dividers and SMCLK/INCLK sources are not modelled, the firmware runs both timers on ACLK
+	return (t->ctl & TASSEL) == TASSEL_ACLK && (t->ctl & TA_MC) != 0;
+}
+
+static void timer_tick(sim_timer_t* t) {
+	if(!timer_running(t)) {
+		return;
+	}
+	if((t->ctl & TA_MC) == TA_MC_UP) {
+		if(t->r >= t->ccr[0]) {
+			t->r = 0;
+			t->ctl |= TAIFG;
+		}
+		else {
+			t->r++;
+		}
+	}
+	else {
+		// Continuous (up/down is treated as continuous)
+		t->r++;
+		if(t->r == 0) {
+			t->ctl |= TAIFG;
+		}
+	}
+	int n;
+	for(n = 0; n < 3; n++) {
+		if(!(t->cctl[n] & CAP) && t->r == t->ccr[n]) {
+			t->cctl[n] |= CCIFG;
+		}
+	}
+}
+
+// ACLK ticks until this timer next raises an enabled interrupt, 0 if never
+static uint32_t timer_ticks_to_irq(sim_timer_t* t) {
+	if(!timer_running(t)) {
+		return 0;
+	}
+	uint32_t best = 0;
+	uint32_t d;
+	bool up = (t->ctl & TA_MC) == TA_MC_UP;
+	int n;
+	for(n = 0; n < 3; n++) {
+		if(!(t->cctl[n] & CCIE) || (t->cctl[n] & CAP)) {
+			continue;
+		}
+		if(up) {
+			d = (t->ccr[n] > t->r) ? (uint32_t)(t->ccr[n] - t->r) : (uint32_t)(t->ccr[0] - t->r) + 1 + t->ccr[n];
+		}
+		else {
+			d = (uint16_t)(t->ccr[n] - t->r);
+			if(d == 0) {
+				d = 0x10000;
+			}
+		}
+		if(best == 0 || d < best) {
+			best = d;
+		}
+	}
+	if(t->ctl & TAIE) {
+		d = up ? (uint32_t)(t->ccr[0] - t->r) + 1 : 0x10000u - t->r;
+		if(best == 0 || d < best) {
+			best = d;
+		}
+	}
+	return best;
+}
+
+/**************************************************************************
+   ADC10_B
+ **************************************************************************/
+static uint16_t replay_sample(sim_t* s, int inch, double t) {
+	if(s->replay.count == 0) {
+		return 0x200;		// Mid-scale when nothing is replayed
+	}
+	unsigned long row = (unsigned long)(t * s->replay.rate) % s->replay.count;
+	return s->replay.rows[row][inch];
+}
+
+static void adc_write(sim_t* s, uint16_t off, uint16_t val) {
+	switch(off) {
+	case 0x00:
+		if((val & ADC10SC) && (val & ADC10ENC) && (val & ADC10ON) && !(s->adc_ctl1 & ADC10BUSY)) {
+			s->adc_ctl1 |= ADC10BUSY;
+			s->adc_done = s->time + s->adc_conv_time;
+		}
+		s->adc_ctl0 = val & ~ADC10SC;		// SC resets itself
+		break;
+	case 0x02: s->adc_ctl1 = (val & ~ADC10BUSY) | (s->adc_ctl1 & ADC10BUSY); break;
+	case 0x04: s->adc_ctl2 = val; break;
+	case 0x0A:
+		if(s->adc_ctl0 & ADC10ENC) {
+			fprintf(stderr, "msp430sim: ADC10MCTL0 written with ADC10ENC set at %.6fs\n", s->time);
+		}
+		s->adc_mctl0 = val;
+		break;
+	case 0x1A: s->adc_ie = val; break;
+	case 0x1C: s->adc_ifg = val; break;
+	default: break;
+	}
+}
+
+static uint16_t adc_read(sim_t* s, uint16_t off) {
+	switch(off) {
+	case 0x00: return s->adc_ctl0;
+	case 0x02: return s->adc_ctl1;
+	case 0x04: return s->adc_ctl2;
+	case 0x0A: return s->adc_mctl0;
+	case 0x12:
+		s->adc_ifg &= ~ADC10IFG0;
+		return s->adc_mem0;
+	case 0x1A: return s->adc_ie;
+	case 0x1C: return s->adc_ifg;
+	case 0x1E:
+		if(s->adc_ifg & s->adc_ie & ADC10IFG0) {
+			s->adc_ifg &= ~ADC10IFG0;
+			return 12;
+		}
+		return 0;
+	default: return 0;
+	}
+}
+
+static void adc_complete(sim_t* s) {
+	int inch = s->adc_mctl0 & ADC10INCH;
+	uint16_t code = replay_sample(s, inch, s->adc_done) & 0x3FF;
+	if(!(s->adc_ctl2 & ADC10RES)) {
+		code >>= 2;		// 8-bit results
+	}
+	s->adc_mem0 = code;
+	s->adc_ifg |= ADC10IFG0;
+	s->adc_ctl1 &= ~ADC10BUSY;
+	s->adc_done = -1;
+	s->adc_conversions[inch]++;
+}
+
+/**************************************************************************
+   MPY32
+ **************************************************************************/
+static int64_t mpy_extend(uint32_t v, int bits, bool sign) {
+	if(bits == 16) {
+		v &= 0xFFFF;
+		return sign ? (int64_t)(int16_t)v : (int64_t)v;
+	}
+	return sign ? (int64_t)(int32_t)v : (int64_t)v;
+}
+
+static void mpy_set_result(sim_t* s, uint64_t r) {
+	int i;
+	for(i = 0; i < 4; i++) {
+		s->mpy_res[i] = (uint16_t)(r >> (16 * i));
+	}
+}
+
+// Multiply operand 1 by op2 (16 or 32 bits) and update the result registers
+static void mpy_run(sim_t* s, uint32_t op2, bool op2_32) {
+	bool sign = s->mpy_mode & 1;
+	bool mac = s->mpy_mode & 2;
+	int64_t a = mpy_extend(s->mpy_op1, s->mpy_op1_32 ? 32 : 16, sign);
+	int64_t b = mpy_extend(op2, op2_32 ? 32 : 16, sign);
+	uint64_t p = (uint64_t)(a * b);
+	bool wide = s->mpy_op1_32 || op2_32;
+
+	if(!mac) {
+		mpy_set_result(s, p);
+		s->mpy_sumext = (sign && (int64_t)p < 0) ? 0xFFFF : 0;
+		return;
+	}
+	if(wide) {
+		uint64_t r = s->mpy_base + p;
+		mpy_set_result(s, r);
+		s->mpy_sumext = sign ? (((int64_t)r < 0) ? 0xFFFF : 0) : (r < s->mpy_base);
+	}
+	else {
+		uint32_t base = (uint32_t)s->mpy_base;
+		uint32_t r = base + (uint32_t)p;
+		s->mpy_res[0] = (uint16_t)r;
+		s->mpy_res[1] = (uint16_t)(r >> 16);
+		s->mpy_sumext = sign ? (((int32_t)r < 0) ? 0xFFFF : 0) : (r < base);
+	}
+}
+
+static uint64_t mpy_result(sim_t* s) {
+	return (uint64_t)s->mpy_res[0] | ((uint64_t)s->mpy_res[1] << 16)
+			| ((uint64_t)s->mpy_res[2] << 32) | ((uint64_t)s->mpy_res[3] << 48);
+}
+
+static void mpy_write(sim_t* s, uint16_t off, uint16_t val, bool byte) {
+	switch(off & ~1) {
+	case 0x00: case 0x02: case 0x04: case 0x06:		// MPY, MPYS, MAC, MACS
+		s->mpy_mode = (off & ~1) / 2;
+		s->mpy_op1 = byte ? (uint16_t)((s->mpy_mode & 1) ? (int16_t)(int8_t)val : (val & 0xFF)) : val;
+		s->mpy_op1_32 = 0;
+		break;
+	case 0x08:										// OP2
+		s->mpy_base = mpy_result(s);
+		mpy_run(s, byte ? (uint16_t)((s->mpy_mode & 1) ? (int16_t)(int8_t)val : (val & 0xFF)) : val, 0);
+		break;
+	case 0x0A: s->mpy_res[0] = val; break;			// RESLO
+	case 0x0C: s->mpy_res[1] = val; break;			// RESHI
+	case 0x10: case 0x14: case 0x18: case 0x1C:		// MPY32L, MPYS32L, MAC32L, MACS32L
+		s->mpy_mode = ((off & ~1) - 0x10) / 4;
+		s->mpy_op1 = (s->mpy_op1 & 0xFFFF0000) | val;
+		s->mpy_op1_32 = 1;
+		break;
+	case 0x12: case 0x16: case 0x1A: case 0x1E:		// MPY32H ...
+		s->mpy_op1 = (s->mpy_op1 & 0xFFFF) | ((uint32_t)val << 16);
+		s->mpy_op1_32 = 1;
+		break;
+	case 0x20:										// OP2L, starts as 16 bits
+		s->mpy_base = mpy_result(s);
+		s->mpy_op2_lo = val;
+		mpy_run(s, val, 0);
+		break;
+	case 0x22:										// OP2H, redo as 32 bits
+		mpy_run(s, s->mpy_op2_lo | ((uint32_t)val << 16), 1);
+		break;
+	case 0x24: case 0x26: case 0x28: case 0x2A:		// RES0..RES3
+		s->mpy_res[((off & ~1) - 0x24) / 2] = val;
+		break;
+	default:
+		break;
+	}
+}
+
+static uint16_t mpy_read(sim_t* s, uint16_t off) {
+	switch(off & ~1) {
+	case 0x00: case 0x02: case 0x04: case 0x06: return (uint16_t)s->mpy_op1;
+	case 0x0A: return s->mpy_res[0];
+	case 0x0C: return s->mpy_res[1];
+	case 0x0E: return s->mpy_sumext;
+	case 0x10: case 0x14: case 0x18: case 0x1C: return (uint16_t)s->mpy_op1;
+	case 0x12: case 0x16: case 0x1A: case 0x1E: return (uint16_t)(s->mpy_op1 >> 16);
+	case 0x20: return s->mpy_op2_lo;
+	case 0x24: case 0x26: case 0x28: case 0x2A: return s->mpy_res[((off & ~1) - 0x24) / 2];
+	default: return 0;
+	}
+}
+
+/**************************************************************************
+   eUSCI_A0 UART
+ **************************************************************************/
+static double uart_byte_time(sim_t* s) {
+	double clk = ((s->uca_ctlw0 & UCSSEL) == UCSSEL_ACLK) ? ACLK_HZ : s->smclk_hz;
+	int brs = s->uca_mctlw >> 8;
+	int ones = 0;
+	while(brs) {
+		ones += brs & 1;
+		brs >>= 1;
+	}
+	double bit;
+	if(s->uca_mctlw & UCOS16) {
+		bit = (16.0 * s->uca_brw + ((s->uca_mctlw >> 4) & 0xF) + ones / 8.0) / clk;
+	}
+	else {
+		bit = (s->uca_brw + ones / 8.0) / clk;
+	}
+	return 10 * bit;		// Start, 8 data, stop
+}
+
+static void uart_log(sim_t* s, uint8_t b) {
+	if(s->tx_len == s->tx_cap) {
+		s->tx_cap = s->tx_cap ? 2 * s->tx_cap : 4096;
+		s->tx_log = realloc(s->tx_log, s->tx_cap);
+		if(!s->tx_log) {
+			fprintf(stderr, "msp430sim: out of memory\n");
+			exit(2);
+		}
+	}
+	s->tx_log[s->tx_len++] = b;
+}
+
+static void uart_write(sim_t* s, uint16_t off, uint16_t val, bool byte) {
+	switch(off & ~1) {
+	case 0x00:
+	{
+		uint16_t ctl = merge(s->uca_ctlw0, UCA_BASE + off, val, byte);
+		if((ctl & UCSWRST) && !(s->uca_ctlw0 & UCSWRST)) {
+			s->uca_ie = 0;
+			s->uca_ifg = UCTXIFG;
+			s->uca_tx_done = -1;
+			s->uca_tx_pending = -1;
+		}
+		s->uca_ctlw0 = ctl;
+		break;
+	}
+	case 0x06: s->uca_brw = merge(s->uca_brw, UCA_BASE + off, val, byte); break;
+	case 0x08: s->uca_mctlw = merge(s->uca_mctlw, UCA_BASE + off, val, byte); break;
+	case 0x0E:
+		if(s->uca_ctlw0 & UCSWRST) {
+			break;
+		}
+		s->uca_ifg &= ~UCTXCPTIFG;
+		if(s->nrf_tx_due) {
+			double wait = s->time - s->nrf_on;
+			if(wait > s->nrf_tx_delay_max) {
+				s->nrf_tx_delay_max = wait;
+			}
+			s->nrf_tx_due = 0;
+		}
+		if(s->uca_tx_done < 0) {
+			s->uca_tx_shift = val & 0xFF;
+			s->uca_tx_done = s->time + uart_byte_time(s);
+			s->uca_ifg |= UCTXIFG;
+		}
+		else {
+			if(s->uca_tx_pending >= 0) {
+				fprintf(stderr, "msp430sim: UCA0TXBUF overwritten at %.6fs\n", s->time);
+			}
+			s->uca_tx_pending = val & 0xFF;
+			s->uca_ifg &= ~UCTXIFG;
+		}
+		break;
+	case 0x1A: s->uca_ie = merge(s->uca_ie, UCA_BASE + off, val, byte); break;
+	case 0x1C: s->uca_ifg = merge(s->uca_ifg, UCA_BASE + off, val, byte); break;
+	default: break;
+	}
+}
+
+static uint16_t uart_read(sim_t* s, uint16_t off) {
+	switch(off & ~1) {
+	case 0x00: return s->uca_ctlw0;
+	case 0x06: return s->uca_brw;
+	case 0x08: return s->uca_mctlw;
+	case 0x0C:
+		s->uca_ifg &= ~UCRXIFG;
+		return s->uca_rxbuf;
+	case 0x1A: return s->uca_ie;
+	case 0x1C: return s->uca_ifg;
+	case 0x1E:
+		// Reading UCAxIV clears the highest pending flag
+		if(s->uca_ifg & s->uca_ie & UCRXIFG) {
+			s->uca_ifg &= ~UCRXIFG;
+			return 2;
+		}
+		if(s->uca_ifg & s->uca_ie & UCTXIFG) {
+			s->uca_ifg &= ~UCTXIFG;
+			return 4;
+		}
+		if(s->uca_ifg & s->uca_ie & UCTXCPTIFG) {
+			s->uca_ifg &= ~UCTXCPTIFG;
+			return 8;
+		}
+		return 0;
+	default: return 0;
+	}
+}
+
+static void uart_tx_complete(sim_t* s) {
+	uart_log(s, (uint8_t)s->uca_tx_shift);
+	if(s->uca_tx_pending >= 0) {
+		s->uca_tx_shift = s->uca_tx_pending;
+		s->uca_tx_pending = -1;
+		s->uca_tx_done += uart_byte_time(s);
+		s->uca_ifg |= UCTXIFG;
+	}
+	else {
+		s->uca_tx_done = -1;
+		s->uca_ifg |= UCTXCPTIFG;
+	}
+}
+
+static void uart_rx_deliver(sim_t* s) {
+	sim_rx_t* msg = &s->rx[s->rx_next];
+	if(s->uca_ctlw0 & UCSWRST) {
+		fprintf(stderr, "msp430sim: RX byte dropped, UART in reset at %.6fs\n", s->rx_next_time);
+	}
+	else {
+		if(s->uca_ifg & UCRXIFG) {
+			fprintf(stderr, "msp430sim: RX overrun at %.6fs\n", s->rx_next_time);
+		}
+		s->uca_rxbuf = msg->data[s->rx_byte];
+		s->uca_ifg |= UCRXIFG;
+	}
+
+	double next = s->rx_next_time + uart_byte_time(s);
+	if(++s->rx_byte >= msg->len) {
+		s->rx_byte = 0;
+		s->rx_next++;
+		if(s->rx_next < s->rx_count && s->rx[s->rx_next].time > next) {
+			next = s->rx[s->rx_next].time;
+		}
+	}
+	s->rx_next_time = (s->rx_next < s->rx_count) ? next : -1;
+}
+
+/**************************************************************************
+   nRF POWER
+ **************************************************************************/
+static void nrf_power(sim_t* s) {
+	bool on = !(s->mem[SYS_EN_ADDR] & SYS_EN_PIN);
+	if(on && s->nrf_on < 0) {
+		s->nrf_on = s->time;
+		s->nrf_tx_due = 1;
+		s->nrf_boots++;
+		if(s->nrf_ready_delay >= 0) {
+			s->nrf_ready_time = s->time + s->nrf_ready_delay;
+		}
+	}
+	else if(!on && s->nrf_on >= 0) {
+		s->nrf_on = -1;
+		s->nrf_tx_due = 0;
+		s->nrf_ready_time = -1;
+	}
+}
+
+// The ready byte is unframed and arrives outside of any nRF message
+static void nrf_ready(sim_t* s) {
+	double t = s->nrf_ready_time;
+	s->nrf_ready_time = -1;
+	if(s->uca_ctlw0 & UCSWRST) {
+		fprintf(stderr, "msp430sim: ready byte dropped, UART in reset at %.6fs\n", t);
+		return;
+	}
+	s->uca_rxbuf = NRF_READY;
+	s->uca_ifg |= UCRXIFG;
+}
+
+/**************************************************************************
+   BUS
+ **************************************************************************/
+void periph_reset(sim_t* s) {
+	memset(s->csctl, 0, sizeof(s->csctl));
+	s->csctl[0] = 0x9600;
+	s->csctl[1] = 0x0006;		// DCO 8MHz
+	s->csctl[2] = 0x0033;
+	s->csctl[3] = 0x0033;		// MCLK = SMCLK = DCO/8
+	s->mclk_hz = 0;
+	cs_update(s);
+	s->mclk_switches = 0;
+	s->aclk_ticks = 0;
+	s->time = 0;
+	s->active_time = 0;
+
+	s->wdtctl = 0;
+	s->wdt_armed = 0;			// The power-on watchdog is not checked, see wdt_write
+	s->wdt_expired = 0;
+
+	memset(&s->ta0, 0, sizeof(s->ta0));
+	memset(&s->ta1, 0, sizeof(s->ta1));
+	s->ta0.base = TA0_BASE;
+	s->ta1.base = TA1_BASE;
+
+	s->adc_ctl0 = s->adc_ctl1 = s->adc_ctl2 = s->adc_mctl0 = 0;
+	s->adc_mem0 = s->adc_ie = s->adc_ifg = 0;
+	s->adc_done = -1;
+	if(s->adc_conv_time == 0) {
+		s->adc_conv_time = 3e-6;		// 4 + 11 MODOSC cycles
+	}
+	memset(s->adc_conversions, 0, sizeof(s->adc_conversions));
+
+	s->mpy_op1 = 0;
+	s->mpy_op1_32 = 0;
+	s->mpy_mode = 0;
+	s->mpy_op2_lo = 0;
+	s->mpy_base = 0;
+	memset(s->mpy_res, 0, sizeof(s->mpy_res));
+	s->mpy_sumext = 0;
+
+	s->uca_ctlw0 = UCSWRST;
+	s->uca_brw = s->uca_mctlw = s->uca_ie = s->uca_rxbuf = 0;
+	s->uca_ifg = UCTXIFG;
+	s->uca_tx_done = -1;
+	s->uca_tx_pending = -1;
+	s->rx_next = 0;
+	s->rx_byte = 0;
+	s->rx_next_time = (s->rx_count > 0) ? s->rx[0].time : -1;
+
+	s->mem[SYS_EN_ADDR] = 0;
+	s->nrf_on = -1;
+	s->nrf_ready_time = -1;
+	s->nrf_tx_due = 0;
+	s->nrf_boots = 0;
+	s->nrf_tx_delay_max = 0;
+}
+
+uint16_t periph_read(sim_t* s, uint16_t addr, bool byte) {
+	uint16_t a = addr & ~1;
+	sim_timer_t* t;
+
+	if(a >= CS_BASE && a < CS_BASE + 14) {
+		return pick(s->csctl[(a - CS_BASE) / 2], addr, byte);
+	}
+	if(a == WDTCTL_ADDR) {
+		return pick(0x6900 | s->wdtctl, addr, byte);
+	}
+	if((t = timer_at(s, a)) != NULL) {
+		return pick(timer_read(s, t, a - t->base), addr, byte);
+	}
+	if(a >= ADC_BASE && a < ADC_BASE + ADC_SIZE) {
+		return pick(adc_read(s, a - ADC_BASE), addr, byte);
+	}
+	if(a >= MPY_BASE && a < MPY_BASE + MPY_SIZE) {
+		return pick(mpy_read(s, a - MPY_BASE), addr, byte);
+	}
+	if(a >= UCA_BASE && a < UCA_BASE + UCA_SIZE) {
+		return pick(uart_read(s, a - UCA_BASE), addr, byte);
+	}
+
+	// Plain registers
+	if(byte) {
+		return s->mem[addr];
+	}
+	return s->mem[a] | (s->mem[a + 1] << 8);
+}
+
+void periph_write(sim_t* s, uint16_t addr, uint16_t val, bool byte) {
+	uint16_t a = addr & ~1;
+	sim_timer_t* t;
+
+	if(a >= CS_BASE && a < CS_BASE + 14) {
+		int i = (a - CS_BASE) / 2;
+		if(i > 0) {
+			s->csctl[i] = merge(s->csctl[i], addr, val, byte);
+			cs_update(s);
+		}
+		return;
+	}
+	if(a == WDTCTL_ADDR) {
+		wdt_write(s, val, byte);
+		return;
+	}
+	if((t = timer_at(s, a)) != NULL) {
+		uint16_t off = a - t->base;
+		timer_write(t, off, merge(timer_read(s, t, off == 0x2E ? 0 : off), addr, val, byte));
+		return;
+	}
+	if(a >= ADC_BASE && a < ADC_BASE + ADC_SIZE) {
+		uint16_t off = a - ADC_BASE;
+		adc_write(s, off, byte ? merge(adc_read(s, off == 0x12 || off == 0x1E ? 0 : off), addr, val, byte) : val);
+		return;
+	}
+	if(a >= MPY_BASE && a < MPY_BASE + MPY_SIZE) {
+		mpy_write(s, addr - MPY_BASE, val, byte);
+		return;
+	}
+	if(a >= UCA_BASE && a < UCA_BASE + UCA_SIZE) {
+		uart_write(s, addr - UCA_BASE, val, byte);
+		return;
+	}
+
+	if(byte) {
+		s->mem[addr] = (uint8_t)val;
+	}
+	else {
+		s->mem[a] = val & 0xFF;
+		s->mem[a + 1] = val >> 8;
+	}
+	if(a == SYS_EN_ADDR) {
+		nrf_power(s);
+	}
+}
+
+// Bring every peripheral up to time t
+void periph_run_to(sim_t* s, double t) {
+	while((double)(s->aclk_ticks + 1) <= t * ACLK_HZ + 1e-6) {
+		s->aclk_ticks++;
+		timer_tick(&s->ta0);
+		timer_tick(&s->ta1);
+	}
+	if(s->adc_done >= 0 && s->adc_done <= t) {
+		adc_complete(s);
+	}
+	while(s->uca_tx_done >= 0 && s->uca_tx_done <= t) {
+		uart_tx_complete(s);
+	}
+	while(s->rx_next_time >= 0 && s->rx_next_time <= t) {
+		uart_rx_deliver(s);
+	}
+	if(s->nrf_ready_time >= 0 && s->nrf_ready_time <= t) {
+		nrf_ready(s);
+	}
+	if(s->wdt_armed && t - s->wdt_cleared > wdt_period(s)) {
+		fprintf(stderr, "msp430sim: watchdog expired at %.6fs\n", t);
+		s->wdt_expired = 1;
+		s->halted = 1;
+	}
+	s->time = t;
+}
+
+// Advance by cycles of MCLK
+void periph_advance(sim_t* s, unsigned cycles) {
+	periph_run_to(s, s->time + cycles / s->mclk_hz);
+}
+
+// Time of the next event that can raise an interrupt, <0 if none
+double periph_next_event(sim_t* s) {
+	double next = -1;
+	uint32_t d;
+
+#define CONSIDER(x)	do { double _e = (x); if(_e >= 0 && (next < 0 || _e < next)) next = _e; } while(0)
+	CONSIDER(s->adc_done);
+	CONSIDER(s->uca_tx_done);
+	CONSIDER(s->rx_next_time);
+	CONSIDER(s->nrf_ready_time);
+	if((d = timer_ticks_to_irq(&s->ta0)) != 0) {
+		CONSIDER((s->aclk_ticks + d) / ACLK_HZ);
+	}
+	if((d = timer_ticks_to_irq(&s->ta1)) != 0) {
+		CONSIDER((s->aclk_ticks + d) / ACLK_HZ);
+	}
+	if(s->wdt_armed) {
+		CONSIDER(s->wdt_cleared + wdt_period(s));
+	}
+#undef CONSIDER
+	return next;
+}
+
+static bool cc_pending(uint16_t cctl) {
+	return (cctl & (CCIFG | CCIE)) == (CCIFG | CCIE);
+}
+
+// Highest priority enabled interrupt that is pending, -1 if none
+int periph_pending(sim_t* s) {
+	if(s->uca_ifg & s->uca_ie & (UCRXIFG | UCTXIFG | UCTXCPTIFG)) {
+		return irq_usci_a0;
+	}
+	if(s->adc_ifg & s->adc_ie & ADC10IFG0) {
+		return irq_adc10;
+	}
+	if(cc_pending(s->ta0.cctl[0])) {
+		return irq_ta0_ccr0;
+	}
+	if(cc_pending(s->ta0.cctl[1]) || cc_pending(s->ta0.cctl[2]) || (s->ta0.ctl & (TAIFG | TAIE)) == (TAIFG | TAIE)) {
+		return irq_ta0;
+	}
+	if(cc_pending(s->ta1.cctl[0])) {
+		return irq_ta1_ccr0;
+	}
+	if(cc_pending(s->ta1.cctl[1]) || cc_pending(s->ta1.cctl[2]) || (s->ta1.ctl & (TAIFG | TAIE)) == (TAIFG | TAIE)) {
+		return irq_ta1;
+	}
+	return -1;
+}
+
+// Accepting a CCR0 interrupt clears its flag
+void periph_accept(sim_t* s, irq_t irq) {
+	if(irq == irq_ta0_ccr0) {
+		s->ta0.cctl[0] &= ~CCIFG;
+	}
+	else if(irq == irq_ta1_ccr0) {
+		s->ta1.cctl[0] &= ~CCIFG;
+	}
+}
@@ -0,0 +1,176 @@
+/*
+ * Instruction self-test for the MSP430 CPU core (iss_cpu.c)
+ *
+ * Each vector is one instruction, hand-assembled from the MSP430 instruction
+ * formats in SLAU272, with R4, R5, SR and one word of memory set before it
+ * and checked after it. Cycle counts are the MSP430X CPU table values. Runs
+ * on the host, no msp430-elf-gcc needed.
+ *
+ *   iss_test [--verbose]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "iss.h"
+
+#define CODE	0x4400		// First instruction word
+#define DATA	0x2000		// The word of memory each vector sees
+
+#define FLAGS	(SR_C | SR_Z | SR_N | SR_V)
+
+#define C	SR_C
+#define Z	SR_Z
+#define N	SR_N
+#define V	SR_V
+
+typedef struct {
+	const char* text;
+	uint16_t code[3];
+	// Before
+	uint16_t sr, r4, r5, mem;
+	// After
+	uint16_t exp_sr, exp_r4, exp_r5, exp_mem, exp_pc;
+	unsigned cycles;
+	uint16_t undefined;		// Flags the instruction leaves undefined
+} vector_t;
+
+static const vector_t vectors[] = {
+	// text                  code                          sr   r4          r5      mem       sr     r4          r5      mem     pc           cycles
+
+	// Addressing modes, source
+	{ "mov r4, r5",          { 0x4405 },                   0,   0x1234,     0,      0,        0,     0x1234,     0x1234, 0,      CODE + 2,    1 },
+	{ "mov #0x5678, r5",     { 0x4035, 0x5678 },           0,   0,          0,      0,        0,     0,          0x5678, 0,      CODE + 4,    2 },
+	{ "mov @r4, r5",         { 0x4425 },                   0,   DATA,       0,      0xA5A5,   0,     DATA,       0xA5A5, 0xA5A5, CODE + 2,    2 },
+	{ "mov @r4+, r5",        { 0x4435 },                   0,   DATA,       0,      0xA5A5,   0,     DATA + 2,   0xA5A5, 0xA5A5, CODE + 2,    2 },
+	{ "mov.b @r4+, r5",      { 0x4475 },                   0,   DATA,       0xFFFF, 0x12A5,   0,     DATA + 1,   0x00A5, 0x12A5, CODE + 2,    2 },
+	{ "mov 2(r4), r5",       { 0x4415, 0x0002 },           0,   DATA - 2,   0,      0x1234,   0,     DATA - 2,   0x1234, 0x1234, CODE + 4,    3 },
+	{ "mov &DATA, r5",       { 0x4215, DATA },             0,   0,          0,      0x1234,   0,     0,          0x1234, 0x1234, CODE + 4,    3 },
+	{ "mov DATA, r5",        { 0x4015, (uint16_t)(DATA - (CODE + 2)) },
+	                                                       0,   0,          0,      0x1234,   0,     0,          0x1234, 0x1234, CODE + 4,    3 },
+
+	// Constant generators
+	{ "mov #0, r5",          { 0x4305 },                   0,   0,          0xFFFF, 0,        0,     0,          0,      0,      CODE + 2,    1 },
+	{ "mov #1, r5",          { 0x4315 },                   0,   0,          0,      0,        0,     0,          1,      0,      CODE + 2,    1 },
+	{ "mov #2, r5",          { 0x4325 },                   0,   0,          0,      0,        0,     0,          2,      0,      CODE + 2,    1 },
+	{ "mov #4, r5",          { 0x4225 },                   0,   0,          0,      0,        0,     0,          4,      0,      CODE + 2,    1 },
+	{ "mov #8, r5",          { 0x4235 },                   0,   0,          0,      0,        0,     0,          8,      0,      CODE + 2,    1 },
+	{ "mov #-1, r5",         { 0x4335 },                   0,   0,          0,      0,        0,     0,          0xFFFF, 0,      CODE + 2,    1 },
+
+	// Addressing modes, destination
+	{ "mov.b r4, r5",        { 0x4445 },                   0,   0x1234,     0xFFFF, 0,        0,     0x1234,     0x0034, 0,      CODE + 2,    1 },
+	{ "mov r5, 0(r4)",       { 0x4584, 0x0000 },           0,   DATA,       0xBEEF, 0,        0,     DATA,       0xBEEF, 0xBEEF, CODE + 4,    3 },
+	{ "mov.b r5, 0(r4)",     { 0x45C4, 0x0000 },           0,   DATA,       0x1234, 0xFFFF,   0,     DATA,       0x1234, 0xFF34, CODE + 4,    3 },
+	{ "add r5, 0(r4)",       { 0x5584, 0x0000 },           0,   DATA,       1,      0x00FF,   0,     DATA,       1,      0x0100, CODE + 4,    4 },
+	{ "add r5, &DATA",       { 0x5582, DATA },             0,   0,          1,      0xFFFF,   C|Z,   0,          1,      0,      CODE + 4,    4 },
+	{ "mov #0x4500, pc",     { 0x4030, 0x4500 },           0,   0,          0,      0,        0,     0,          0,      0,      0x4500,      3 },
+
+	// Arithmetic flags
+	{ "add r4, r5",          { 0x5405 },                   0,   0x7FFF,     1,      0,        N|V,   0x7FFF,     0x8000, 0,      CODE + 2,    1 },
+	{ "add r4, r5",          { 0x5405 },                   0,   0xFFFF,     1,      0,        C|Z,   0xFFFF,     0,      0,      CODE + 2,    1 },
+	{ "add.b r4, r5",        { 0x5445 },                   0,   0x0080,     0x1280, 0,        C|Z|V, 0x0080,     0,      0,      CODE + 2,    1 },
+	{ "addc r4, r5",         { 0x6405 },                   C,   1,          1,      0,        0,     1,          3,      0,      CODE + 2,    1 },
+	{ "sub r4, r5",          { 0x8405 },                   0,   2,          1,      0,        N,     2,          0xFFFF, 0,      CODE + 2,    1 },
+	{ "sub r4, r5",          { 0x8405 },                   0,   1,          2,      0,        C,     1,          1,      0,      CODE + 2,    1 },
+	{ "sub r4, r5",          { 0x8405 },                   0,   1,          0x8000, 0,        C|V,   1,          0x7FFF, 0,      CODE + 2,    1 },
+	{ "subc r4, r5",         { 0x7405 },                   0,   2,          5,      0,        C,     2,          2,      0,      CODE + 2,    1 },
+	{ "cmp r4, r5",          { 0x9405 },                   0,   0x1234,     0x1234, 0,        C|Z,   0x1234,     0x1234, 0,      CODE + 2,    1 },
+
+	// Logic flags
+	{ "bit r4, r5",          { 0xB405 },                   0,   0x0010,     0x0011, 0,        C,     0x0010,     0x0011, 0,      CODE + 2,    1 },
+	{ "bit r4, r5",          { 0xB405 },                   C|V, 0x0100,     0x0011, 0,        Z,     0x0100,     0x0011, 0,      CODE + 2,    1 },
+	{ "xor r4, r5",          { 0xE405 },                   0,   0x8000,     0x8001, 0,        C|V,   0x8000,     0x0001, 0,      CODE + 2,    1 },
+	{ "and r4, r5",          { 0xF405 },                   V,   0x8001,     0xFFFF, 0,        C|N,   0x8001,     0x8001, 0,      CODE + 2,    1 },
+	{ "bic r4, r5",          { 0xC405 },                   FLAGS, 0x00FF,   0x1234, 0,        FLAGS, 0x00FF,     0x1200, 0,      CODE + 2,    1 },
+	{ "bis r4, r5",          { 0xD405 },                   0,   0x0F00,     0x0034, 0,        0,     0x0F00,     0x0F34, 0,      CODE + 2,    1 },
+
+	// Decimal add, V is undefined
+	{ "dadd r4, r5",         { 0xA405 },                   0,   0x0199,     0x0001, 0,        0,     0x0199,     0x0200, 0,      CODE + 2,    1, V },
+	{ "dadd r4, r5",         { 0xA405 },                   0,   0x9999,     0x0001, 0,        C|Z,   0x9999,     0,      0,      CODE + 2,    1, V },
+	{ "dadd r4, r5",         { 0xA405 },                   C,   0,          0x0009, 0,        0,     0,          0x0010, 0,      CODE + 2,    1, V },
+	{ "dadd r4, r5",         { 0xA405 },                   0,   0x4321,     0x5678, 0,        N,     0x4321,     0x9999, 0,      CODE + 2,    1, V },
+	{ "dadd.b r4, r5",       { 0xA445 },                   0,   0x0099,     0x1201, 0,        C|Z,   0x0099,     0,      0,      CODE + 2,    1, V },
+	{ "dadd r4, 0(r4)",      { 0xA484, 0x0000 },           C,   DATA,       0,      0x0815,   0,     DATA,       0,      0x2816, CODE + 4,    4, V },
+
+	// Rotates, SWPB, SXT
+	{ "rrc r5",              { 0x1005 },                   C,   0,          0x0002, 0,        N,     0,          0x8001, 0,      CODE + 2,    1 },
+	{ "rrc r5",              { 0x1005 },                   V,   0,          0x0001, 0,        C|Z,   0,          0,      0,      CODE + 2,    1 },
+	{ "rrc.b r5",            { 0x1045 },                   C,   0,          0x1202, 0,        N,     0,          0x0081, 0,      CODE + 2,    1 },
+	{ "rra r5",              { 0x1105 },                   0,   0,          0x8002, 0,        N,     0,          0xC001, 0,      CODE + 2,    1 },
+	{ "rra r5",              { 0x1105 },                   C,   0,          0x0003, 0,        C,     0,          0x0001, 0,      CODE + 2,    1 },
+	{ "rra.b r5",            { 0x1145 },                   0,   0,          0x1281, 0,        C|N,   0,          0x00C0, 0,      CODE + 2,    1 },
+	{ "rrc @r4",             { 0x1024 },                   0,   DATA,       0,      0x0003,   C,     DATA,       0,      0x0001, CODE + 2,    3 },
+	{ "rra 2(r4)",           { 0x1114, 0x0002 },           0,   DATA - 2,   0,      0x8000,   N,     DATA - 2,   0,      0xC000, CODE + 4,    4 },
+	{ "swpb r5",             { 0x1085 },                   0,   0,          0x1234, 0,        0,     0,          0x3412, 0,      CODE + 2,    1 },
+	{ "sxt r5",              { 0x1185 },                   0,   0,          0x0080, 0,        C|N,   0,          0xFF80, 0,      CODE + 2,    1 },
+
+	// Jumps, offsets in words from the next instruction
+	{ "jne $+6",             { 0x2002 },                   0,   0,          0,      0,        0,     0,          0,      0,      CODE + 6,    2 },
+	{ "jeq $+6",             { 0x2402 },                   0,   0,          0,      0,        0,     0,          0,      0,      CODE + 2,    2 },
+	{ "jc $+6",              { 0x2C02 },                   C,   0,          0,      0,        C,     0,          0,      0,      CODE + 6,    2 },
+	{ "jge $+6",             { 0x3402 },                   N|V, 0,          0,      0,        N|V,   0,          0,      0,      CODE + 6,    2 },
+	{ "jl $+6",              { 0x3802 },                   N,   0,          0,      0,        N,     0,          0,      0,      CODE + 6,    2 },
+	{ "jmp $",               { 0x3FFF },                   0,   0,          0,      0,        0,     0,          0,      0,      CODE,        2 },
+};
+
+#define VECTOR_COUNT	(sizeof(vectors) / sizeof(vectors[0]))
+
+static sim_t sim;
+
+// Run one vector, returns the number of mismatches
+static int run(const vector_t* v, bool verbose) {
+	sim_t* s = &sim;
+	int i, bad = 0;
+
+	memset(s, 0, sizeof(*s));
+	cpu_reset(s, CODE);
+	for(i = 0; i < 3; i++) {
+		mem_write(s, CODE + 2*i, v->code[i], 0);
+	}
+	mem_write(s, DATA, v->mem, 0);
+	s->reg[SP] = DATA + 0x100;
+	s->reg[SR] = v->sr;
+	s->reg[4] = v->r4;
+	s->reg[5] = v->r5;
+
+	unsigned cycles = cpu_step(s);
+
+	uint16_t flags = FLAGS & ~v->undefined;
+	struct { const char* what; unsigned got, want; } checks[] = {
+		{ "sr", s->reg[SR] & flags, v->exp_sr & flags },
+		{ "r4", s->reg[4], v->exp_r4 },
+		{ "r5", s->reg[5], v->exp_r5 },
+		{ "mem", mem_read(s, DATA, 0), v->exp_mem },
+		{ "pc", s->reg[PC], v->exp_pc },
+		{ "cycles", cycles, v->cycles },
+	};
+	for(i = 0; i < (int)(sizeof(checks) / sizeof(checks[0])); i++) {
+		if(checks[i].got != checks[i].want) {
+			printf("%-20s %-6s %04x, expected %04x\n", v->text, checks[i].what, checks[i].got, checks[i].want);
+			bad++;
+		}
+	}
+	if(s->halted) {
+		printf("%-20s halted\n", v->text);
+		bad++;
+	}
+	if(verbose && !bad) {
+		printf("%-20s ok\n", v->text);
+	}
+	return bad;
+}
+
+int main(int argc, char** argv) {
+	bool verbose = (argc > 1 && strcmp(argv[1], "--verbose") == 0);
+	unsigned i, failed = 0;
+
+	for(i = 0; i < VECTOR_COUNT; i++) {
+		if(run(&vectors[i], verbose)) {
+			failed++;
+		}
+	}
+
+	printf("%u instructions, %u failed\n", (unsigned) VECTOR_COUNT, failed);
+	printf(failed ? "FAILED\n" : "PASSED\n");
+	return failed ? 1 : 0;
+}
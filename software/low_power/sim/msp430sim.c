@@ -0,0 +1,880 @@
+/*
+ * msp430sim - run the PowerBlade MSP430 firmware on an instruction-set
+ * simulator and check its timing and output
+ *
+ * Loads an msp430-elf image, replays recorded ADC samples into ADC10_B,
+ * optionally plays messages from the nRF into the UART, and runs for a fixed
+ * simulated time. Reports per-ISR and per-function cycle counts and decodes
+ * every packet the firmware sends. Exits non-zero when a budget or
+ * expectation fails.
+ *
+ * Built with HOST_FIRMWARE it is hostsim instead: the firmware is compiled
+ * for the host and linked in (host/firmware.cpp), and runs against the same
+ * peripheral models. Output checks are the same, cycle budgets are ignored.
+ */
+
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iss.h"
+#include "powerblade_test.h"
+#include "uart_types.h"
+
+#define MAX_CHECKS	16
+
+typedef struct {
+	char* name;
+	uint16_t value;
+	uint16_t size;
+} symbol_t;
+
+// Cycle statistics for one ISR or function
+typedef struct {
+	const char* name;
+	uint16_t addr;
+	uint64_t count;
+	uint64_t total;				// MCLK cycles
+	uint64_t max;
+	double max_time;			// Seconds, for budgets at the reference clock
+	double budget;				// Reference cycles, 0 for none
+
+	// Function in progress
+	bool active;
+	uint16_t ret_sp, ret_addr;
+	uint64_t start_cycles, start_isr_cycles;
+	double start_time, start_isr_time;
+} stat_t;
+
+typedef struct {
+	irq_t irq;
+	uint16_t sp;				// SP after entry, RETI pops back above it
+	uint64_t start_cycles;
+	double start_time;
+} isr_frame_t;
+
+static symbol_t* symbols;
+static size_t symbol_count;
+
+static stat_t isr_stats[IRQ_COUNT];
+static stat_t fn_stats[MAX_CHECKS];
+static int fn_count;
+static isr_frame_t isr_stack[IRQ_COUNT];
+static int isr_depth;
+static uint64_t isr_cycles;		// Cycles spent in ISRs, including entry
+static double isr_time;
+static uint16_t sp_min = 0xFFFF;
+
+static bool failed;
+
+static void fail(const char* fmt, const char* what, double a, double b) {
+	printf("FAIL: ");
+	printf(fmt, what, a, b);
+	printf("\n");
+	failed = 1;
+}
+
+/**************************************************************************
+   ELF LOADING
+ **************************************************************************/
+static void* read_file(const char* path, size_t* len) {
+	FILE* f = fopen(path, "rb");
+	if(!f) {
+		perror(path);
+		exit(2);
+	}
+	fseek(f, 0, SEEK_END);
+	*len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	void* buf = malloc(*len);
+	if(!buf || fread(buf, 1, *len, f) != *len) {
+		fprintf(stderr, "msp430sim: can't read %s\n", path);
+		exit(2);
+	}
+	fclose(f);
+	return buf;
+}
+
+static uint16_t load_elf(sim_t* s, const char* path) {
+	size_t len;
+	uint8_t* buf = read_file(path, &len);
+	Elf32_Ehdr* eh = (Elf32_Ehdr*) buf;
+
+	if(len < sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 || eh->e_ident[EI_CLASS] != ELFCLASS32) {
+		fprintf(stderr, "msp430sim: %s is not a 32-bit ELF file\n", path);
+		exit(2);
+	}
+	if(eh->e_machine != EM_MSP430) {
+		fprintf(stderr, "msp430sim: %s is not an MSP430 image\n", path);
+		exit(2);
+	}
+
+	// Segments go where the flash programmer would put them
+	int i;
+	for(i = 0; i < eh->e_phnum; i++) {
+		Elf32_Phdr* ph = (Elf32_Phdr*)(buf + eh->e_phoff + i * eh->e_phentsize);
+		if(ph->p_type != PT_LOAD || ph->p_filesz == 0) {
+			continue;
+		}
+		if(ph->p_paddr + ph->p_filesz > 0x10000) {
+			fprintf(stderr, "msp430sim: segment at %x doesn't fit in 64K\n", ph->p_paddr);
+			exit(2);
+		}
+		memcpy(s->mem + ph->p_paddr, buf + ph->p_offset, ph->p_filesz);
+	}
+
+	for(i = 0; i < eh->e_shnum; i++) {
+		Elf32_Shdr* sh = (Elf32_Shdr*)(buf + eh->e_shoff + i * eh->e_shentsize);
+		if(sh->sh_type != SHT_SYMTAB) {
+			continue;
+		}
+		Elf32_Shdr* strs = (Elf32_Shdr*)(buf + eh->e_shoff + sh->sh_link * eh->e_shentsize);
+		size_t n = sh->sh_size / sizeof(Elf32_Sym);
+		symbols = calloc(n, sizeof(symbol_t));
+		size_t j;
+		for(j = 0; j < n; j++) {
+			Elf32_Sym* sym = (Elf32_Sym*)(buf + sh->sh_offset + j * sizeof(Elf32_Sym));
+			if(sym->st_name == 0 || sym->st_shndx == SHN_UNDEF) {
+				continue;
+			}
+			symbols[symbol_count].name = strdup((char*)buf + strs->sh_offset + sym->st_name);
+			symbols[symbol_count].value = (uint16_t) sym->st_value;
+			symbols[symbol_count].size = (uint16_t) sym->st_size;
+			symbol_count++;
+		}
+	}
+
+	uint16_t entry = (uint16_t) eh->e_entry;
+	free(buf);
+	return entry;
+}
+
+static symbol_t* find_symbol(const char* name) {
+	size_t i;
+	for(i = 0; i < symbol_count; i++) {
+		if(strcmp(symbols[i].name, name) == 0) {
+			return &symbols[i];
+		}
+	}
+	return NULL;
+}
+
+// Variable in the image, for --expect-zero
+static bool symbol_value(sim_t* s, const char* name, uint32_t* value) {
+#if defined (HOST_FIRMWARE)
+	return fw_symbol(name, value);
+#else
+	symbol_t* sym = find_symbol(name);
+	if(!sym) {
+		return 0;
+	}
+	uint32_t v = 0;
+	int b = (sym->size == 0) ? 2 : (sym->size > 4) ? 4 : sym->size;
+	while(--b >= 0) {
+		v = (v << 8) | s->mem[(uint16_t)(sym->value + b)];
+	}
+	*value = v;
+	return 1;
+#endif
+}
+
+/**************************************************************************
+   INPUT FILES
+ **************************************************************************/
+// Replay file: "# rate <Hz>" and "# inch <n> ..." headers, then one row of
+// ADC codes per line, one column per listed input
+static void load_replay(sim_t* s, const char* path) {
+	FILE* f = fopen(path, "r");
+	if(!f) {
+		perror(path);
+		exit(2);
+	}
+	int inch[REPLAY_INCH];
+	int ninch = 0;
+	size_t cap = 0;
+	char line[512];
+
+	while(fgets(line, sizeof(line), f)) {
+		if(line[0] == '#') {
+			char* tok = strtok(line + 1, " \t\r\n");
+			if(tok && strcmp(tok, "rate") == 0) {
+				s->replay.rate = atof(strtok(NULL, " \t\r\n"));
+			}
+			else if(tok && strcmp(tok, "inch") == 0) {
+				while((tok = strtok(NULL, " \t\r\n")) && ninch < REPLAY_INCH) {
+					inch[ninch++] = atoi(tok) & (REPLAY_INCH - 1);
+				}
+			}
+			continue;
+		}
+		if(ninch == 0 || s->replay.rate <= 0) {
+			fprintf(stderr, "msp430sim: %s needs '# rate' and '# inch' before the samples\n", path);
+			exit(2);
+		}
+		if(s->replay.count == cap) {
+			cap = cap ? 2 * cap : 4096;
+			s->replay.rows = realloc(s->replay.rows, cap * sizeof(*s->replay.rows));
+		}
+		uint16_t* row = s->replay.rows[s->replay.count];
+		int k;
+		for(k = 0; k < REPLAY_INCH; k++) {
+			row[k] = 0x200;
+		}
+		char* tok = strtok(line, " \t,\r\n");
+		for(k = 0; k < ninch && tok; k++, tok = strtok(NULL, " \t,\r\n")) {
+			row[inch[k]] = (uint16_t) strtoul(tok, NULL, 0);
+		}
+		if(k > 0) {
+			s->replay.count++;
+		}
+	}
+	fclose(f);
+}
+
+// RX script: "<seconds> <type> [payload bytes]" in hex, framed and
+// checksummed here, or "<seconds> raw <bytes>" sent as is
+static void load_rx(sim_t* s, const char* path) {
+	FILE* f = fopen(path, "r");
+	if(!f) {
+		perror(path);
+		exit(2);
+	}
+	char line[512];
+	while(fgets(line, sizeof(line), f)) {
+		char* tok = strtok(line, " \t\r\n");
+		if(!tok || tok[0] == '#') {
+			continue;
+		}
+		s->rx = realloc(s->rx, (s->rx_count + 1) * sizeof(sim_rx_t));
+		sim_rx_t* msg = &s->rx[s->rx_count++];
+		msg->time = atof(tok);
+		msg->len = 0;
+
+		tok = strtok(NULL, " \t\r\n");
+		bool raw = tok && strcmp(tok, "raw") == 0;
+		if(raw) {
+			tok = strtok(NULL, " \t\r\n");
+		}
+		else {
+			msg->len = 2;		// Length filled in below
+		}
+		for(; tok && msg->len < sizeof(msg->data) - 1; tok = strtok(NULL, " \t\r\n")) {
+			msg->data[msg->len++] = (uint8_t) strtoul(tok, NULL, 16);
+		}
+		if(!raw) {
+			unsigned total = msg->len + 1;
+			msg->data[0] = total >> 8;
+			msg->data[1] = total & 0xFF;
+			uint16_t sum = 0;
+			unsigned i;
+			for(i = 0; i < msg->len; i++) {
+				sum += msg->data[i];
+			}
+			sum = (sum >> 8) + (sum & 0xFF);
+			sum += sum >> 8;
+			msg->data[msg->len++] = (uint8_t) ~sum;
+		}
+	}
+	fclose(f);
+}
+
+/**************************************************************************
+   STATISTICS
+ **************************************************************************/
+static void stat_add(stat_t* st, uint64_t cycles, double seconds) {
+	st->count++;
+	st->total += cycles;
+	if(cycles > st->max) {
+		st->max = cycles;
+	}
+	if(seconds > st->max_time) {
+		st->max_time = seconds;
+	}
+}
+
+static stat_t* isr_by_name(const char* name, size_t len) {
+	int i;
+	for(i = 0; i < IRQ_COUNT; i++) {
+		if(strlen(isr_stats[i].name) == len && strncmp(isr_stats[i].name, name, len) == 0) {
+			return &isr_stats[i];
+		}
+	}
+	return NULL;
+}
+
+// Runs of one ISR so far, for --expect-rate
+static uint64_t isr_runs(irq_t irq) {
+#if defined (HOST_FIRMWARE)
+	return fw_isr_runs[irq];
+#else
+	return isr_stats[irq].count;
+#endif
+}
+
+static void fn_enter(sim_t* s) {
+	int i;
+	for(i = 0; i < fn_count; i++) {
+		stat_t* st = &fn_stats[i];
+		if(!st->active && s->reg[PC] == st->addr) {
+			st->active = 1;
+			st->ret_sp = s->reg[SP] + 2;
+			st->ret_addr = mem_read(s, s->reg[SP], 0);
+			st->start_cycles = s->cycles;
+			st->start_isr_cycles = isr_cycles;
+			st->start_time = s->time;
+			st->start_isr_time = isr_time;
+		}
+	}
+}
+
+// Function time excludes interrupts taken while it ran
+static void fn_leave(sim_t* s) {
+	int i;
+	for(i = 0; i < fn_count; i++) {
+		stat_t* st = &fn_stats[i];
+		if(st->active && s->reg[SP] == st->ret_sp && s->reg[PC] == st->ret_addr) {
+			st->active = 0;
+			stat_add(st, (s->cycles - st->start_cycles) - (isr_cycles - st->start_isr_cycles),
+					(s->time - st->start_time) - (isr_time - st->start_isr_time));
+		}
+	}
+}
+
+/**************************************************************************
+   RUN
+ **************************************************************************/
+// Charge c active MCLK cycles at the current frequency
+static void account(sim_t* s, unsigned c) {
+	double t = c / s->mclk_hz;
+	int i;
+	s->cycles += c;
+	s->active_cycles += c;
+	s->active_time += t;
+	if(isr_depth > 0) {
+		isr_cycles += c;
+		isr_time += t;
+	}
+	for(i = 0; i < s->freq_count && s->freq_hz[i] != s->mclk_hz; i++);
+	if(i == s->freq_count && i < 8) {
+		s->freq_hz[s->freq_count++] = s->mclk_hz;
+	}
+	if(i < 8) {
+		s->freq_active[i] += t;
+	}
+}
+
+static void take_interrupt(sim_t* s, irq_t irq) {
+	if(s->isr_addr[irq] == 0) {
+		fprintf(stderr, "msp430sim: %s pending but no %s in the image\n", irq_name(irq), irq_name(irq));
+		s->halted = 1;
+		return;
+	}
+	cpu_interrupt(s, irq);
+	periph_accept(s, irq);
+
+	isr_frame_t* fr = &isr_stack[isr_depth++];
+	fr->irq = irq;
+	fr->sp = s->reg[SP];
+	fr->start_cycles = s->cycles;
+	fr->start_time = s->time;
+
+	account(s, INT_LATENCY);
+	periph_advance(s, INT_LATENCY);
+}
+
+static void run(sim_t* s, double seconds) {
+	while(!s->halted && s->time < seconds) {
+		if((s->reg[SR] & SR_GIE) && isr_depth < IRQ_COUNT) {
+			int irq = periph_pending(s);
+			if(irq >= 0) {
+				take_interrupt(s, (irq_t) irq);
+				continue;
+			}
+		}
+
+		if(s->reg[SR] & SR_CPUOFF) {
+			if(!(s->reg[SR] & SR_GIE)) {
+				fprintf(stderr, "msp430sim: LPM entered with interrupts disabled at %.6fs\n", s->time);
+				failed = 1;
+				break;
+			}
+			double next = periph_next_event(s);
+			if(next < 0 || next > seconds) {
+				periph_run_to(s, seconds);
+				break;
+			}
+			periph_run_to(s, next > s->time ? next : s->time);
+			continue;
+		}
+
+		fn_enter(s);
+		bool reti = mem_read(s, s->reg[PC], 0) == 0x1300;
+		unsigned c = cpu_step(s);
+		account(s, c);
+		periph_advance(s, c);
+		if(s->reg[SP] < sp_min) {
+			sp_min = s->reg[SP];
+		}
+
+		if(reti && isr_depth > 0 && s->reg[SP] == isr_stack[isr_depth - 1].sp + 4) {
+			isr_frame_t* fr = &isr_stack[--isr_depth];
+			stat_add(&isr_stats[fr->irq], s->cycles - fr->start_cycles, s->time - fr->start_time);
+		}
+		fn_leave(s);
+	}
+}
+
+/**************************************************************************
+   OUTPUT CHECKS
+ **************************************************************************/
+typedef struct {
+	bool set;
+	double lo, hi;
+} range_t;
+
+static range_t expect_vrms, expect_power;
+static int expect_types[MAX_CHECKS];
+static int expect_type_count;
+static unsigned expect_packets;
+static unsigned expect_fast;
+static bool verbose;
+
+static uint32_t be(const uint8_t* p, int len) {
+	uint32_t v = 0;
+	int i;
+	for(i = 0; i < len; i++) {
+		v = (v << 8) | p[i];
+	}
+	return v;
+}
+
+static void check_range(range_t* r, const char* what, double v) {
+	if(r->set && (v < r->lo || v > r->hi)) {
+		printf("FAIL: %s %.0f outside %.0f:%.0f\n", what, v, r->lo, r->hi);
+		failed = 1;
+	}
+}
+
+// Bytes in one reply item, data type included. A packet can carry several
+// (UART_BATCH_VERSION), sample blocks and unknown types run to the checksum
+static unsigned reply_len(int type, unsigned left) {
+	unsigned len;
+	switch(type) {
+	case GET_CONF:		len = 1 + sizeof(PowerBladeConfig_t); break;
+	case GET_VER:		len = 2; break;
+	case GET_STATS:		len = 1 + STATS_LEN; break;
+	case DONE_TRIGGER:	len = 1 + DONE_TRIGGER_LEN; break;
+	case FAST_DATA:		len = 1 + FAST_DATA_LEN; break;
+	case EVENT_SIG:		len = 1 + EVENT_SIG_LEN; break;
+	case EVENT_PQ:		len = 1 + EVENT_PQ_LEN; break;
+	case START_LOCALC: case CONT_LOCALC: case DONE_LOCALC:
+	case START_SAMDATA: case DONE_SAMDATA: case START_TRIGGER:
+	case START_FAST: case DONE_FAST: case UART_NAK:
+		len = 1; break;
+	default:			len = left; break;
+	}
+	return len < left ? len : left;
+}
+
+static void check_packets(sim_t* s) {
+	size_t at = 0;
+	unsigned packets = 0, adverts = 0;
+	bool have_seq = 0;
+	uint32_t last_seq = 0;
+	bool seen[256] = {0};
+	unsigned fast = 0, fast_gaps = 0;
+	uint16_t fast_next = 0;
+
+	while(at + 2 <= s->tx_len) {
+		const uint8_t* p = s->tx_log + at;
+		unsigned len = be(p, 2);
+		if(len < UARTOVHD) {
+			printf("FAIL: bad packet length %u at byte %zu\n", len, at);
+			failed = 1;
+			return;
+		}
+		if(at + len > s->tx_len) {
+			break;		// Still on the wire when the run ended
+		}
+		packets++;
+
+		uint16_t sum = 0;
+		unsigned i;
+		for(i = 0; i < len - 1; i++) {
+			sum += p[i];
+		}
+		sum = (sum >> 8) + (sum & 0xFF);
+		sum += sum >> 8;
+		if((uint8_t) ~sum != p[len - 1]) {
+			printf("FAIL: checksum mismatch in packet %u\n", packets);
+			failed = 1;
+		}
+
+		unsigned ad_len = p[OFFSET_ADLEN];
+		int type = (len > UARTOVHD - 1 + ad_len + 1) ? p[OFFSET_ADLEN + 1 + ad_len] : -1;
+		unsigned item;
+		for(item = OFFSET_ADLEN + 1 + ad_len; item < len - 1; item += reply_len(p[item], len - 1 - item)) {
+			seen[p[item]] = 1;
+		}
+
+		if(ad_len == ADLEN) {
+			uint32_t seq = be(p + OFFSET_SEQ, 4);
+			unsigned vrms = p[OFFSET_VRMS];
+			unsigned tp = be(p + OFFSET_TP, 2);
+			unsigned ap = be(p + OFFSET_AP, 2);
+			if(verbose) {
+				printf("  packet %3u: seq %u vrms %u tp %u ap %u wh %u flags 0x%02x type %s%02x\n", packets,
+						seq, vrms, tp, ap, be(p + OFFSET_WH, 4), p[OFFSET_FLAGS], type < 0 ? "-" : "0x", type < 0 ? 0 : type);
+			}
+			if(have_seq && seq != last_seq + 1) {
+				printf("FAIL: sequence %u follows %u\n", seq, last_seq);
+				failed = 1;
+			}
+			have_seq = 1;
+			last_seq = seq;
+			adverts++;
+			check_range(&expect_vrms, "Vrms", vrms);
+			check_range(&expect_power, "true power", tp);
+		}
+		else if(type == FAST_DATA && len == UARTOVHD + 1 + FAST_DATA_LEN) {
+			// Record number, then true and apparent power
+			uint16_t record = be(p + OFFSET_ADLEN + 2, 2);
+			if(verbose) {
+				printf("  packet %3u: fast record %u tp %u ap %u\n", packets, record,
+						be(p + OFFSET_ADLEN + 4, 2), be(p + OFFSET_ADLEN + 6, 2));
+			}
+			if(fast > 0 && record != fast_next) {
+				fast_gaps++;
+			}
+			fast_next = record + 1;
+			fast++;
+		}
+		else if(verbose) {
+			printf("  packet %3u: %u bytes, type 0x%02x\n", packets, len, type < 0 ? 0 : type);
+		}
+		at += len;
+	}
+
+	printf("uart: %zu bytes, %u packets, %u with advertisement data\n", s->tx_len, packets, adverts);
+	if(fast > 0 || expect_fast > 0) {
+		printf("%-16s %8u records, %u gaps\n", "fast", fast, fast_gaps);
+	}
+	if(fast < expect_fast) {
+		printf("FAIL: %u fast records, expected at least %u\n", fast, expect_fast);
+		failed = 1;
+	}
+	if(expect_fast > 0 && fast_gaps > 0) {
+		printf("FAIL: %u gaps in the fast record numbers\n", fast_gaps);
+		failed = 1;
+	}
+	if(adverts < expect_packets) {
+		printf("FAIL: %u advertisement packets, expected at least %u\n", adverts, expect_packets);
+		failed = 1;
+	}
+	int i;
+	for(i = 0; i < expect_type_count; i++) {
+		if(!seen[expect_types[i]]) {
+			printf("FAIL: no packet of type 0x%02x\n", expect_types[i]);
+			failed = 1;
+		}
+	}
+}
+
+/**************************************************************************
+   MAIN
+ **************************************************************************/
+static void usage(void) {
+	fprintf(stderr,
+#if defined (HOST_FIRMWARE)
+		"usage: hostsim [options], budgets are accepted and ignored\n"
+#else
+		"usage: msp430sim [options] firmware.elf\n"
+#endif
+		"  --seconds S            simulated run time (default 5)\n"
+		"  --replay FILE          ADC samples to replay\n"
+		"  --rx FILE              messages from the nRF\n"
+		"  --ref-mhz F            clock budgets are given at (default 4)\n"
+		"  --isr-budget NAME=C    longest run of ISR NAME, in reference cycles\n"
+		"  --fn-budget NAME=C     longest call of function NAME, ISRs excluded\n"
+		"  --sample-budget C      average active cycles per sample (default one sample period)\n"
+		"  --stack-budget B       deepest stack use in bytes\n"
+		"  --expect-zero SYM      variable must be zero at the end\n"
+		"  --expect-packets N     at least N advertisement packets\n"
+		"  --expect-vrms LO:HI    every advertised Vrms in range\n"
+		"  --expect-power LO:HI   every advertised true power in range\n"
+		"  --expect-type T        a packet of data type T (hex) was sent\n"
+		"  --expect-fast N        at least N fast records, numbered without gaps\n"
+		"  --nrf-ready MS         nRF sends UART_READY MS after it is powered (default never)\n"
+		"  --expect-tx-within MS  first byte to the nRF at most MS after it is powered\n"
+		"  --expect-rate NAME=R   ISR NAME runs at most R times per second\n"
+		"  --verbose              list every packet\n"
+		"  --trace                trace every instruction to stderr\n");
+	exit(2);
+}
+
+static void parse_range(range_t* r, const char* arg) {
+	if(sscanf(arg, "%lf:%lf", &r->lo, &r->hi) != 2) {
+		usage();
+	}
+	r->set = 1;
+}
+
+int main(int argc, char** argv) {
+	static sim_t sim;
+	sim_t* s = &sim;
+
+	double seconds = 5;
+	double ref_hz = 4e6;
+	double sample_rate = 32768.0 / ADC_TICK / VI_DIV;
+	double sample_budget = 0;
+	long stack_budget = 0;
+	const char* elf = NULL;
+	const char* isr_budget_args[MAX_CHECKS];
+	int isr_budget_count = 0;
+	const char* zero_syms[MAX_CHECKS];
+	int zero_count = 0;
+	double tx_within = 0;
+	const char* rate_args[MAX_CHECKS];
+	int rate_count = 0;
+
+	s->nrf_ready_delay = -1;
+
+	int i;
+	for(i = 1; i < argc; i++) {
+		const char* a = argv[i];
+		const char* v = (i + 1 < argc) ? argv[i + 1] : NULL;
+		if(strcmp(a, "--verbose") == 0) {
+			verbose = 1;
+			continue;
+		}
+		if(strcmp(a, "--trace") == 0) {
+			s->trace = 1;
+			continue;
+		}
+		if(a[0] != '-') {
+			elf = a;
+			continue;
+		}
+		if(!v) {
+			usage();
+		}
+		i++;
+		if(strcmp(a, "--seconds") == 0) {
+			seconds = atof(v);
+		}
+		else if(strcmp(a, "--replay") == 0) {
+			load_replay(s, v);
+		}
+		else if(strcmp(a, "--rx") == 0) {
+			load_rx(s, v);
+		}
+		else if(strcmp(a, "--ref-mhz") == 0) {
+			ref_hz = atof(v) * 1e6;
+		}
+		else if(strcmp(a, "--isr-budget") == 0 && isr_budget_count < MAX_CHECKS) {
+			isr_budget_args[isr_budget_count++] = v;
+		}
+		else if(strcmp(a, "--fn-budget") == 0 && fn_count < MAX_CHECKS) {
+			const char* eq = strchr(v, '=');
+			if(!eq) {
+				usage();
+			}
+			fn_stats[fn_count].name = strndup(v, eq - v);
+			fn_stats[fn_count].budget = atof(eq + 1);
+			fn_count++;
+		}
+		else if(strcmp(a, "--sample-budget") == 0) {
+			sample_budget = atof(v);
+		}
+		else if(strcmp(a, "--stack-budget") == 0) {
+			stack_budget = atol(v);
+		}
+		else if(strcmp(a, "--expect-zero") == 0 && zero_count < MAX_CHECKS) {
+			zero_syms[zero_count++] = v;
+		}
+		else if(strcmp(a, "--expect-packets") == 0) {
+			expect_packets = atoi(v);
+		}
+		else if(strcmp(a, "--expect-fast") == 0) {
+			expect_fast = atoi(v);
+		}
+		else if(strcmp(a, "--expect-vrms") == 0) {
+			parse_range(&expect_vrms, v);
+		}
+		else if(strcmp(a, "--expect-power") == 0) {
+			parse_range(&expect_power, v);
+		}
+		else if(strcmp(a, "--expect-type") == 0 && expect_type_count < MAX_CHECKS) {
+			expect_types[expect_type_count++] = strtol(v, NULL, 16) & 0xFF;
+		}
+		else if(strcmp(a, "--nrf-ready") == 0) {
+			s->nrf_ready_delay = atof(v) / 1e3;
+		}
+		else if(strcmp(a, "--expect-tx-within") == 0) {
+			tx_within = atof(v) / 1e3;
+		}
+		else if(strcmp(a, "--expect-rate") == 0 && rate_count < MAX_CHECKS) {
+			rate_args[rate_count++] = v;
+		}
+		else {
+			usage();
+		}
+	}
+#if defined (HOST_FIRMWARE)
+	periph_reset(s);
+	if(fw_run(s, seconds) != 0) {
+		s->halted = 1;
+	}
+
+	// Interrupt report, no cycle counts on the host
+	printf("%.3fs simulated on the host, %llu LPM exits (%.1f per second), %llu clock changes (%.1f per second)\n",
+			s->time, (unsigned long long) fw_lpm_exits, fw_lpm_exits / s->time,
+			(unsigned long long) s->mclk_switches, s->mclk_switches / s->time);
+	for(i = 0; i < IRQ_COUNT; i++) {
+		if(fw_isr_runs[i] > 0) {
+			printf("%-16s %8llu runs, %8.1f per second\n", irq_name((irq_t) i),
+					(unsigned long long) fw_isr_runs[i], fw_isr_runs[i] / s->time);
+		}
+	}
+#else
+	if(!elf) {
+		usage();
+	}
+	if(sample_budget == 0) {
+		sample_budget = ref_hz / sample_rate;		// 1587 cycles at 4MHz
+	}
+
+	uint16_t entry = load_elf(s, elf);
+	periph_reset(s);
+	cpu_reset(s, entry);
+
+	for(i = 0; i < IRQ_COUNT; i++) {
+		symbol_t* sym = find_symbol(irq_name((irq_t) i));
+		s->isr_addr[i] = sym ? sym->value : 0;
+		isr_stats[i].name = irq_name((irq_t) i);
+	}
+	for(i = 0; i < isr_budget_count; i++) {
+		const char* eq = strchr(isr_budget_args[i], '=');
+		stat_t* st = eq ? isr_by_name(isr_budget_args[i], eq - isr_budget_args[i]) : NULL;
+		if(!st) {
+			fprintf(stderr, "msp430sim: unknown ISR in --isr-budget %s\n", isr_budget_args[i]);
+			return 2;
+		}
+		st->budget = atof(eq + 1);
+	}
+	for(i = 0; i < fn_count; i++) {
+		symbol_t* sym = find_symbol(fn_stats[i].name);
+		if(!sym) {
+			fprintf(stderr, "msp430sim: no function %s in the image (inlined?)\n", fn_stats[i].name);
+			return 2;
+		}
+		fn_stats[i].addr = sym->value;
+	}
+
+	run(s, seconds);
+
+	// Timing report
+	printf("%.3fs simulated, %llu cycles active (%.1f%%), MCLK %.2fMHz, %llu clock changes\n",
+			s->time, (unsigned long long) s->active_cycles, 100.0 * s->active_time / s->time,
+			s->mclk_hz / 1e6, (unsigned long long) s->mclk_switches);
+	for(i = 0; i < s->freq_count; i++) {
+		printf("%-16s %8.2fMHz %10.6fs active\n", i ? "" : "MCLK", s->freq_hz[i] / 1e6, s->freq_active[i]);
+	}
+	for(i = 0; i < IRQ_COUNT + fn_count; i++) {
+		stat_t* st = (i < IRQ_COUNT) ? &isr_stats[i] : &fn_stats[i - IRQ_COUNT];
+		if(st->count == 0 && st->budget == 0) {
+			continue;
+		}
+		double ref_max = st->max_time * ref_hz;
+		printf("%-16s %8llu runs, %6.1f avg, %6llu max cycles (%6.0f at %.0fMHz)",
+				st->name, (unsigned long long) st->count, st->count ? (double) st->total / st->count : 0.0,
+				(unsigned long long) st->max, ref_max, ref_hz / 1e6);
+		if(st->budget > 0) {
+			printf(", budget %.0f", st->budget);
+		}
+		printf("\n");
+		if(st->budget > 0 && ref_max > st->budget) {
+			fail("%s took %.0f cycles, budget %.0f", st->name, ref_max, st->budget);
+		}
+	}
+
+	double samples = s->time * sample_rate;
+	double per_sample = samples > 0 ? s->active_time * ref_hz / samples : 0;
+	printf("%-16s %8.0f samples, %6.1f active cycles each at %.0fMHz, budget %.0f\n",
+			"per sample", samples, per_sample, ref_hz / 1e6, sample_budget);
+	if(per_sample > sample_budget) {
+		fail("%s averaged %.1f cycles, budget %.0f", "sample", per_sample, sample_budget);
+	}
+
+	symbol_t* stack = find_symbol("__stack");
+	if(stack) {
+		long used = (long) stack->value - sp_min;
+		printf("%-16s %8ld bytes deepest\n", "stack", used);
+		if(stack_budget > 0 && used > stack_budget) {
+			fail("%s used %.0f bytes, budget %.0f", "stack", used, stack_budget);
+		}
+	}
+#endif
+
+	// ADC conversions by input, VCC_SENSE runs slower than V and I
+	printf("%-16s", "conversions");
+	for(i = 0; i < REPLAY_INCH; i++) {
+		if(s->adc_conversions[i] > 0) {
+			printf(" A%d %.1f", i, s->adc_conversions[i] / s->time);
+		}
+	}
+	printf(" per second\n");
+
+	for(i = 0; i < rate_count; i++) {
+		const char* eq = strchr(rate_args[i], '=');
+		int irq;
+		for(irq = 0; eq && irq < IRQ_COUNT; irq++) {
+			const char* name = irq_name((irq_t) irq);
+			if(strlen(name) == (size_t)(eq - rate_args[i]) && strncmp(name, rate_args[i], eq - rate_args[i]) == 0) {
+				break;
+			}
+		}
+		if(!eq || irq == IRQ_COUNT) {
+			fprintf(stderr, "msp430sim: unknown ISR in --expect-rate %s\n", rate_args[i]);
+			return 2;
+		}
+		double rate = isr_runs((irq_t) irq) / s->time;
+		if(rate > atof(eq + 1)) {
+			fail("%s ran %.1f times per second, expected at most %.1f", irq_name((irq_t) irq), rate, atof(eq + 1));
+		}
+	}
+
+	for(i = 0; i < zero_count; i++) {
+		uint32_t v = 0;
+		if(!symbol_value(s, zero_syms[i], &v)) {
+			fprintf(stderr, "msp430sim: no variable %s in the image\n", zero_syms[i]);
+			return 2;
+		}
+		printf("%-16s %8u\n", zero_syms[i], v);
+		if(v != 0) {
+			fail("%s is %.0f, expected %.0f", zero_syms[i], v, 0);
+		}
+	}
+
+	printf("%-16s %8u boots, first byte at most %.2fms after power on\n", "nrf",
+			s->nrf_boots, s->nrf_tx_delay_max * 1e3);
+	if(tx_within > 0) {
+		if(s->nrf_boots == 0) {
+			fail("%s booted %.0f times", "nrf", 0, 0);
+		}
+		else if(s->nrf_tx_delay_max > tx_within) {
+			fail("%s waited %.2fms, expected at most %.2fms", "nrf", s->nrf_tx_delay_max * 1e3, tx_within * 1e3);
+		}
+	}
+
+	check_packets(s);
+
+	if(s->halted) {
+		printf("FAIL: simulation stopped at %.6fs, pc %04x\n", s->time, s->reg[PC]);
+		failed = 1;
+	}
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+	return failed ? 1 : 0;
+}
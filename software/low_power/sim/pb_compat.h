@@ -0,0 +1,30 @@
+/*
+ * Force-included when building the firmware with msp430-elf-gcc for the
+ * simulator. Maps the CCS intrinsics main.c and, with UPLINK_GEN2, the tag
+ * use onto their GCC spellings. ISRs are left out of the vector table,
+ * msp430sim finds them by name.
+ */
+
+#ifndef PB_COMPAT_H_
+#define PB_COMPAT_H_
+
+#include <msp430.h>
+
+#ifndef __interrupt
+#define __interrupt		__attribute__((interrupt))
+#endif
+
+#ifndef __even_in_range
+#define __even_in_range(x, y)	(x)
+#endif
+
+#ifndef _nop
+#define _nop()			__asm__ __volatile__ ("nop")
+#endif
+
+// The image is built for the plain MSP430 CPU, so the DMA addresses are
+// written 16 bits wide rather than with MOVX.A
+#undef __data16_write_addr
+#define __data16_write_addr(addr, val)	(*(volatile unsigned int*)(unsigned int)(addr) = (unsigned int)(val))
+
+#endif // PB_COMPAT_H_
@@ -12,6 +12,7 @@
 #include "ble.h"
 #include "ble_advdata.h"
 #include "app_timer.h"
+#include "app_scheduler.h"
 #include "app_util_platform.h"
 #include "nrf_uart.h"
 #include "nrf_drv_common.h"
@@ -31,22 +32,34 @@
 /**************************************************
  * Function Protoypes
  **************************************************/
-void start_eddystone_adv(void);
 void init_adv_data(void);
-void start_manufdata_adv(void);
+void adv_slot(void);
+void adv_burst_end(void);
+void adv_new_data(uint8_t* data, uint8_t len);
+bool adv_outside_deadband(uint16_t value, uint16_t fresh, uint16_t deadband);
+uint16_t adv_power_deadband(uint16_t fresh);
+void adv_pause(void);
+void adv_history_push(void);
+void adv_history_encode(void);
 
 void UART0_IRQHandler(void);
 void uart_rx_handler(void);
+void uart_rx_process(void* p_event_data, uint16_t event_size);
 void process_rx_packet(uint16_t packet_len);
 void process_additional_data(uint8_t* buf, uint16_t len);
 void uart_tx_handler(void);
 void uart_send(uint8_t* data, uint16_t len);
+void uart_send_ready(void);
 void uart_start_receive(void);
 
 void services_init(void);
 void ble_evt_write (ble_evt_t* p_ble_evt);
 
 void transmit_message(void);
+bool command_pending(uint8_t type);
+uint16_t command_frame(uint8_t type, uint8_t* frame, uint16_t room);
+void command_sent(uint8_t type);
+uint16_t reply_len(uint8_t* buf, uint16_t len);
 void on_receive_message(uint8_t* buf, uint16_t len);
 
 void timers_init(void);
@@ -61,12 +74,35 @@ int main(void);
 const int SLAVE_LATENCY = 4;
 const int FIRST_CONN_PARAMS_UPDATE_DELAY = APP_TIMER_TICKS(100, APP_TIMER_PRESCALER);
 
+// advertising policy. Data that changed goes out at once and then every
+//  ADV_INTERVAL_FRESH_MS. Each packet from the MSP that only moves the
+//  sequence number and watt-hours on, or moves power and voltage less than
+//  their deadbands, doubles the interval, up to ADV_INTERVAL_IDLE_MS.
+//  Eddystone gets one slot in ADV_EDDYSTONE_SLOTS. ADV_FLEET_SIZE is the
+//  number of PowerBlades a gateway hears. Idle devices keep the fleet to
+//  about 20 packets per second, under 1% of the air at 376us each (see
+//  software/adv_model/ble_model.py)
+#ifndef ADV_FLEET_SIZE
+#define ADV_FLEET_SIZE 1
+#endif
+#ifndef ADV_EDDYSTONE_SLOTS
+#define ADV_EDDYSTONE_SLOTS 10
+#endif
+#define ADV_INTERVAL_FRESH_MS 200
+// power and voltage move by a few counts every second under a steady load.
+//  Changes from the last fresh packet within these don't count as new data
+#define ADV_DEADBAND_VRMS 2         // V_RMS counts
+#define ADV_DEADBAND_POWER_SHIFT 4  // real and apparent power, 1/16 of the last fresh value
+#define ADV_DEADBAND_POWER_MIN 8    // and never under this many counts
+#define ADV_INTERVAL_IDLE_MS ((ADV_FLEET_SIZE <= 20) ? 1000 : \
+                              (ADV_FLEET_SIZE >= 200) ? 10000 : 50*ADV_FLEET_SIZE)
+
 // simple_ble configuration for advertising and connections
 static const simple_ble_config_t ble_config = {
     .platform_id       = PLATFORM_ID_BYTE,  // used as 4th octet in device BLE address
     .device_id         = DEVICE_ID_DEFAULT, // 5th and 6th octet in device BLE address
     .adv_name          = DEVICE_NAME,       // used in advertisements if there is room
-    .adv_interval      = MSEC_TO_UNITS(200, UNIT_0_625_MS),
+    .adv_interval      = MSEC_TO_UNITS(ADV_INTERVAL_FRESH_MS, UNIT_0_625_MS),
     .min_conn_interval = MSEC_TO_UNITS(20, UNIT_1_25_MS),
     .max_conn_interval = MSEC_TO_UNITS(50, UNIT_1_25_MS),
 };
@@ -74,11 +110,12 @@ static simple_ble_app_t* simple_ble_app;
 
 // timer configuration
 APP_TIMER_DEF(enable_uart_timer);
-APP_TIMER_DEF(start_eddystone_timer);
-APP_TIMER_DEF(start_manufdata_timer);
+APP_TIMER_DEF(adv_slot_timer);
+APP_TIMER_DEF(adv_burst_timer);
 APP_TIMER_DEF(restart_advs_timer);
-#define EDDYSTONE_ADV_DURATION      APP_TIMER_TICKS(200, APP_TIMER_PRESCALER)
-#define MANUFDATA_ADV_DURATION      APP_TIMER_TICKS(800, APP_TIMER_PRESCALER)
+// past ADV_INTERVAL_FRESH_MS each slot advertises this long, one event at the
+//  SoftDevice's interval
+#define ADV_BURST_DURATION          APP_TIMER_TICKS(20, APP_TIMER_PRESCALER)
 // end of uart message to start of next with guard time
 #define UART_SLEEP_DURATION         APP_TIMER_TICKS(925, APP_TIMER_PRESCALER)
 // start of uart guard time to start of next guard time, determined empirically
@@ -94,6 +131,46 @@ APP_TIMER_DEF(restart_advs_timer);
 #define ADV_DATA_MAX_LEN 24 // maximum manufacturer specific advertisement data size
 static uint8_t powerblade_adv_data[ADV_DATA_MAX_LEN];
 static uint8_t powerblade_adv_data_len = 0;
+// bytes of powerblade_adv_data that move on every second regardless
+#define ADV_SEQ_OFFSET 2
+#define ADV_WH_OFFSET 15
+// fields kept in the history, all big-endian
+#define ADV_VRMS_OFFSET 10
+#define ADV_TP_OFFSET 11
+#define ADV_AP_OFFSET 13
+
+// recent seconds, sent in the scan response so a gateway that misses
+//  advertisements can fill in the gaps. It is manufacturer specific data
+//  like the data packet, under its own service ID (PowerBlade's with the top
+//  bit set): the low byte of the current sequence number, then one entry
+//  per earlier second, newest first, of V_RMS, true power, and apparent
+//  power as they were sent, big-endian. Energy is cumulative, so the next
+//  record heard covers it
+#define POWERBLADE_HISTORY_SERVICE_IDENTIFIER 0x91
+#define ADV_HISTORY_LEN 6 // records kept, including the current one
+#define ADV_HISTORY_ENTRY_LEN 5
+#define ADV_HISTORY_MAX_LEN (2 + (ADV_HISTORY_LEN-1)*ADV_HISTORY_ENTRY_LEN)
+typedef struct {
+    uint32_t sequence;
+    uint16_t true_power;
+    uint16_t apparent_power;
+    uint8_t v_rms;
+} AdvRecord_t;
+static AdvRecord_t adv_records[ADV_HISTORY_LEN];
+static uint8_t adv_records_newest = 0;
+static uint8_t adv_records_count = 0;
+static uint8_t adv_history[ADV_HISTORY_MAX_LEN];
+static uint8_t adv_history_len = 0;
+
+// advertising scheduler state
+static uint16_t adv_interval_ms = ADV_INTERVAL_FRESH_MS;
+static uint8_t adv_slot_count = 0;
+static bool adv_fresh = false;
+static bool adv_paused = true;
+// values in the last packet that counted as changed, for the deadbands
+static uint8_t adv_fresh_v_rms = 0;
+static uint16_t adv_fresh_true_power = 0;
+static uint16_t adv_fresh_apparent_power = 0;
 
 // service for device configuration
 static simple_ble_service_t config_service = {
@@ -124,6 +201,10 @@ static simple_ble_service_t config_service = {
     // characteristic to access watt-hours scaling value
     static simple_ble_char_t config_whscale_char = {.uuid16 = 0x4DA8};
 
+    // characteristic to access MSP runtime statistics
+    static simple_ble_char_t config_stats_char = {.uuid16 = 0x4DA9};
+    static uint8_t msp_stats[STATS_LEN];
+
 // service for internal calibration
 static simple_ble_service_t calibration_service = {
     .uuid128 = {{0x49, 0x4b, 0x30, 0x70, 0xaa, 0xd5, 0x4e, 0x84,
@@ -158,23 +239,92 @@ static simple_ble_service_t rawSample_service = {
     static simple_ble_char_t rawSample_char_status = {.uuid16 = 0x01B2};
     static uint8_t rawSample_status;
 
+    // characteristic to arm a triggered capture: mode, threshold (big-endian)
+    static simple_ble_char_t rawSample_char_trigger = {.uuid16 = 0x01B3};
+    static uint8_t rawSample_trigger[START_TRIGGER_LEN];
+
+    // characteristic to indicate where the trigger is in the downloaded samples
+    static simple_ble_char_t rawSample_char_trigger_position = {.uuid16 = 0x01B4};
+    static uint16_t rawSample_trigger_position;
+
+// service for events detected on the MSP430
+static simple_ble_service_t event_service = {
+    .uuid128 = {{0xf5, 0x8d, 0x92, 0x64, 0x25, 0x21, 0x82, 0xaa,
+                 0x81, 0xbe, 0xce, 0x5d, 0xe7, 0xe0, 0xfb, 0x24}}};
+
+    // characteristic to provide the most recent appliance turn-on signature
+    static simple_ble_char_t event_signature_char = {.uuid16 = 0xE7E1};
+    static uint8_t event_signature[EVENT_SIG_LEN];
+
+    // characteristic to provide the most recent power quality event
+    static simple_ble_char_t event_pq_char = {.uuid16 = 0xE7E2};
+    static uint8_t event_pq[EVENT_PQ_LEN];
+
+    // characteristic to control fast reporting: cycles per record, seconds
+    static simple_ble_char_t event_fast_control_char = {.uuid16 = 0xE7E3};
+    static uint8_t event_fast_control[START_FAST_LEN];
+
+    // characteristic to provide fast power records
+    static simple_ble_char_t event_fast_data_char = {.uuid16 = 0xE7E4};
+    static uint8_t event_fast_data[FAST_DATA_LEN];
+
 // uart buffers
 // max length is: total length + adv length + adv data + add type + add data + checksum
 #define RX_DATA_MAX_LEN 2+1+ADV_DATA_MAX_LEN+1+SAMDATA_MAX_LEN+1
 static uint8_t rx_data[RX_DATA_MAX_LEN];
 static uint8_t* tx_data;
 static uint16_t tx_data_len = 0;
-static uint8_t tx_buffer[4+sizeof(powerblade_config)];
+// bytes the tx handler is shifting out, tx_data unless it is the ready byte
+static uint8_t* tx_out;
+static uint16_t tx_out_len = 0;
+static uint8_t tx_buffer[UART_BATCH_LEN];
 // when receiving long packets, briefly pause advertisements. I've decided that
 //  100 bytes is "long" essentially arbitarily
 #define LONG_PACKET_THRESHOLD 100
+// set while a uart_rx_process event is queued
+static volatile bool rx_scheduled = false;
+
+// scheduler queue, uart_rx_process is the only event and carries no data
+#define SCHED_MAX_EVENT_DATA_SIZE 0
+#define SCHED_QUEUE_SIZE 4
 
 // states for handling transmissions to the MSP
 static bool already_transmitted = false;
+
+// commands to the MSP, in the order they go out in a window. Configuration
+//  writes go first so they don't wait behind sampling or calibration. mode
+//  commands step the MSP through calibration, raw samples, or fast reporting
+//  and go one per window
+typedef struct {
+    uint8_t type;
+    bool mode;
+} MspCommand_t;
+static const MspCommand_t msp_commands[] = {
+    {SET_CONF,      false},
+    {START_LOCALC,  true},
+    {CONT_LOCALC,   true},
+    {DONE_LOCALC,   true},
+    {START_SAMDATA, true},
+    {START_TRIGGER, true},
+    {CONT_SAMDATA,  true},
+    {DONE_SAMDATA,  true},
+    {START_FAST,    true},
+    {DONE_FAST,     true},
+    {GET_STATS,     false},
+    {GET_CONF,      false},
+    {GET_VER,       false},
+};
+
+// MSP takes several commands per window, from its software version in the
+//  advertisement flags
+#define ADV_FLAGS_OFFSET 18 // flags byte in the MSP's advertisement data
+static bool msp_batch = false;
 static NakState_t nak_state = NAK_NONE;
 static CalibrationState_t calibration_state = CALIB_NONE;
 static RawSampleState_t rawSample_state = RS_NONE;
 static ConfigurationState_t config_state = CONF_NONE;
+static StatsState_t stats_state = STATS_NONE;
+static FastState_t fast_state = FAST_NONE;
 static StartupState_t startup_state = STARTUP_NOP;
 static StatusCode_t status_code = STATUS_NONE;
 static bool skip_uart_cycle = false;
@@ -184,16 +334,6 @@ static bool skip_uart_cycle = false;
  * Advertisements
  **************************************************/
 
-void start_eddystone_adv (void) {
-    uint32_t err_code;
-
-    // Advertise physical web address for PowerBlade summon app
-    eddystone_adv(PHYSWEB_URL, NULL);
-
-    err_code = app_timer_start(start_manufdata_timer, EDDYSTONE_ADV_DURATION, NULL);
-    APP_ERROR_CHECK(err_code);
-}
-
 void init_adv_data (void) {
     // Default values, helpful for debugging
     powerblade_adv_data[0] = POWERBLADE_SERVICE_IDENTIFIER; // Service ID
@@ -229,24 +369,192 @@ void init_adv_data (void) {
     powerblade_adv_data_len = 20;
 }
 
-void start_manufdata_adv (void) {
+void adv_slot (void) {
     uint32_t err_code;
 
-    // Advertise PowerBlade data payload as manufacturer specific data
-    ble_advdata_manuf_data_t manuf_specific_data;
-    manuf_specific_data.company_identifier = UMICH_COMPANY_IDENTIFIER;
-    manuf_specific_data.data.p_data = powerblade_adv_data;
-    manuf_specific_data.data.size   = powerblade_adv_data_len;
-    simple_adv_manuf_data(&manuf_specific_data);
+    // fresh data always goes out, otherwise Eddystone takes one slot in
+    //  ADV_EDDYSTONE_SLOTS
+    adv_slot_count++;
+    if (!adv_fresh && adv_slot_count >= ADV_EDDYSTONE_SLOTS) {
+        adv_slot_count = 0;
+
+        // Advertise physical web address for PowerBlade summon app
+        eddystone_adv(PHYSWEB_URL, NULL);
+    } else {
+        // Advertise PowerBlade data payload as manufacturer specific data
+        ble_advdata_manuf_data_t manuf_specific_data;
+        manuf_specific_data.company_identifier = UMICH_COMPANY_IDENTIFIER;
+        manuf_specific_data.data.p_data = powerblade_adv_data;
+        manuf_specific_data.data.size   = powerblade_adv_data_len;
+
+        ble_advdata_t advdata;
+        memset(&advdata, 0, sizeof(advdata));
+        advdata.flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+        advdata.p_manuf_specific_data = &manuf_specific_data;
+
+        // and recent seconds in the scan response, in place of the name
+        ble_advdata_manuf_data_t history_data;
+        history_data.company_identifier = UMICH_COMPANY_IDENTIFIER;
+        history_data.data.p_data = adv_history;
+        history_data.data.size   = adv_history_len;
+
+        ble_advdata_t srdata;
+        memset(&srdata, 0, sizeof(srdata));
+        if (adv_history_len > 2) {
+            srdata.p_manuf_specific_data = &history_data;
+        }
+
+        advertising_stop();
+        err_code = ble_advdata_set(&advdata, &srdata);
+        APP_ERROR_CHECK(err_code);
+        advertising_start();
+    }
+    adv_fresh = false;
+    adv_paused = false;
+
+    // at longer intervals, stop after one advertising event rather than
+    //  letting the SoftDevice repeat it
+    if (adv_interval_ms > ADV_INTERVAL_FRESH_MS) {
+        err_code = app_timer_start(adv_burst_timer, ADV_BURST_DURATION, NULL);
+        APP_ERROR_CHECK(err_code);
+    }
 
-    err_code = app_timer_start(start_eddystone_timer, MANUFDATA_ADV_DURATION, NULL);
+    err_code = app_timer_start(adv_slot_timer, APP_TIMER_TICKS(adv_interval_ms, APP_TIMER_PRESCALER), NULL);
     APP_ERROR_CHECK(err_code);
 }
 
+void adv_burst_end (void) {
+    advertising_stop();
+}
+
+void adv_new_data (uint8_t* data, uint8_t len) {
+    // changed unless only the sequence number and watt-hours moved on, and
+    //  power and voltage stayed within their deadbands
+    bool changed = (1+len != powerblade_adv_data_len);
+    uint8_t i;
+    for (i = 1; i <= len && !changed; i++) {
+        if ((i >= ADV_SEQ_OFFSET && i < ADV_SEQ_OFFSET+4) ||
+                (i >= ADV_WH_OFFSET && i < ADV_WH_OFFSET+4) ||
+                (i >= ADV_VRMS_OFFSET && i < ADV_AP_OFFSET+2)) {
+            continue;
+        }
+        changed = (powerblade_adv_data[i] != data[i-1]);
+    }
+    if (!changed && 1+len >= ADV_AP_OFFSET+2) {
+        uint8_t v_rms = data[ADV_VRMS_OFFSET-1];
+        uint16_t true_power = (data[ADV_TP_OFFSET-1] << 8) | data[ADV_TP_OFFSET];
+        uint16_t apparent_power = (data[ADV_AP_OFFSET-1] << 8) | data[ADV_AP_OFFSET];
+        changed = adv_outside_deadband(v_rms, adv_fresh_v_rms, ADV_DEADBAND_VRMS) ||
+                  adv_outside_deadband(true_power, adv_fresh_true_power,
+                          adv_power_deadband(adv_fresh_true_power)) ||
+                  adv_outside_deadband(apparent_power, adv_fresh_apparent_power,
+                          adv_power_deadband(adv_fresh_apparent_power));
+    }
+
+    // first byte of adv_data is service_id, skip it
+    powerblade_adv_data_len = 1+len;
+    memcpy(&(powerblade_adv_data[1]), data, len);
+    adv_history_push();
+
+    if (changed) {
+        adv_interval_ms = ADV_INTERVAL_FRESH_MS;
+        adv_fresh = true;
+        if (powerblade_adv_data_len >= ADV_AP_OFFSET+2) {
+            adv_fresh_v_rms = powerblade_adv_data[ADV_VRMS_OFFSET];
+            adv_fresh_true_power = (powerblade_adv_data[ADV_TP_OFFSET] << 8) | powerblade_adv_data[ADV_TP_OFFSET+1];
+            adv_fresh_apparent_power = (powerblade_adv_data[ADV_AP_OFFSET] << 8) | powerblade_adv_data[ADV_AP_OFFSET+1];
+        }
+    } else if (adv_interval_ms < ADV_INTERVAL_IDLE_MS) {
+        adv_interval_ms *= 2;
+        if (adv_interval_ms > ADV_INTERVAL_IDLE_MS) {
+            adv_interval_ms = ADV_INTERVAL_IDLE_MS;
+        }
+    }
+
+    // fresh data goes out now rather than at the next slot. Unchanged data
+    //  waits, the slot timer has to be stopped first as starting a running
+    //  timer does nothing
+    if (changed || adv_paused) {
+        app_timer_stop(adv_slot_timer);
+        app_timer_stop(adv_burst_timer);
+        adv_slot();
+    }
+}
+
+bool adv_outside_deadband (uint16_t value, uint16_t fresh, uint16_t deadband) {
+    return (value > fresh) ? (value - fresh > deadband) : (fresh - value > deadband);
+}
+
+uint16_t adv_power_deadband (uint16_t fresh) {
+    uint16_t deadband = fresh >> ADV_DEADBAND_POWER_SHIFT;
+    return (deadband < ADV_DEADBAND_POWER_MIN) ? ADV_DEADBAND_POWER_MIN : deadband;
+}
+
+void adv_history_push (void) {
+    // records without power don't go in the history
+    if (powerblade_adv_data_len < ADV_AP_OFFSET+2) {
+        return;
+    }
+
+    uint8_t* data = powerblade_adv_data;
+    AdvRecord_t record;
+    record.sequence = ((uint32_t)data[ADV_SEQ_OFFSET] << 24) | ((uint32_t)data[ADV_SEQ_OFFSET+1] << 16) |
+                      ((uint32_t)data[ADV_SEQ_OFFSET+2] << 8) | data[ADV_SEQ_OFFSET+3];
+    record.true_power = (data[ADV_TP_OFFSET] << 8) | data[ADV_TP_OFFSET+1];
+    record.apparent_power = (data[ADV_AP_OFFSET] << 8) | data[ADV_AP_OFFSET+1];
+    record.v_rms = data[ADV_VRMS_OFFSET];
+
+    // a repeat of the newest record changes nothing, a gap starts over
+    if (adv_records_count > 0) {
+        uint32_t newest = adv_records[adv_records_newest].sequence;
+        if (record.sequence == newest) {
+            return;
+        }
+        if (record.sequence != newest+1) {
+            adv_records_count = 0;
+        }
+    }
+
+    adv_records_newest = (adv_records_newest + 1) % ADV_HISTORY_LEN;
+    adv_records[adv_records_newest] = record;
+    if (adv_records_count < ADV_HISTORY_LEN) {
+        adv_records_count++;
+    }
+
+    adv_history_encode();
+}
+
+void adv_history_encode (void) {
+    adv_history[0] = POWERBLADE_HISTORY_SERVICE_IDENTIFIER;
+    adv_history[1] = (adv_records[adv_records_newest].sequence & 0xFF);
+    adv_history_len = 2;
+
+    // every earlier second kept, newest first
+    uint8_t i;
+    for (i = 1; i < adv_records_count; i++) {
+        AdvRecord_t* older = &(adv_records[(adv_records_newest + ADV_HISTORY_LEN - i) % ADV_HISTORY_LEN]);
+        uint8_t* entry = &(adv_history[adv_history_len]);
+        entry[0] = older->v_rms;
+        entry[1] = older->true_power >> 8;
+        entry[2] = older->true_power & 0xFF;
+        entry[3] = older->apparent_power >> 8;
+        entry[4] = older->apparent_power & 0xFF;
+        adv_history_len += ADV_HISTORY_ENTRY_LEN;
+    }
+}
+
+void adv_pause (void) {
+    advertising_stop();
+    app_timer_stop(adv_slot_timer);
+    app_timer_stop(adv_burst_timer);
+    adv_paused = true;
+}
+
 void restart_advertisements (void) {
-    // if our timers were paused, restart them now. There probably isn't any
-    //  new data, so starting eddystone first seems like the right call here
-    start_eddystone_adv();
+    // if our timers were paused, restart them now
+    if (adv_paused) {
+        adv_slot();
+    }
 }
 
 
@@ -263,64 +571,92 @@ void UART0_IRQHandler (void) {
 }
 
 void uart_rx_handler (void) {
+    // only queue the byte here, framing and dispatch run from the scheduler
+    //  so this interrupt stays short next to the SoftDevice's
+    nrf_uart_event_clear(NRF_UART0, NRF_UART_EVENT_RXDRDY);
+    uart_rx_put(nrf_uart_rxd_get(NRF_UART0));
+
+    // one scheduler event drains everything queued before it runs
+    if (!rx_scheduled) {
+        rx_scheduled = true;
+        app_sched_event_put(NULL, 0, uart_rx_process);
+    }
+}
+
+void uart_rx_process (void* p_event_data, uint16_t event_size) {
     static uint16_t packet_len = 0;
     static uint16_t rx_index = 0;
+    uint8_t byte;
 
-    // if this is the first byte of data, restart the sleep timer
-    if (rx_index == 0) {
-        app_timer_start(enable_uart_timer, UART_SLEEP_DURATION, NULL);
-    }
+    // clear before draining, so a byte arriving after the last get
+    //  schedules another pass
+    rx_scheduled = false;
 
-    // move uart data to buffer
-    //NOTE: we aren't doing any kind of check here to ensure that we aren't
-    //  waiting forever for an eronously large packet. That's okay though,
-    //  since the current draw when UART is on is unsustainable, the nRF will
-    //  just reboot if this occurs and get back to a good state
-    nrf_uart_event_clear(NRF_UART0, NRF_UART_EVENT_RXDRDY);
-    rx_data[rx_index] = nrf_uart_rxd_get(NRF_UART0);
-    rx_index++;
-
-    // check if we have received the entire packet
-    //  This can't occur until we have length, adv length, and checksum
-    if (rx_index >= 4) {
-
-        // parse out expected packet length
-        if (packet_len == 0) {
-            packet_len = (rx_data[0] << 8 | rx_data[1]);
-
-            // if we are receiving a long packet, pause advertisements until it's done
-            if (packet_len > LONG_PACKET_THRESHOLD) {
-                advertising_stop();
-                app_timer_stop(start_eddystone_timer);
-                app_timer_stop(start_manufdata_timer);
-                // no need to set a timer to restart them, process_rx_packet
-                //  will do so. Unless the CRC is bad, in which case the next
-                //  uart transmission will
-            }
+    while (uart_rx_get(&byte)) {
+
+        // if this is the first byte of data, restart the sleep timer
+        if (rx_index == 0) {
+            app_timer_start(enable_uart_timer, UART_SLEEP_DURATION, NULL);
         }
 
-        // process packet if we have all of it
-        if (rx_index >= packet_len || rx_index >= RX_DATA_MAX_LEN) {
-            process_rx_packet(packet_len);
-            packet_len = 0;
-            rx_index = 0;
+        // move uart data to buffer
+        //NOTE: we aren't doing any kind of check here to ensure that we aren't
+        //  waiting forever for an eronously large packet. That's okay though,
+        //  since the current draw when UART is on is unsustainable, the nRF will
+        //  just reboot if this occurs and get back to a good state
+        rx_data[rx_index] = byte;
+        rx_index++;
+
+        // check if we have received the entire packet
+        //  This can't occur until we have length, adv length, and checksum
+        if (rx_index >= 4) {
+
+            // parse out expected packet length
+            if (packet_len == 0) {
+                packet_len = (rx_data[0] << 8 | rx_data[1]);
+
+                // if we are receiving a long packet, pause advertisements until it's done
+                if (packet_len > LONG_PACKET_THRESHOLD) {
+                    adv_pause();
+                    // no need to set a timer to restart them, process_rx_packet
+                    //  will do so. Unless the CRC is bad, in which case the next
+                    //  uart transmission will
+                }
+            }
+
+            // process packet if we have all of it
+            if (rx_index >= packet_len || rx_index >= RX_DATA_MAX_LEN) {
+                process_rx_packet(packet_len);
+                packet_len = 0;
+                rx_index = 0;
+            }
         }
     }
 }
 
 void process_rx_packet(uint16_t packet_len) {
 
-    // turn off UART until next window
-    uart_rx_disable();
-
-    // a new window for transmission to the MSP430 is available
-    already_transmitted = false;
+    // fast records arrive between the 1Hz packets, keep listening for them.
+    //  Otherwise turn off UART until next window
+    if (fast_state != FAST_RUNNING) {
+        uart_rx_disable();
+    }
 
     // check CRC
     if (additive_checksum(rx_data, packet_len-1) == rx_data[packet_len-1]) {
 
-        // check validity of advertisement length
+        // fast records have no advertisement data and don't open a window
+        //  for transmission to the MSP430
         uint8_t adv_len = rx_data[2];
+        if (adv_len == 0 && 4 <= packet_len) {
+            on_receive_message(&(rx_data[3]), packet_len - 4);
+            return;
+        }
+
+        // a new window for transmission to the MSP430 is available
+        already_transmitted = false;
+
+        // check validity of advertisement length
         if (4+adv_len <= packet_len) {
 
             // limit to valid advertisement length
@@ -328,23 +664,30 @@ void process_rx_packet(uint16_t packet_len) {
                 adv_len = ADV_DATA_MAX_LEN;
             }
 
-            // update advertisement
-            //  first byte of adv_data is service_id, skip it
-            //NOTE: this is safe to call no matter where in the
-            //  Eddystone/Manuf Data we are. If called during Manuf Data,
-            //  nothing changes (second call to timer_start does nothing).
-            //  If called during Eddystone, timing is screwed up, but it'll fix
-            //  itself within one cycle
-            powerblade_adv_data_len = 1+adv_len;
-            memcpy(&(powerblade_adv_data[1]), &(rx_data[3]), adv_len);
-            start_manufdata_adv();
+            // update advertisement, at once if the data changed
+            adv_new_data(&(rx_data[3]), adv_len);
+
+            // software version is the low four bits of the flags
+            if (adv_len > ADV_FLAGS_OFFSET) {
+                msp_batch = ((rx_data[3+ADV_FLAGS_OFFSET] & 0x0F) >= UART_BATCH_VERSION);
+            }
 
             // handle additional UART data, if any
+            //  Several replies may follow each other when the MSP takes
+            //  batches, each is handled on its own
             uint8_t* additional_data = &(rx_data[3+adv_len]);
             uint16_t additional_data_length = packet_len - (4 + adv_len);
-            on_receive_message(additional_data, additional_data_length);
+            do {
+                uint16_t item_len = reply_len(additional_data, additional_data_length);
+                on_receive_message(additional_data, item_len);
+                additional_data += item_len;
+                additional_data_length -= item_len;
+            } while (additional_data_length > 0);
         }
     } else {
+        // a new window for transmission to the MSP430 is available
+        already_transmitted = false;
+
         // need to send a nak
         nak_state = NAK_CHECKSUM;
         status_code = STATUS_BAD_CHECKSUM;
@@ -359,8 +702,8 @@ void uart_tx_handler (void) {
     nrf_uart_event_clear(NRF_UART0, NRF_UART_EVENT_TXDRDY);
 
     // check if there is more data to send
-    if (tx_index < tx_data_len) {
-        nrf_uart_txd_set(NRF_UART0, tx_data[tx_index]);
+    if (tx_index < tx_out_len) {
+        nrf_uart_txd_set(NRF_UART0, tx_out[tx_index]);
         tx_index++;
     } else {
         tx_index = 0;
@@ -372,6 +715,8 @@ void uart_send (uint8_t* data, uint16_t len) {
     // setup data
     tx_data = data;
     tx_data_len = len;
+    tx_out = data;
+    tx_out_len = len;
 
     // begin sending data
     uart_tx_enable();
@@ -381,6 +726,18 @@ void uart_send (uint8_t* data, uint16_t len) {
     already_transmitted = true;
 }
 
+void uart_send_ready (void) {
+    // tell the MSP430 we are booted so it doesn't wait out its boot delay
+    //  This is a single unframed byte, the MSP drops it outside of a message.
+    //  tx_data keeps the last frame for a NAK_RESEND
+    static uint8_t ready_byte = UART_READY;
+    tx_out = &ready_byte;
+    tx_out_len = 1;
+
+    uart_tx_enable();
+    uart_tx_handler();
+}
+
 void uart_start_receive (void) {
     if (!skip_uart_cycle) {
         // we are ready to receive, go for it
@@ -443,6 +800,11 @@ void services_init (void) {
                 sizeof(powerblade_config.whscale), (uint8_t*)&powerblade_config.whscale,
                 &config_service, &config_whscale_char);
 
+        // Add characteristic to access MSP statistics
+        memset(msp_stats, 0x00, STATS_LEN);
+        simple_ble_add_characteristic(1, 1, 1, 0, // read, write, notify, vlen
+                STATS_LEN, (uint8_t*)msp_stats,
+                &config_service, &config_stats_char);
 
     // Add internal calibration service
     simple_ble_add_service(&calibration_service);
@@ -491,6 +853,45 @@ void services_init (void) {
         simple_ble_add_characteristic(1, 1, 1, 0, // read, write, notify, vlen
                 1, (uint8_t*)&rawSample_status,
                 &rawSample_service, &rawSample_char_status);
+
+        // Add the characteristic to arm a triggered capture
+        memset(rawSample_trigger, 0x00, START_TRIGGER_LEN);
+        simple_ble_add_characteristic(1, 1, 0, 0, // read, write, notify, vlen
+                START_TRIGGER_LEN, (uint8_t*)rawSample_trigger,
+                &rawSample_service, &rawSample_char_trigger);
+
+        // Add the characteristic to provide the trigger position
+        rawSample_trigger_position = 0;
+        simple_ble_add_characteristic(1, 0, 1, 0, // read, write, notify, vlen
+                2, (uint8_t*)&rawSample_trigger_position,
+                &rawSample_service, &rawSample_char_trigger_position);
+
+    // Add event service
+    simple_ble_add_service(&event_service);
+
+        // Add the characteristic to provide turn-on signatures
+        memset(event_signature, 0x00, EVENT_SIG_LEN);
+        simple_ble_add_characteristic(1, 0, 1, 0, // read, write, notify, vlen
+                EVENT_SIG_LEN, (uint8_t*)event_signature,
+                &event_service, &event_signature_char);
+
+        // Add the characteristic to provide power quality events
+        memset(event_pq, 0x00, EVENT_PQ_LEN);
+        simple_ble_add_characteristic(1, 0, 1, 0, // read, write, notify, vlen
+                EVENT_PQ_LEN, (uint8_t*)event_pq,
+                &event_service, &event_pq_char);
+
+        // Add the characteristic to control fast reporting
+        memset(event_fast_control, 0x00, START_FAST_LEN);
+        simple_ble_add_characteristic(1, 1, 1, 0, // read, write, notify, vlen
+                START_FAST_LEN, (uint8_t*)event_fast_control,
+                &event_service, &event_fast_control_char);
+
+        // Add the characteristic to provide fast power records
+        memset(event_fast_data, 0x00, FAST_DATA_LEN);
+        simple_ble_add_characteristic(1, 0, 1, 0, // read, write, notify, vlen
+                FAST_DATA_LEN, (uint8_t*)event_fast_data,
+                &event_service, &event_fast_data_char);
 }
 
 void ble_evt_connected (ble_evt_t* p_ble_evt) {
@@ -498,9 +899,7 @@ void ble_evt_connected (ble_evt_t* p_ble_evt) {
     skip_uart_cycle = true;
 
     // stop any running advertisements and don't restart for a single UART cycle
-    advertising_stop();
-    app_timer_stop(start_eddystone_timer);
-    app_timer_stop(start_manufdata_timer);
+    adv_pause();
     app_timer_start(restart_advs_timer, CONNECTION_SKIP_DURATION, NULL);
 }
 
@@ -535,6 +934,16 @@ void ble_evt_write (ble_evt_t* p_ble_evt) {
             rawSample_status = 255;
         }
 
+    } else if (simple_ble_is_char_event(p_ble_evt, &rawSample_char_trigger)) {
+        // arm a triggered capture, or cancel one with a mode of zero
+        if (rawSample_state == RS_NONE && rawSample_trigger[0] != 0) {
+            rawSample_state = RS_TRIGGER;
+            rawSample_status = 0;
+        } else if (rawSample_state != RS_NONE && rawSample_trigger[0] == 0) {
+            rawSample_state = RS_QUIT;
+            rawSample_status = 255;
+        }
+
     } else if (simple_ble_is_char_event(p_ble_evt, &rawSample_char_status)) {
         // clear value on write
         rawSample_status = 0;
@@ -552,6 +961,18 @@ void ble_evt_write (ble_evt_t* p_ble_evt) {
                simple_ble_is_char_event(p_ble_evt, &config_whscale_char)) {
         // send updated value to MSP
         config_state = CONF_SET_VALUES;
+
+    } else if (simple_ble_is_char_event(p_ble_evt, &event_fast_control_char)) {
+        // start fast reporting, or stop it with zero seconds
+        if (event_fast_control[1] != 0) {
+            fast_state = FAST_START;
+        } else if (fast_state != FAST_NONE) {
+            fast_state = FAST_STOP;
+        }
+
+    } else if (simple_ble_is_char_event(p_ble_evt, &config_stats_char)) {
+        // any write requests fresh statistics from the MSP
+        stats_state = STATS_GET;
     }
 }
 
@@ -576,10 +997,10 @@ void timers_init (void) {
     err_code = app_timer_create(&enable_uart_timer, APP_TIMER_MODE_SINGLE_SHOT, (app_timer_timeout_handler_t)uart_start_receive);
     APP_ERROR_CHECK(err_code);
 
-    err_code = app_timer_create(&start_eddystone_timer, APP_TIMER_MODE_SINGLE_SHOT, (app_timer_timeout_handler_t)start_eddystone_adv);
+    err_code = app_timer_create(&adv_slot_timer, APP_TIMER_MODE_SINGLE_SHOT, (app_timer_timeout_handler_t)adv_slot);
     APP_ERROR_CHECK(err_code);
 
-    err_code = app_timer_create(&start_manufdata_timer, APP_TIMER_MODE_SINGLE_SHOT, (app_timer_timeout_handler_t)start_manufdata_adv);
+    err_code = app_timer_create(&adv_burst_timer, APP_TIMER_MODE_SINGLE_SHOT, (app_timer_timeout_handler_t)adv_burst_end);
     APP_ERROR_CHECK(err_code);
 
     err_code = app_timer_create(&restart_advs_timer, APP_TIMER_MODE_SINGLE_SHOT, (app_timer_timeout_handler_t)restart_advertisements);
@@ -596,18 +1017,23 @@ void ble_error(uint32_t error_code) {
 int main(void) {
     // Initialization
     simple_ble_app = simple_ble_init(&ble_config);
+    APP_SCHED_INIT(SCHED_MAX_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
     timers_init();
     conn_params_init();
     uart_init();
     init_adv_data();
 
     // Initialization complete
-    start_manufdata_adv();
+    adv_slot();
     uart_rx_enable();
+    uart_send_ready();
 
     while (1) {
         power_manage();
 
+        // received uart data, may open a transmission window
+        app_sched_execute();
+
         // state machine. Only send one message per second
         if (!already_transmitted) {
             transmit_message();
@@ -616,8 +1042,9 @@ int main(void) {
 }
 
 void transmit_message(void) {
-    // select message to transmit at this interval
-    //  message priority is based on ordering in this function
+    // select messages to transmit at this interval
+    //  acknowledgements go on their own, then pending commands in the order
+    //  of msp_commands
 
     if (startup_state == STARTUP_NOP) {
         // skip this first cycle
@@ -639,111 +1066,156 @@ void transmit_message(void) {
         uart_send(tx_data, tx_data_len);
         nak_state = NAK_NONE;
 
-    } else if (calibration_state == CALIB_START) {
-        // send start message to MSP
-        uint16_t length = 2+1+2+2+1; // length (x2), type, wattage (x2), voltage (x2), checksum
-        tx_buffer[0] = (length >> 8);
-        tx_buffer[1] = (length & 0xFF);
-        tx_buffer[2] = (START_LOCALC);
-        tx_buffer[3] = (calibration_wattage >> 8);
-        tx_buffer[4] = (calibration_wattage & 0xFF);
-        tx_buffer[5] = (calibration_voltage >> 8);
-        tx_buffer[6] = (calibration_voltage & 0xFF);
-        tx_buffer[7] = additive_checksum(tx_buffer, length-1);
-        uart_send(tx_buffer, length);
-        rawSample_state = CALIB_WAIT_START;
-
-    } else if (calibration_state == CALIB_CONTINUE) {
-        // check on the state of the MSP
-        uint16_t length = 2+1+1; // length (x2), type, checksum
-        tx_buffer[0] = (length >> 8);
-        tx_buffer[1] = (length & 0xFF);
-        tx_buffer[2] = (CONT_LOCALC);
-        tx_buffer[3] = additive_checksum(tx_buffer, length-1);
-        uart_send(tx_buffer, length);
-        rawSample_state = CALIB_WAIT_CONTINUE;
+    } else {
+        // one command per window, or as many as fit if the MSP takes batches.
+        //  Only one may step the MSP through a mode
+        uint16_t length = 0;
+        bool mode_sent = false;
+        uint8_t i;
+        for (i = 0; i < sizeof(msp_commands)/sizeof(msp_commands[0]); i++) {
+            uint8_t type = msp_commands[i].type;
+            bool mode = msp_commands[i].mode;
+            if (!command_pending(type) || (mode && mode_sent)) {
+                continue;
+            }
 
-    } else if (calibration_state == CALIB_GET_CONFIG) {
-        // request new configuration from MSP
-        uint16_t length = 2+1+1; // length (x2), type, checksum
-        tx_buffer[0] = (length >> 8);
-        tx_buffer[1] = (length & 0xFF);
-        tx_buffer[2] = (GET_CONF);
-        tx_buffer[3] = additive_checksum(tx_buffer, length-1);
-        uart_send(tx_buffer, length);
-        rawSample_state = CALIB_WAIT_GET_CONFIG;
+            uint16_t frame_len = command_frame(type, &(tx_buffer[length]), sizeof(tx_buffer) - length);
+            if (frame_len == 0) {
+                continue;
+            }
+            length += frame_len;
+            mode_sent |= mode;
+            command_sent(type);
 
-    } else if (calibration_state == CALIB_STOP) {
-        // send stop message to MSP
-        uint16_t length = 2+1+1; // length (x2), type, checksum
-        tx_buffer[0] = (length >> 8);
-        tx_buffer[1] = (length & 0xFF);
-        tx_buffer[2] = (DONE_LOCALC);
-        tx_buffer[3] = additive_checksum(tx_buffer, length-1);
-        uart_send(tx_buffer, length);
-        rawSample_state = CALIB_WAIT_STOP;
+            // the reply to CONT_SAMDATA fills the packet, nothing can follow it
+            if (!msp_batch || type == CONT_SAMDATA) {
+                break;
+            }
+        }
 
-    } else if (rawSample_state == RS_START) {
-        // send start message to MSP
-        uint16_t length = 2+1+1; // length (x2), type, checksum
-        tx_buffer[0] = (length >> 8);
-        tx_buffer[1] = (length & 0xFF);
-        tx_buffer[2] = (START_SAMDATA);
-        tx_buffer[3] = additive_checksum(tx_buffer, length-1);
-        uart_send(tx_buffer, length);
-        rawSample_state = RS_WAIT_START;
+        if (length > 0) {
+            uart_send(tx_buffer, length);
+        }
+    }
+}
 
-    } else if (rawSample_state == RS_NEXT) {
-        // send next data message to MSP
-        uint16_t length = 2+1+1; // length (x2), type, checksum
-        tx_buffer[0] = (length >> 8);
-        tx_buffer[1] = (length & 0xFF);
-        tx_buffer[2] = (CONT_SAMDATA);
-        tx_buffer[3] = additive_checksum(tx_buffer, length-1);
-        uart_send(tx_buffer, length);
-        rawSample_state = RS_WAIT_DATA;
+bool command_pending (uint8_t type) {
+    // a command is pending while its state machine says so, not queued
+    //  per request, so repeats coalesce
+    switch (type) {
+        case SET_CONF:      return (config_state == CONF_SET_VALUES);
+        case START_LOCALC:  return (calibration_state == CALIB_START);
+        case CONT_LOCALC:   return (calibration_state == CALIB_CONTINUE);
+        case DONE_LOCALC:   return (calibration_state == CALIB_STOP);
+        case START_SAMDATA: return (rawSample_state == RS_START);
+        case START_TRIGGER: return (rawSample_state == RS_TRIGGER);
+        case CONT_SAMDATA:  return (rawSample_state == RS_NEXT);
+        case DONE_SAMDATA:  return (rawSample_state == RS_QUIT);
+        case START_FAST:    return (fast_state == FAST_START);
+        case DONE_FAST:     return (fast_state == FAST_STOP);
+        case GET_STATS:     return (stats_state == STATS_GET);
+        case GET_CONF:      return (calibration_state == CALIB_GET_CONFIG ||
+                                    startup_state == STARTUP_GET_CONFIG);
+        case GET_VER:       return (startup_state == STARTUP_GET_VERSION);
+        default:            return false;
+    }
+}
 
-    } else if (rawSample_state == RS_QUIT) {
-        // send quit message to MSP
-        uint16_t length = 2+1+1; // length (x2), type, checksum
-        tx_buffer[0] = (length >> 8);
-        tx_buffer[1] = (length & 0xFF);
-        tx_buffer[2] = (DONE_SAMDATA);
-        tx_buffer[3] = additive_checksum(tx_buffer, length-1);
-        uart_send(tx_buffer, length);
-        rawSample_state = RS_WAIT_QUIT;
+uint16_t command_frame (uint8_t type, uint8_t* frame, uint16_t room) {
+    // payload, if any
+    uint8_t data[sizeof(powerblade_config)];
+    uint16_t data_len = 0;
+    switch (type) {
+        case START_LOCALC:
+            // wattage (x2), voltage (x2)
+            data[0] = (calibration_wattage >> 8);
+            data[1] = (calibration_wattage & 0xFF);
+            data[2] = (calibration_voltage >> 8);
+            data[3] = (calibration_voltage & 0xFF);
+            data_len = 4;
+            break;
+        case START_TRIGGER:
+            // mode, threshold (x2)
+            memcpy(data, rawSample_trigger, START_TRIGGER_LEN);
+            data_len = START_TRIGGER_LEN;
+            break;
+        case SET_CONF:
+            // configuration struct, as it is now
+            memcpy(data, (uint8_t*)(&powerblade_config), sizeof(powerblade_config));
+            data_len = sizeof(powerblade_config);
+            break;
+        case START_FAST:
+            // cycles per record, seconds
+            memcpy(data, event_fast_control, START_FAST_LEN);
+            data_len = START_FAST_LEN;
+            break;
+        default:
+            break;
+    }
 
-    } else if (config_state == CONF_SET_VALUES) {
-        // set configuration values
-        uint16_t length = 2+1+sizeof(powerblade_config)+1; // length(x2), type, configuration struct, checksum
-        tx_buffer[0] = (length >> 8);
-        tx_buffer[1] = (length & 0xFF);
-        tx_buffer[2] = (SET_CONF);
-        memcpy(&(tx_buffer[3]), (uint8_t*)(&powerblade_config), sizeof(powerblade_config));
-        tx_buffer[3+sizeof(powerblade_config)] = additive_checksum(tx_buffer, length-1);
-        uart_send(tx_buffer, length);
-        config_state = CONF_NONE;
+    uint16_t length = 2+1+data_len+1; // length (x2), type, data, checksum
+    if (length > room) {
+        return 0;
+    }
+    frame[0] = (length >> 8);
+    frame[1] = (length & 0xFF);
+    frame[2] = type;
+    memcpy(&(frame[3]), data, data_len);
+    frame[3+data_len] = additive_checksum(frame, length-1);
+    return length;
+}
 
-    } else if (startup_state == STARTUP_GET_CONFIG) {
-        // get MSP configuration to display to user
-        uint16_t length = 2+1+1; // length(x2), type, checksum
-        tx_buffer[0] = (length >> 8);
-        tx_buffer[1] = (length & 0xFF);
-        tx_buffer[2] = (GET_CONF);
-        tx_buffer[3] = additive_checksum(tx_buffer, length-1);
-        uart_send(tx_buffer, length);
-        startup_state = STARTUP_GET_VERSION;
+void command_sent (uint8_t type) {
+    // calibration commands repeat each window until the MSP's reply moves
+    //  calibration_state on
+    switch (type) {
+        case SET_CONF:      config_state = CONF_NONE; break;
+        case START_SAMDATA: rawSample_state = RS_WAIT_START; break;
+        case START_TRIGGER: rawSample_state = RS_WAIT_TRIGGER; break;
+        case CONT_SAMDATA:  rawSample_state = RS_WAIT_DATA; break;
+        case DONE_SAMDATA:  rawSample_state = RS_WAIT_QUIT; break;
+        case START_FAST:    fast_state = FAST_WAIT_START; break;
+        case DONE_FAST:     fast_state = FAST_WAIT_STOP; break;
+        case GET_STATS:     stats_state = STATS_NONE; break;
+        case GET_CONF:
+            if (startup_state == STARTUP_GET_CONFIG) {
+                startup_state = STARTUP_GET_VERSION;
+            }
+            break;
+        case GET_VER:       startup_state = STARTUP_NONE; break;
+        default:            break;
+    }
+}
 
-    } else if (startup_state == STARTUP_GET_VERSION) {
-        // get MSP software version to display to user
-        uint16_t length = 2+1+1; // length(x2), type, checksum
-        tx_buffer[0] = (length >> 8);
-        tx_buffer[1] = (length & 0xFF);
-        tx_buffer[2] = (GET_VER);
-        tx_buffer[3] = additive_checksum(tx_buffer, length-1);
-        uart_send(tx_buffer, length);
-        startup_state = STARTUP_NONE;
+uint16_t reply_len (uint8_t* buf, uint16_t len) {
+    // length of one reply item from the MSP, data type included. Sample
+    //  blocks and unknown types run to the end of the packet
+    uint16_t item_len = len;
+    if (len > 0) {
+        switch (buf[0]) {
+            case GET_CONF:      item_len = 1+sizeof(powerblade_config); break;
+            case GET_VER:       item_len = 1+1; break;
+            case GET_STATS:     item_len = 1+STATS_LEN; break;
+            case DONE_TRIGGER:  item_len = 1+DONE_TRIGGER_LEN; break;
+            case FAST_DATA:     item_len = 1+FAST_DATA_LEN; break;
+            case EVENT_SIG:     item_len = 1+EVENT_SIG_LEN; break;
+            case EVENT_PQ:      item_len = 1+EVENT_PQ_LEN; break;
+            case UART_NAK:
+            case START_LOCALC:
+            case CONT_LOCALC:
+            case DONE_LOCALC:
+            case START_SAMDATA:
+            case DONE_SAMDATA:
+            case START_TRIGGER:
+            case START_FAST:
+            case DONE_FAST:
+                item_len = 1;
+                break;
+            default:
+                break;
+        }
     }
+    return (item_len < len) ? item_len : len;
 }
 
 void on_receive_message(uint8_t* buf, uint16_t len) {
@@ -778,6 +1250,14 @@ void on_receive_message(uint8_t* buf, uint16_t len) {
                 //TODO: copy over version number into some characteristic
                 break;
 
+            case GET_STATS:
+                // updated statistics from the MSP
+                if ((len-1) == STATS_LEN) {
+                    memcpy(msp_stats, &(buf[1]), len-1);
+                    simple_ble_notify_char(&config_stats_char);
+                }
+                break;
+
             case START_LOCALC:
                 // write status to characteristic
                 calibration_control = 1;
@@ -812,6 +1292,53 @@ void on_receive_message(uint8_t* buf, uint16_t len) {
                 }
                 break;
 
+            case START_FAST:
+                // MSP is sending records, keep the UART on between packets
+                if (fast_state == FAST_WAIT_START) {
+                    fast_state = FAST_RUNNING;
+                    uart_rx_enable();
+                }
+                break;
+
+            case FAST_DATA:
+                // pass the record straight on to the client
+                if ((len-1) == FAST_DATA_LEN) {
+                    memcpy(event_fast_data, &(buf[1]), len-1);
+                    simple_ble_notify_char(&event_fast_data_char);
+                }
+                break;
+
+            case DONE_FAST:
+                // MSP stopped fast reporting (time limit, low energy, or on request)
+                if (fast_state != FAST_START) {
+                    fast_state = FAST_NONE;
+                    event_fast_control[1] = 0;
+                    simple_ble_notify_char(&event_fast_control_char);
+                }
+                break;
+
+            case START_TRIGGER:
+                // MSP is armed, samples arrive once the trigger fires
+                rawSample_status = 3;
+                simple_ble_notify_char(&rawSample_char_status);
+                if (rawSample_state != RS_QUIT) {
+                    rawSample_state = RS_ARMED;
+                }
+                break;
+
+            case DONE_TRIGGER:
+                // trigger fired and the capture is frozen. Position is big-endian
+                if ((len-1) == DONE_TRIGGER_LEN) {
+                    rawSample_trigger_position = (buf[1] << 8) + buf[2];
+                    simple_ble_notify_char(&rawSample_char_trigger_position);
+                }
+
+                // request the first block of samples
+                if (rawSample_state != RS_QUIT) {
+                    rawSample_state = RS_NEXT;
+                }
+                break;
+
             case CONT_SAMDATA:
                 // update data
                 memcpy(raw_sample_data, &(buf[1]), len-1);
@@ -828,6 +1355,7 @@ void on_receive_message(uint8_t* buf, uint16_t len) {
             case DONE_SAMDATA:
                 // notify user samples are done
                 begin_rawSample = false;
+                rawSample_trigger[0] = 0;
                 rawSample_status = 2;
                 simple_ble_notify_char(&rawSample_char_status);
 
@@ -838,6 +1366,22 @@ void on_receive_message(uint8_t* buf, uint16_t len) {
                 rawSample_state = RS_NONE;
                 break;
 
+            case EVENT_SIG:
+                // MSP detected an appliance turning on, pass the signature along
+                if ((len-1) == EVENT_SIG_LEN) {
+                    memcpy(event_signature, &(buf[1]), len-1);
+                    simple_ble_notify_char(&event_signature_char);
+                }
+                break;
+
+            case EVENT_PQ:
+                // MSP logged a sag, swell, or interruption
+                if ((len-1) == EVENT_PQ_LEN) {
+                    memcpy(event_pq, &(buf[1]), len-1);
+                    simple_ble_notify_char(&event_pq_char);
+                }
+                break;
+
             default:
                 // unhandled uart type. Don't handle it
                 break;
@@ -861,6 +1405,9 @@ void on_receive_message(uint8_t* buf, uint16_t len) {
         } else if (rawSample_state == RS_WAIT_START) {
             status_code = STATUS_NO_RS_START;
             simple_ble_notify_char(&config_status_char);
+        } else if (rawSample_state == RS_WAIT_TRIGGER) {
+            status_code = STATUS_NO_RS_TRIGGER;
+            simple_ble_notify_char(&config_status_char);
         } else if (rawSample_state == RS_WAIT_DATA) {
             status_code = STATUS_NO_RS_DATA;
             simple_ble_notify_char(&config_status_char);
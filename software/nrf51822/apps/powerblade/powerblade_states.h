@@ -18,6 +18,9 @@ typedef enum {
     RS_QUIT,
     RS_WAIT_QUIT,
     RS_IDLE,
+    RS_TRIGGER,
+    RS_WAIT_TRIGGER,
+    RS_ARMED,
 } RawSampleState_t;
 
 // state machine for local calibration
@@ -39,6 +42,22 @@ typedef enum {
     CONF_SET_VALUES,
 } ConfigurationState_t;
 
+// state machine for statistics requests
+typedef enum {
+    STATS_NONE=0,
+    STATS_GET,
+} StatsState_t;
+
+// state machine for fast reporting
+typedef enum {
+    FAST_NONE=0,
+    FAST_START,
+    FAST_WAIT_START,
+    FAST_RUNNING,
+    FAST_STOP,
+    FAST_WAIT_STOP,
+} FastState_t;
+
 // state machine for startup
 typedef enum {
     STARTUP_NONE=0,
@@ -60,6 +79,7 @@ typedef enum {
     STATUS_NO_CALIB_CONTINUE,
     STATUS_NO_CALIB_GET_CONFIG,
     STATUS_NO_CALIB_STOP,
+    STATUS_NO_RS_TRIGGER,
 } StatusCode_t;
 
 #endif
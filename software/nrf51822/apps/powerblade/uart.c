@@ -21,6 +21,13 @@
 static bool uart_rxing = false;
 static bool uart_txing = false;
 
+// receive ring. Single producer (UART0_IRQHandler) writes only rx_head,
+//  single consumer (scheduler) writes only rx_tail, so no locking is needed
+static uint8_t rx_ring[UART_RX_RING_LEN];
+static volatile uint16_t rx_head = 0;
+static volatile uint16_t rx_tail = 0;
+static volatile uint16_t rx_overruns = 0; // bytes dropped, for debugging
+
 void uart_init (void) {
     // apply config
     nrf_gpio_cfg_input(UART_RX_PIN, NRF_GPIO_PIN_NOPULL);
@@ -82,3 +89,29 @@ void uart_tx_disable(void) {
     }
 }
 
+
+bool uart_rx_put(uint8_t byte) {
+    // called from interrupt context. Drop the byte if the ring is full, the
+    //  packet it belonged to will fail its checksum
+    uint16_t head = rx_head;
+    if ((uint16_t)(head - rx_tail) >= UART_RX_RING_LEN) {
+        rx_overruns++;
+        return false;
+    }
+
+    rx_ring[head & (UART_RX_RING_LEN-1)] = byte;
+    rx_head = head + 1;
+    return true;
+}
+
+bool uart_rx_get(uint8_t* byte) {
+    // called from scheduler context
+    uint16_t tail = rx_tail;
+    if (tail == rx_head) {
+        return false;
+    }
+
+    *byte = rx_ring[tail & (UART_RX_RING_LEN-1)];
+    rx_tail = tail + 1;
+    return true;
+}
@@ -1,6 +1,9 @@
 #ifndef POWERBLADE_UART_H
 #define POWERBLADE_UART_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
 // function prototypes
 void uart_init(void);
 void uart_rx_enable(void);
@@ -8,5 +11,12 @@ void uart_tx_enable(void);
 void uart_rx_disable(void);
 void uart_tx_disable(void);
 
+// receive ring, filled a byte at a time by the RX interrupt and drained in
+//  app_scheduler context. Holds a quarter second at 9600 baud, far more than
+//  the main loop is ever held off by the radio
+#define UART_RX_RING_LEN 256 // power of two
+bool uart_rx_put(uint8_t byte);
+bool uart_rx_get(uint8_t* byte);
+
 #endif //POWERBLADE_UART_H
 
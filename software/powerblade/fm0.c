@@ -0,0 +1,65 @@
+#include "fm0.h"
+
+// Levels for each byte, starting from a low level
+#define F1(b)	FM0_WORD(b)
+#define F4(b)	F1(b), F1((b) + 1), F1((b) + 2), F1((b) + 3)
+#define F16(b)	F4(b), F4((b) + 4), F4((b) + 8), F4((b) + 12)
+#define F64(b)	F16(b), F16((b) + 16), F16((b) + 32), F16((b) + 48)
+
+static const uint16_t fm0_lut[256] = {
+	F64(0), F64(64), F64(128), F64(192)
+};
+
+static const char fm0_epc[MILLER_BYTES(FM0_BASE_HALVES, 1)] = { FM0_EPC_TEMPLATE };
+
+// Pilot, preamble, PC and marker
+const char* fm0_template(void) {
+	return fm0_epc;
+}
+
+// Encode a single data bit, two bits of the buffer
+void fm0_bit(char* buf, miller_state_t* st, uint8_t bit) {
+	uint8_t first = !st->phase;					// Flip at the boundary
+	uint8_t second = bit ? first : !first;		// and in the middle of a zero
+	uint8_t levels = first | (second << 1);
+
+	if(st->fill) {									// Keep the bits already there
+		buf[st->index] = (buf[st->index] & ((1 << st->fill) - 1)) | (levels << st->fill);
+	}
+	else {
+		buf[st->index] = levels;
+	}
+	st->fill += 2;
+	if(st->fill == 8) {
+		st->index++;
+		st->fill = 0;
+	}
+	st->prev = bit;
+	st->phase = second;
+}
+
+// Encode one byte (MSB first) into two bytes of levels, shifted along by
+// whatever the last byte already holds. The header template carries EPC
+// levels past its end, so the rest of that byte is cleared
+void fm0_put(char* buf, miller_state_t* st, uint8_t data) {
+	uint16_t levels = fm0_lut[data];
+	if(st->phase) {
+		levels = ~levels;
+	}
+	st->prev = data & 0x01;
+	st->phase = levels >> 15;
+
+	char* out = buf + st->index;
+	uint8_t lo = levels & 0xFF;
+	uint8_t hi = levels >> 8;
+	if(st->fill) {
+		out[0] = (out[0] & ((1 << st->fill) - 1)) | (lo << st->fill);
+		out[1] = (lo >> (8 - st->fill)) | (hi << st->fill);
+		out[2] = hi >> (8 - st->fill);
+	}
+	else {
+		out[0] = lo;
+		out[1] = hi;
+	}
+	st->index += 2;
+}
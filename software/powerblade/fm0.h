@@ -0,0 +1,69 @@
+#ifndef FM0_H_
+#define FM0_H_
+
+#include <stdint.h>
+
+#include "gen2.h"
+#include "miller.h"
+
+/**************************************************************************
+   FM0 ENCODING SECTION
+ **************************************************************************/
+// FM0 is Query M = 1, miller_m == 1 here. The level inverts at every bit
+// boundary and a '0' inverts again in the middle. A half bit is one SPI bit
+// at the same clock as a Miller subcarrier bit, so a data bit is two bits
+// of the reply buffer and the data rate is twice that of M = 2
+#define FM0_PILOT		12			// TRext = 1, none for TRext = 0
+#define FM0_HDR_HALVES	((FM0_PILOT + LEN_PMBL) * 2)
+#define FM0_BASE_HALVES	(FM0_HDR_HALVES + EPC_BASE_LEN * 2)
+#define FM0_HDR_LEVEL	1			// Level the preamble ends on
+
+/**************************************************************************
+   COMPILE TIME ENCODING SECTION
+ **************************************************************************/
+// A data byte is 16 levels, written as a 16 bit word in the order they go
+// out (first half bit in bit 0, 1 = high). Starting from a low level, the
+// first half of bit i is high if the bits before it hold an even number of
+// ones, and a byte ends on the parity of its ones. From a high level the
+// word is inverted
+#define FM0_PAR(x)		((0x6996 >> (((x) ^ ((x) >> 4)) & 0xF)) & 1)
+#define FM0_FIRST(b, i)	(!FM0_PAR((b) >> (8 - (i))))
+#define FM0_SECOND(b, i)	(FM0_FIRST(b, i) ^ !(((b) >> (7 - (i))) & 1))
+#define FM0_BIT(b, i)	((FM0_FIRST(b, i) << (2 * (i))) | (FM0_SECOND(b, i) << (2 * (i) + 1)))
+#define FM0_WORD(b)		((uint16_t)(FM0_BIT(b, 0) | FM0_BIT(b, 1) | FM0_BIT(b, 2) | FM0_BIT(b, 3) | \
+							FM0_BIT(b, 4) | FM0_BIT(b, 5) | FM0_BIT(b, 6) | FM0_BIT(b, 7)))
+
+// Level before each byte of the base EPC
+enum {
+	FM0_L0 = FM0_HDR_LEVEL,
+	FM0_L1 = FM0_L0 ^ FM0_PAR(EPC_B(0)),
+	FM0_L2 = FM0_L1 ^ FM0_PAR(EPC_B(1)),
+	FM0_L3 = FM0_L2 ^ FM0_PAR(EPC_B(2)),
+	FM0_L4 = FM0_L3 ^ FM0_PAR(EPC_B(3))
+};
+
+#define FM0_TAIL_LEVEL	FM0_L4
+
+// Base EPC levels, 64 of them, after the 36 of the header
+#define FM0_W(k, l)		((uint64_t)(uint16_t)(FM0_WORD(EPC_B(k)) ^ ((l) ? 0xFFFF : 0)) << (16 * (k)))
+#define FM0_BASE		(FM0_W(0, FM0_L0) | FM0_W(1, FM0_L1) | FM0_W(2, FM0_L2) | FM0_W(3, FM0_L3))
+#define FM0_BASE_B(j)	((uint8_t)(FM0_BASE >> (8 * (j) - 4)))
+
+// Pilot of twelve zeros, then 1010v1 with the violation (Gen2 figure
+// 6.11): high high, low high, low low, high low, low low, high high
+#define FM0_PILOT4		0x55		// Four zeros, high low each
+#define FM0_PMBL_LO		0x4B		// 1010
+#define FM0_PMBL_HI		0x0C		// v1, half a byte
+
+// Pilot, preamble, PC and marker. The last byte is half full
+#define FM0_EPC_TEMPLATE	FM0_PILOT4, FM0_PILOT4, FM0_PILOT4, FM0_PMBL_LO, \
+							FM0_PMBL_HI | (uint8_t)((FM0_BASE & 0xF) << 4), \
+							FM0_BASE_B(1), FM0_BASE_B(2), FM0_BASE_B(3), FM0_BASE_B(4), \
+							FM0_BASE_B(5), FM0_BASE_B(6), FM0_BASE_B(7), (uint8_t)(FM0_BASE >> 60)
+
+
+const char* fm0_template(void);
+void fm0_bit(char* buf, miller_state_t* st, uint8_t bit);
+void fm0_put(char* buf, miller_state_t* st, uint8_t data);
+
+#endif // FM0_H_
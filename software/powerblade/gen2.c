@@ -0,0 +1,222 @@
+#include "gen2.h"
+
+static gen2_cmd_t cmd;		// Command being received, cmd_none until the code is in
+static uint8_t cmd_stage;
+
+enum {
+	stage_ebv,				// Inside an EBV
+	stage_length,			// Select Length field
+	stage_body				// Fixed length from here to the end
+};
+
+// CRC-16/CCITT table, built from the entries for single bits
+#define CRC_T(i)	((((i) & 0x01) ? 0x1021 : 0) ^ (((i) & 0x02) ? 0x2042 : 0) ^ \
+					 (((i) & 0x04) ? 0x4084 : 0) ^ (((i) & 0x08) ? 0x8108 : 0) ^ \
+					 (((i) & 0x10) ? 0x1231 : 0) ^ (((i) & 0x20) ? 0x2462 : 0) ^ \
+					 (((i) & 0x40) ? 0x48C4 : 0) ^ (((i) & 0x80) ? 0x9188 : 0))
+#define CRC_T4(i)	CRC_T(i), CRC_T((i) + 1), CRC_T((i) + 2), CRC_T((i) + 3)
+#define CRC_T16(i)	CRC_T4(i), CRC_T4((i) + 4), CRC_T4((i) + 8), CRC_T4((i) + 12)
+#define CRC_T64(i)	CRC_T16(i), CRC_T16((i) + 16), CRC_T16((i) + 32), CRC_T16((i) + 48)
+
+static const unsigned short crc_tabccitt[256] = {
+	CRC_T64(0), CRC_T64(64), CRC_T64(128), CRC_T64(192)
+};
+
+// Start a new command
+void cmd_start(void) {
+	cmd = cmd_none;
+	cmd_cur = 0;
+	cmd_count = 0;
+	cmd_len = 2;
+	cmd_crc16 = 0xFFFF;
+	cmd_crc5 = CRC5_PRESET;
+}
+
+// Command complete. Those with a CRC only count if it checks out
+static gen2_cmd_t cmd_done(void) {
+	switch(cmd) {
+	case cmd_query:
+		return cmd_crc5 ? cmd_crc_error : cmd;
+	case cmd_select:
+	case cmd_req_rn:
+	case cmd_read:
+		return (cmd_crc16 == CRC16_RESIDUE) ? cmd : cmd_crc_error;
+	default:
+		return cmd;
+	}
+}
+
+// Called when cmd_count reaches cmd_len. Returns the command once it is
+// complete, or cmd_none after moving cmd_len on to the next field
+gen2_cmd_t cmd_step(void) {
+	uint8_t part = cmd_count & 7;
+	if(part && (cmd_count >> 3) < CMD_BUF_LEN) {
+		cmd_buf[cmd_count >> 3] = cmd_cur << (8 - part);
+	}
+
+	switch(cmd) {
+	case cmd_none:
+		if(cmd_count == 2) {
+			switch(cmd_field(0, 2)) {
+			case CMD_QUERYREP:
+				cmd = cmd_query_rep;
+				cmd_len = QUERYREP_LEN;
+				break;
+			case CMD_ACK:
+				cmd = cmd_ack;
+				cmd_len = ACK_LEN;
+				break;
+			default:
+				cmd_len = 4;
+				break;
+			}
+		}
+		else if(cmd_count == 4) {
+			switch(cmd_field(0, 4)) {
+			case CMD_QUERY:
+				cmd = cmd_query;
+				cmd_len = QUERY_LEN;
+				break;
+			case CMD_QUERYADJ:
+				cmd = cmd_query_adjust;
+				cmd_len = QUERYADJ_LEN;
+				break;
+			case CMD_SELECT:
+				cmd = cmd_select;
+				cmd_stage = stage_ebv;
+				cmd_len = SELECT_HDR_LEN + EBV_LEN;
+				break;
+			case 0xB:
+				return cmd_unknown;		// Reserved
+			default:
+				cmd_len = 8;
+				break;
+			}
+		}
+		else {
+			switch(cmd_field(0, 8)) {
+			case CMD_NAK:
+				return cmd_nak;
+			case CMD_REQ_RN:
+				cmd = cmd_req_rn;
+				cmd_len = REQ_RN_LEN;
+				break;
+			case CMD_READ:
+				cmd = cmd_read;
+				cmd_stage = stage_ebv;
+				cmd_len = READ_HDR_LEN + EBV_LEN;
+				break;
+			default:
+				return cmd_unknown;		// Write, Kill, Lock, ...
+			}
+		}
+		return cmd_none;
+	case cmd_select:
+	case cmd_read:
+		if(cmd_stage == stage_ebv) {
+			if(cmd_field(cmd_len - EBV_LEN, 1)) {		// Another block
+				cmd_len += EBV_LEN;
+			}
+			else if(cmd == cmd_select) {
+				cmd_stage = stage_length;
+				cmd_len += 8;
+			}
+			else {
+				cmd_stage = stage_body;
+				cmd_len += 8 + RN16_LEN + CRC_LEN;		// WordCount, RN, CRC-16
+			}
+			return cmd_none;
+		}
+		if(cmd_stage == stage_length) {
+			cmd_stage = stage_body;
+			cmd_len += cmd_field(cmd_len - 8, 8) + 1 + CRC_LEN;	// Mask, Truncate, CRC-16
+			return cmd_none;
+		}
+		return cmd_done();
+	default:
+		return cmd_done();
+	}
+}
+
+// Field of the received command, MSB first
+uint16_t cmd_field(uint16_t start, uint8_t len) {
+	uint16_t val = 0;
+	while(len--) {
+		val = (val << 1) | ((cmd_buf[start >> 3] >> (7 - (start & 7))) & 0x01);
+		start++;
+	}
+	return val;
+}
+
+// EBV starting at *pos, leaves *pos after it
+uint16_t cmd_ebv(uint16_t* pos) {
+	uint16_t val = 0;
+	char more;
+	do {
+		more = cmd_field(*pos, 1);
+		val = (val << 7) | cmd_field(*pos + 1, 7);
+		*pos += EBV_LEN;
+	} while(more);
+	return val;
+}
+
+uint16_t calc_crc(uint16_t crc_start, char* dat, unsigned short len) {
+	//unsigned char i;
+	//volatile unsigned int data;
+	unsigned short tmp, short_c;
+	volatile unsigned int crc;
+
+	crc = ~crc_start;
+	//len >>= 1;
+
+	do {
+//		unsigned short c1 = (unsigned short)((*dat++ - '0') << 4);
+//		unsigned short c2 = (unsigned short)(*dat++ - '0');
+//		short_c = (unsigned short)(c1 | c2);//(0x00ff & (unsigned short)*dat) - '0';
+		short_c = (unsigned short)(*(dat + len - 1));
+//		dat += temp;
+//		short_c = 0x0000;
+
+		tmp = ((crc >> 8) ^ short_c) & 0xFF;
+		crc = (crc << 8) ^ crc_tabccitt[tmp];
+
+//		data = (unsigned int)0xff & *dat++;
+//		crc ^= data;
+//		//data = 0x0000;
+//		for(i = 0; i < 8; i++, data >>= 1) {
+//			if(crc & 0x0001) {
+//				crc = (crc >> 1) ^ POLY;
+//			}
+//			else {
+//				crc = (crc >> 1);
+//			}
+//		}
+	} while(--len);
+
+	crc = ~crc;
+
+//	data = crc;
+//	crc = (crc << 8) | (data >> 8 & 0xFF);
+
+	return crc;
+}
+
+// Same CRC as calc_crc, over the low len bits of data (MSB first) for
+// fields that are not whole bytes
+uint16_t crc16_bits(uint16_t crc_start, uint16_t data, uint8_t len) {
+	uint16_t crc = ~crc_start;
+	uint16_t mask = 1 << (len - 1);
+
+	while(mask) {
+		char in = (data & mask) ? 1 : 0;
+		if(((crc >> 15) & 0x01) ^ in) {
+			crc = (crc << 1) ^ P_CCITT;
+		}
+		else {
+			crc = crc << 1;
+		}
+		mask >>= 1;
+	}
+
+	return ~crc;
+}
@@ -0,0 +1,103 @@
+#ifndef GEN2_H_
+#define GEN2_H_
+
+#include <stdint.h>
+
+/**************************************************************************
+   INVENTORY SECTION
+ **************************************************************************/
+// Lengths in bits
+#define RN16_LEN		16
+#define EPC_LEN			80			// PC and a 64 bit EPC
+#define EPC_BASE_LEN	32			// PC and marker, fixed at compile time
+#define EPC_TAIL_LEN	48			// Metering record, staged at run time
+#define CRC_LEN			16
+
+//#define POLY 			0x8408
+#define P_CCITT     	0x1021
+#define CRC16_RESIDUE	0x1D0F		// Register after a command and its good CRC-16
+
+// CRC-5 on Query, x^5 + x^3 + 1 preset to 01001. Kept in the top five bits
+// of a byte so it shifts like the CRC-16. A good CRC leaves zero
+#define CRC5_PRESET		0x48
+#define CRC5_POLY		0x48
+
+// PC word in front of the EPC, EPC length in words
+#define EPC_PC			(((EPC_LEN - 16) / 16) << 11)
+#define EPC_MARKER		0xB1DE
+#define EPC_BASE_BITS	(((uint32_t)EPC_PC << 16) | EPC_MARKER)
+
+/**************************************************************************
+   COMMAND SECTION
+ **************************************************************************/
+// Command codes, sent MSB first
+#define CMD_QUERYREP	0x0			// 00
+#define CMD_ACK			0x1			// 01
+#define CMD_QUERY		0x8			// 1000
+#define CMD_QUERYADJ	0x9			// 1001
+#define CMD_SELECT		0xA			// 1010
+#define CMD_NAK			0xC0		// 11000000
+#define CMD_REQ_RN		0xC1		// 11000001
+#define CMD_READ		0xC2		// 11000010
+
+// Command lengths in bits. Select and Read carry EBVs (8 bit blocks, the
+// first bit of each says another block follows) so they grow as they arrive
+#define QUERYREP_LEN	4
+#define ACK_LEN			(2 + RN16_LEN)
+#define QUERY_LEN		22
+#define QUERYADJ_LEN	9
+#define NAK_LEN			8
+#define REQ_RN_LEN		(8 + RN16_LEN + CRC_LEN)
+#define SELECT_HDR_LEN	12			// Code, Target, Action, MemBank
+#define READ_HDR_LEN	10			// Code, MemBank
+#define EBV_LEN			8
+
+#define CMD_BUF_LEN		40			// Bytes, a Select with a 255 bit mask
+#define READ_MAX_WORDS	9			// Longest Read reply, a whole bank (METER_WORDS)
+
+// Memory banks
+#define BANK_RESERVED	0
+#define BANK_EPC		1
+#define BANK_TID		2
+#define BANK_USER		3
+
+// Select Target, and the Query Sel field
+#define SEL_TARGET_SL	4			// 0-3 are the session inventoried flags
+#define SEL_NOT_SL		2			// Query Sel, 0 and 1 are All
+#define SEL_SL			3
+
+// Error codes for the Read reply
+#define ERR_OTHER		0x00
+#define ERR_OVERRUN		0x03
+
+typedef enum {
+	cmd_none,				// Still arriving
+	cmd_query_rep,
+	cmd_ack,
+	cmd_query,
+	cmd_query_adjust,
+	cmd_select,
+	cmd_nak,
+	cmd_req_rn,
+	cmd_read,
+	cmd_crc_error,			// Complete, failed its CRC
+	cmd_unknown
+} gen2_cmd_t;
+
+// Received command bits, packed MSB first
+uint8_t cmd_buf[CMD_BUF_LEN];
+uint8_t cmd_cur;			// Last 8 bits in, flushed to cmd_buf each byte
+uint16_t cmd_count;			// Bits received
+uint16_t cmd_len;			// Bit count at which cmd_step() has to look again
+uint16_t cmd_crc16;			// CRC registers over every bit so far, MSB first
+uint8_t cmd_crc5;
+
+void cmd_start(void);
+gen2_cmd_t cmd_step(void);
+uint16_t cmd_field(uint16_t start, uint8_t len);
+uint16_t cmd_ebv(uint16_t* pos);
+
+uint16_t calc_crc(uint16_t crc_start, char* dat, unsigned short len);
+uint16_t crc16_bits(uint16_t crc_start, uint16_t data, uint8_t len);
+
+#endif // GEN2_H_
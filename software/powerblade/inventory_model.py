@@ -0,0 +1,199 @@
+#! /usr/bin/env python3
+# model Gen2 inventory throughput (EPC reads/s) against the number of PowerBlade tags in the field
+
+import random
+random.seed("Seed string")
+
+####################
+## configuration
+####################
+# Notes:
+# link timing matches the tag firmware at M=8 and BLF = 200kHz (2.5us per subcarrier half cycle), 16 bit
+# pilot tone on every reply, T1 = max(RTcal, 10 Tpri) = 75us. Reader side is Tari = 25us, data-1 = 2 Tari
+
+# numbers of tags to simulate
+tag_counts = [1, 2, 3, 4, 8, 16, 32, 64]
+
+# duration of each run, in us
+duration = 10*1000*1000
+
+# chance that the reader still decodes the strongest RN16 of a collision (capture effect)
+capture = 0.2
+
+# reader Q algorithm (Gen2 Annex D)
+q_start = 4.0
+q_step = 0.3
+
+# reader timing, in us
+tari = 25
+data1 = 2*tari
+rtcal = tari + data1
+trcal = 106.7                   # DR = 64/3 at 200kHz
+delimiter = 12.5
+bit = (tari + data1) / 2        # average data symbol
+preamble = delimiter + tari + rtcal + trcal
+framesync = delimiter + tari + rtcal
+
+# tag timing, in us
+tag_bit = 8 / 0.2               # M=8 at 200kHz
+tag_header = 16 + 6             # pilot tone and preamble, in bits
+t1 = 75
+t2 = 50
+t3 = 20
+
+# command and reply lengths in bits
+QUERY_LEN = 22
+QUERYREP_LEN = 4
+QUERYADJ_LEN = 9
+ACK_LEN = 18
+RN16_REPLY = 16
+EPC_REPLY = 80 + 16
+
+
+####################
+## code
+####################
+
+def command(bits, query=False):
+    return (preamble if query else framesync) + bits*bit
+
+def reply(bits):
+    return (tag_header + bits + 1)*tag_bit
+
+# tag states, as in cmd_reply() in main.c
+READY, ARBITRATE, REPLY, ACKED = range(4)
+
+class Tag:
+    def __init__(self, fixed):
+        self.fixed = fixed
+        self.flag = 0
+        self.state = READY
+        self.slot = 0
+        self.rn16 = 0xFACE
+
+    def start(self, q):
+        self.slot = random.randrange(2**q)
+        return self.check()
+
+    def check(self):
+        if self.slot != 0:
+            self.state = ARBITRATE
+            return False
+        self.state = REPLY
+        if not self.fixed:
+            self.rn16 = random.randrange(2**16)
+        return True
+
+    def done(self):
+        self.flag ^= 1
+        self.state = READY
+
+    # returns True if the tag backscatters an RN16
+    def query(self, target, q):
+        if self.fixed:
+            self.state = REPLY
+            return True
+        if self.state == ACKED:
+            self.done()
+        if self.flag != target:
+            self.state = READY
+            return False
+        return self.start(q)
+
+    def query_adjust(self, q):
+        if self.state == READY:
+            return False
+        if self.state == ACKED:
+            self.done()
+            return False
+        return self.start(q)
+
+    def query_rep(self):
+        if self.state == READY:
+            return False
+        if self.state == ACKED:
+            self.done()
+            return False
+        if self.state == REPLY:
+            self.slot = 0x7FFF
+            self.state = ARBITRATE
+            return False
+        self.slot -= 1
+        return self.check()
+
+    # returns True if the tag backscatters its EPC
+    def ack(self, rn16):
+        if self.state == REPLY and rn16 == self.rn16:
+            self.state = ACKED
+            return True
+        if self.state == REPLY:
+            self.slot = 0x7FFF
+            self.state = ARBITRATE
+        return False
+
+def run(count, fixed):
+    tags = [Tag(fixed) for i in range(count)]
+    time = 0
+    reads = 0
+    target = 0
+    qfp = q_start
+    q = int(round(qfp))
+    cmd = 'query'
+    slots = 0           # slots left in the round
+    heard_any = False   # any reply in the round
+
+    while time < duration:
+        # reader command
+        if cmd == 'query':
+            time += command(QUERY_LEN, query=True)
+            replies = [t for t in tags if t.query(target, q)]
+            slots = 2**q
+            heard_any = False
+        elif cmd == 'adjust':
+            time += command(QUERYADJ_LEN)
+            replies = [t for t in tags if t.query_adjust(q)]
+            slots = 2**q
+        else:
+            time += command(QUERYREP_LEN)
+            replies = [t for t in tags if t.query_rep()]
+
+        # slot outcome
+        time += t1
+        slots -= 1
+        heard_any = heard_any or len(replies) > 0
+        if len(replies) == 0:
+            time += t3
+            qfp = max(0, qfp - q_step)
+        else:
+            time += reply(RN16_REPLY) + t2
+            if len(replies) == 1 or random.random() < capture:
+                heard = random.choice(replies)
+                time += command(ACK_LEN) + t1
+                epcs = [t for t in replies if t.ack(heard.rn16)]
+                time += reply(EPC_REPLY) + t2
+                if len(epcs) == 1:
+                    reads += 1
+            if len(replies) > 1:
+                qfp = min(15, qfp + q_step)
+
+        # next command
+        if fixed:
+            cmd = 'query'       # the old firmware only understood Query and ACK
+        elif slots == 0:
+            if not heard_any:
+                target ^= 1     # every tag read, inventory the other flag
+            q = int(round(qfp))
+            cmd = 'query'
+        elif int(round(qfp)) != q:
+            q = int(round(qfp))
+            cmd = 'adjust'
+        else:
+            cmd = 'rep'
+
+    return reads / (time / 1e6)
+
+print("tags   fixed RN16 reads/s   Q algorithm reads/s   per tag")
+for count in tag_counts:
+    fixed = run(count, True)
+    slotted = run(count, False)
+    print("{:4d}   {:18.1f}   {:19.1f}   {:7.1f}".format(count, fixed, slotted, slotted / count))
@@ -0,0 +1,55 @@
+#include <msp430.h>
+
+#include "meter.h"
+
+// Hand over a new record. The EPC picks it up a byte at a time while the
+// tag is idle, see epc_stage_step()
+void meter_set(const meter_t* rec) {
+	__disable_interrupt();
+	meter = *rec;
+	meter_new = 1;
+	__enable_interrupt();
+}
+
+// Word of user memory
+uint16_t meter_word(const meter_t* rec, uint16_t ptr) {
+	switch(ptr) {
+	case 0:
+		return rec->sequence >> 16;
+	case 1:
+		return rec->sequence & 0xFFFF;
+	case 2:
+		return rec->scale >> 16;
+	case 3:
+		return rec->scale & 0xFFFF;
+	case 4:
+		return ((uint16_t)rec->vrms << 8) | rec->flags;
+	case 5:
+		return rec->true_power;
+	case 6:
+		return rec->apparent_power;
+	case 7:
+		return rec->watt_hours >> 16;
+	default:
+		return rec->watt_hours & 0xFFFF;
+	}
+}
+
+// Byte k of the EPC tail (EPC_TAIL_LEN): the low byte of the sequence,
+// Vrms, true power and the low 16 bits of watt-hours
+uint8_t meter_tail_byte(const meter_t* rec, uint8_t k) {
+	switch(k) {
+	case 0:
+		return rec->sequence & 0xFF;
+	case 1:
+		return rec->vrms;
+	case 2:
+		return rec->true_power >> 8;
+	case 3:
+		return rec->true_power & 0xFF;
+	case 4:
+		return (rec->watt_hours >> 8) & 0xFF;
+	default:
+		return rec->watt_hours & 0xFF;
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef METER_H_
+#define METER_H_
+
+#include <stdint.h>
+
+#include "meter_record.h"		// meter_t, from common/include
+
+/**************************************************************************
+   METERING RECORD SECTION
+ **************************************************************************/
+// User memory is the whole record in big endian words: sequence, scale,
+// Vrms and flags, true power, apparent power, watt-hours
+#define METER_WORDS		9
+
+meter_t meter;				// Latest record from the measurement side
+meter_t meter_epc;			// Record in the EPC as sent, and in user memory
+volatile uint8_t meter_new;	// meter changed since it was last staged
+
+void meter_set(const meter_t* rec);
+uint16_t meter_word(const meter_t* rec, uint16_t ptr);
+uint8_t meter_tail_byte(const meter_t* rec, uint8_t k);
+
+#endif // METER_H_
@@ -0,0 +1,186 @@
+#include <string.h>
+
+#include "fm0.h"
+#include "miller.h"
+
+// Encoded half bits for each byte, following a '1' that ended in phase 0
+#define L1(b)	MILLER_BYTE(b)
+#define L4(b)	L1(b), L1((b) + 1), L1((b) + 2), L1((b) + 3)
+#define L16(b)	L4(b), L4((b) + 4), L4((b) + 8), L4((b) + 12)
+#define L64(b)	L16(b), L16((b) + 16), L16((b) + 32), L16((b) + 48)
+
+static const uint16_t miller_lut[256] = {
+	L64(0), L64(64), L64(128), L64(192)
+};
+
+// Buffer byte for two half bits at M = 4 and four at M = 2, first in the MSB
+#define P4(x)	MILLER_PAIR_M4(x)
+#define Q2(x)	MILLER_QUAD_M2(x)
+
+static const uint8_t miller_m4[4] = { P4(0), P4(1), P4(2), P4(3) };
+static const uint8_t miller_m2[16] = {
+	Q2(0), Q2(1), Q2(2), Q2(3), Q2(4), Q2(5), Q2(6), Q2(7),
+	Q2(8), Q2(9), Q2(10), Q2(11), Q2(12), Q2(13), Q2(14), Q2(15)
+};
+
+// Tone, preamble, PC and marker at each M
+static const char miller_epc_m8[MILLER_BYTES(MILLER_BASE_HALVES, 8)] = { MILLER_EPC_TEMPLATE(MILLER_QUAD_M8) };
+static const char miller_epc_m4[MILLER_BYTES(MILLER_BASE_HALVES, 4)] = { MILLER_EPC_TEMPLATE(MILLER_QUAD_M4) };
+static const char miller_epc_m2[MILLER_BYTES(MILLER_BASE_HALVES, 2)] = { MILLER_EPC_TEMPLATE(MILLER_QUAD_M2) };
+
+// Start of the EPC reply at miller_m, the first part is the tone and preamble
+const char* miller_template(void) {
+	switch(miller_m) {
+	case 1:
+		return fm0_template();
+	case 2:
+		return miller_epc_m2;
+	case 4:
+		return miller_epc_m4;
+	default:
+		return miller_epc_m8;
+	}
+}
+
+// Half bits of tone (or pilot) and preamble
+static uint8_t hdr_halves(void) {
+	return miller_m == 1 ? FM0_HDR_HALVES : MILLER_HDR_HALVES;
+}
+
+// Position after a number of half bits
+static void miller_at(miller_state_t* st, uint16_t halves) {
+	halves *= miller_m;
+	st->index = halves >> 3;
+	st->fill = halves & 7;
+}
+
+// Tone and preamble for a reply built at run time
+void miller_start(char* buf, miller_state_t* st) {
+	memcpy(buf, miller_template(), MILLER_BYTES(hdr_halves(), miller_m));
+	miller_hdr_tail(st);
+}
+
+// State at the end of the preamble, for a buffer that already has it
+void miller_hdr_tail(miller_state_t* st) {
+	miller_at(st, hdr_halves());
+	st->prev = 1;
+	st->phase = miller_m == 1 ? FM0_HDR_LEVEL : 0;
+}
+
+// State at the end of the base EPC in the template
+void miller_epc_tail(miller_state_t* st) {
+	miller_at(st, hdr_halves() + EPC_BASE_LEN * 2);
+	st->prev = EPC_TAIL_PREV;
+	st->phase = miller_m == 1 ? FM0_TAIL_LEVEL : EPC_TAIL_PHASE;
+}
+
+// Encode a single data bit
+void miller_bit(char* buf, miller_state_t* st, uint8_t bit) {
+	if(miller_m == 1) {
+		fm0_bit(buf, st, bit);
+		return;
+	}
+
+	uint8_t first = st->phase;
+	if(!bit && !st->prev) {
+		first = !first;							// Flip between two zeros
+	}
+	uint8_t second = bit ? !first : first;		// Flip in the middle of a one
+	uint8_t pair = (first << 1) | second;
+
+	switch(miller_m) {
+	case 8:
+		buf[st->index++] = first ? MILLER_PHASE1 : MILLER_PHASE0;
+		buf[st->index++] = second ? MILLER_PHASE1 : MILLER_PHASE0;
+		break;
+	case 4:
+		buf[st->index++] = miller_m4[pair];
+		break;
+	default:									// Half a byte
+		pair = miller_m2[pair << 2] & 0x0F;		// Both halves in the low nibble
+		if(st->fill) {
+			buf[st->index++] |= pair << 4;
+		}
+		else {
+			buf[st->index] = pair;
+		}
+		st->fill ^= 4;
+		break;
+	}
+	st->prev = bit;
+	st->phase = second;
+}
+
+// Encode one byte (MSB first) into 16 half bits
+void miller_put(char* buf, miller_state_t* st, uint8_t data) {
+	if(miller_m == 1) {
+		fm0_put(buf, st, data);
+		return;
+	}
+
+	uint16_t half = miller_lut[data];
+	if((!st->prev && !(data & 0x80)) ^ st->phase) {
+		half = ~half;
+	}
+	st->prev = data & 0x01;
+	st->phase = half & 0x01;
+
+	char* out = buf + st->index;
+	uint16_t mask;
+	uint8_t i;
+	switch(miller_m) {
+	case 8:
+		for(mask = 0x8000; mask != 0; mask >>= 1) {
+			*out++ = (half & mask) ? MILLER_PHASE1 : MILLER_PHASE0;
+		}
+		st->index += 16;
+		break;
+	case 4:
+		for(i = 0; i < 8; i++) {
+			*out++ = miller_m4[half >> 14];
+			half <<= 2;
+		}
+		st->index += 8;
+		break;
+	default:
+		for(i = 0; i < 4; i++) {
+			uint8_t chips = miller_m2[half >> 12];
+			half <<= 4;
+			if(st->fill) {						// Straddles bytes after an odd bit count
+				out[0] |= chips << 4;
+				out[1] = chips >> 4;
+			}
+			else {
+				out[0] = chips;
+			}
+			out++;
+		}
+		st->index += 4;
+		break;
+	}
+}
+
+// Trailing '1'
+void miller_eos(char* buf, miller_state_t* st) {
+	miller_bit(buf, st, 1);
+}
+
+// Bytes to send, the last one padded with no subcarrier
+uint16_t miller_len(const miller_state_t* st) {
+	return st->index + (st->fill != 0);
+}
+
+// Every buffer starts with the TRext = 1 tone or pilot. Bytes of it to leave
+// out for TRext = 0: all of the FM0 pilot, all but LEN_TONE_SHORT bits of
+// the Miller tone
+uint8_t miller_pilot_skip(void) {
+	if(miller_m == 1) {
+		return MILLER_BYTES(FM0_PILOT * 2, 1);
+	}
+	return MILLER_BYTES((LEN_TONE - LEN_TONE_SHORT) * 2, miller_m);
+}
+
+// Bytes in the whole EPC reply
+uint16_t miller_epc_len(void) {
+	return MILLER_BYTES(hdr_halves() + (EPC_LEN + CRC_LEN + LEN_EOS) * 2, miller_m);
+}
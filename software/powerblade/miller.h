@@ -0,0 +1,116 @@
+#ifndef MILLER_H_
+#define MILLER_H_
+
+#include <stdint.h>
+
+#include "gen2.h"
+
+/**************************************************************************
+   MILLER ENCODING SECTION
+ **************************************************************************/
+// Replies are Miller M = 2, 4 or 8, as the Query asks, or FM0 (fm0.c). Each
+// data bit is two half bits of M subcarrier bits, shifted out LSB first,
+// and a half bit is either phase of the subcarrier. At M = 8 a half bit is
+// one byte, at M = 4 a nibble and at M = 2 two bits of a byte
+#define LEN_TONE		16			// TRext = 1
+#define LEN_TONE_SHORT	4			// TRext = 0
+#define LEN_PMBL		6
+#define LEN_EOS			1
+
+#define MILLER_PHASE0	0xAA
+#define MILLER_PHASE1	0x55
+
+#define MILLER_M_MAX	8
+
+// Bytes for a number of half bits at M
+#define MILLER_BYTES(halves, m)		(((halves) * (m) + 7) / 8)
+
+// Buffer sizes are for the largest M
+#define MILLER_HDR_HALVES	((LEN_TONE + LEN_PMBL) * 2)
+#define MILLER_BASE_HALVES	(MILLER_HDR_HALVES + EPC_BASE_LEN * 2)
+#define MILLER_EPC_HALVES	((LEN_TONE + LEN_PMBL + EPC_LEN + CRC_LEN + LEN_EOS) * 2)
+#define RN16_REPLY_LEN	((RN16_LEN + LEN_EOS + LEN_PMBL + LEN_TONE) * 2)
+#define EPC_REPLY_LEN	MILLER_BYTES(MILLER_EPC_HALVES, MILLER_M_MAX)
+#define EPC_TAIL_REPLY_LEN	((EPC_TAIL_LEN + CRC_LEN + LEN_EOS) * 2)
+#define READ_REPLY_LEN	((1 + READ_MAX_WORDS * 16 + RN16_LEN + CRC_LEN + LEN_EOS + LEN_PMBL + LEN_TONE) * 2)
+
+// Where the next data bit goes and what it has to follow
+typedef struct {
+	uint16_t index;		// Next byte of the reply buffer
+	uint8_t fill;		// Bits of buf[index] already used, M = 2 and FM0 only
+	uint8_t prev;		// Last data bit
+	uint8_t phase;		// Phase of the last half bit
+} miller_state_t;
+
+uint8_t miller_m;		// M the encoder writes, set from the Query, 1 for FM0
+
+/**************************************************************************
+   COMPILE TIME ENCODING SECTION
+ **************************************************************************/
+// A data byte encodes to 16 half bits, written here as a 16 bit word (first
+// half bit in the MSB, 1 = PHASE1). The word for a byte that follows a '1'
+// ending in phase 0 is built from the two nibble words below. Any other
+// history inverts the whole word, or not, so one word per byte is enough
+#define MILLER_NIB_LO	0x19181E1C39383133ULL	// Nibbles 0-7, one byte each
+#define MILLER_NIB_HI	0x6667616379787173ULL	// Nibbles 8-F
+#define MILLER_NIB(n)	((uint8_t)(((((n) & 8) ? MILLER_NIB_HI : MILLER_NIB_LO) >> (8 * ((n) & 7))) & 0xFF))
+
+// The low nibble picks up where the high one left off
+#define MILLER_HI(b)	MILLER_NIB(((b) >> 4) & 0xF)
+#define MILLER_LO(b)	(MILLER_NIB((b) & 0xF) ^ (((!((b) & 0x18)) ^ (MILLER_HI(b) & 1)) ? 0xFF : 0))
+#define MILLER_BYTE(b)	(((uint16_t)MILLER_HI(b) << 8) | MILLER_LO(b))
+
+// Inversion needed after a given last bit and phase, and the phase it leaves
+#define MILLER_MASK(b, prev, ph)	((((!(prev)) && !((b) & 0x80)) ^ (ph)) ? 0xFF : 0)
+#define MILLER_PH(b, m)				((MILLER_LO(b) ^ (m)) & 1)
+
+// Subcarrier bits for one half bit at M
+#define MILLER_HALF(ph, m)	(((ph) ? MILLER_PHASE1 : MILLER_PHASE0) & ((1 << (m)) - 1))
+
+// Four half bits (first in bit 3) as bytes at each M
+#define MILLER_QUAD_M8(x)	MILLER_HALF((x) & 8, 8), MILLER_HALF((x) & 4, 8), \
+							MILLER_HALF((x) & 2, 8), MILLER_HALF((x) & 1, 8)
+#define MILLER_PAIR_M4(x)	(MILLER_HALF((x) & 2, 4) | (MILLER_HALF((x) & 1, 4) << 4))
+#define MILLER_QUAD_M4(x)	MILLER_PAIR_M4((x) >> 2), MILLER_PAIR_M4(x)
+#define MILLER_QUAD_M2(x)	(MILLER_HALF((x) & 8, 2) | (MILLER_HALF((x) & 4, 2) << 2) | \
+							(MILLER_HALF((x) & 2, 2) << 4) | (MILLER_HALF((x) & 1, 2) << 6))
+
+// Expand encoded half bits with one of the QUAD macros above
+#define MILLER_WORD(QUAD, w)	QUAD(((w) >> 12) & 0xF), QUAD(((w) >> 8) & 0xF), QUAD(((w) >> 4) & 0xF), QUAD((w) & 0xF)
+#define MILLER_CHIPS(QUAD, b, m)	MILLER_WORD(QUAD, MILLER_BYTE(b) ^ ((m) ? 0xFFFF : 0))
+
+// Tone of 16 zeros, then the preamble 010111, ending on a '1' in phase 0
+#define MILLER_HDR_TEMPLATE(QUAD)	QUAD(0), QUAD(0), QUAD(0), QUAD(0), QUAD(0), QUAD(0), QUAD(0), QUAD(0), \
+									QUAD(0x1), QUAD(0xE), QUAD(0x6)
+
+// Bytes in the order they go out (MSB first)
+#define EPC_B(k)		((uint8_t)((EPC_BASE_BITS >> (24 - 8 * (k))) & 0xFF))
+
+enum {
+	EPC_M0 = MILLER_MASK(EPC_B(0), 1, 0),
+	EPC_M1 = MILLER_MASK(EPC_B(1), EPC_B(0) & 1, MILLER_PH(EPC_B(0), EPC_M0)),
+	EPC_M2 = MILLER_MASK(EPC_B(2), EPC_B(1) & 1, MILLER_PH(EPC_B(1), EPC_M1)),
+	EPC_M3 = MILLER_MASK(EPC_B(3), EPC_B(2) & 1, MILLER_PH(EPC_B(2), EPC_M2))
+};
+
+#define EPC_TAIL_PREV	(EPC_B(3) & 1)
+#define EPC_TAIL_PHASE	MILLER_PH(EPC_B(3), EPC_M3)
+
+// Tone, preamble, PC and marker. The metering record, CRC and EOS are staged
+#define MILLER_EPC_TEMPLATE(QUAD)	MILLER_HDR_TEMPLATE(QUAD), \
+									MILLER_CHIPS(QUAD, EPC_B(0), EPC_M0), MILLER_CHIPS(QUAD, EPC_B(1), EPC_M1), \
+									MILLER_CHIPS(QUAD, EPC_B(2), EPC_M2), MILLER_CHIPS(QUAD, EPC_B(3), EPC_M3)
+
+
+void miller_start(char* buf, miller_state_t* st);
+void miller_hdr_tail(miller_state_t* st);
+void miller_epc_tail(miller_state_t* st);
+void miller_bit(char* buf, miller_state_t* st, uint8_t bit);
+void miller_put(char* buf, miller_state_t* st, uint8_t data);
+void miller_eos(char* buf, miller_state_t* st);
+uint16_t miller_len(const miller_state_t* st);
+uint8_t miller_pilot_skip(void);
+uint16_t miller_epc_len(void);
+const char* miller_template(void);
+
+#endif // MILLER_H_
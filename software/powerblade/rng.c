@@ -0,0 +1,44 @@
+#include <msp430.h>
+
+#include "rng.h"
+
+static uint16_t rng_state = 1;		// xorshift16, never zero
+
+// Seed from the noise in the low bits of the temperature sensor
+void rng_seed(void) {
+	uint8_t i;
+
+	REFCTL0 |= REFON;							// Sensor runs off the reference
+	__delay_cycles(2000);						// Settle (~80us at 24MHz)
+
+	ADC10CTL0 = ADC10SHT_2 + ADC10ON;
+	ADC10CTL1 = ADC10SHP;
+	ADC10CTL2 = ADC10RES;						// 10-bit conversion results
+	ADC10MCTL0 = ADC10SREF_1 + ADC10INCH_10;	// Temperature sensor against VREF
+
+	for(i = 0; i < 16; i++) {
+		ADC10CTL0 |= ADC10ENC + ADC10SC;
+		while(ADC10CTL1 & ADC10BUSY);
+		rng_mix(ADC10MEM0 << i);
+		rng_next();
+		ADC10CTL0 &= ~ADC10ENC;
+	}
+
+	ADC10CTL0 = 0;								// ADC and reference off
+	REFCTL0 &= ~REFON;
+}
+
+// Fold in anything that varies, like reader edge timing against the DCO
+void rng_mix(uint16_t noise) {
+	rng_state ^= noise;
+	if(rng_state == 0) {
+		rng_state = 1;
+	}
+}
+
+uint16_t rng_next(void) {
+	rng_state ^= rng_state << 7;
+	rng_state ^= rng_state >> 9;
+	rng_state ^= rng_state << 8;
+	return rng_state;
+}
@@ -0,0 +1,10 @@
+#ifndef RNG_H_
+#define RNG_H_
+
+#include <stdint.h>
+
+void rng_seed(void);
+void rng_mix(uint16_t noise);
+uint16_t rng_next(void);
+
+#endif // RNG_H_
@@ -0,0 +1,133 @@
+#ifndef TAGSIM_MSP430_H_
+#define TAGSIM_MSP430_H_
+
+/*
+ * Stand-in for the TI device header when the tag firmware is built for the
+ * host. Registers are plain variables (tag_periph.c). TB0R, TA0R and
+ * ADC10MEM0 are computed on every read, and with TX_BITBANG TB0R and _nop() also
+ * move time on through the transmit loop
+ */
+
+#include <stdint.h>
+
+#define __interrupt
+#define __even_in_range(x, y)			(x)
+#define __enable_interrupt()			((void)0)
+#define __disable_interrupt()			((void)0)
+#define __bis_SR_register(x)			sim_sr_bis(x)
+#define __bis_SR_register_on_exit(x)	sim_sr_bis(x)
+#define __bic_SR_register_on_exit(x)	sim_sr_bic(x)
+#define __delay_cycles(x)				((void)(x))
+#ifdef TX_BITBANG
+#define _nop()							sim_nop()
+#else
+#define _nop()							((void)0)
+#endif
+#define __data16_write_addr(addr, val)	sim_write_addr((uintptr_t)(addr), (uintptr_t)(val))
+
+void sim_write_addr(uintptr_t addr, uintptr_t val);
+void sim_sr_bis(uint16_t bits);
+void sim_sr_bic(uint16_t bits);
+uint16_t sim_tb0r(void);
+uint16_t sim_ta0r(void);
+void sim_nop(void);
+uint16_t sim_p2in(void);
+uint16_t sim_adc(void);
+
+#define BIT0	0x0001
+#define BIT1	0x0002
+#define BIT2	0x0004
+#define BIT3	0x0008
+#define BIT4	0x0010
+#define BIT5	0x0020
+#define BIT6	0x0040
+#define BIT7	0x0080
+
+// Status register, as main() left it under the ISRs
+#define CPUOFF			0x0010
+#define OSCOFF			0x0020
+#define SCG0			0x0040
+#define SCG1			0x0080
+#define LPM1_bits		(CPUOFF + SCG0)
+#define LPM3_bits		(CPUOFF + SCG0 + SCG1)
+#define LPM4_bits		(CPUOFF + OSCOFF + SCG0 + SCG1)
+
+// Watchdog
+extern volatile uint16_t WDTCTL;
+#define WDTPW			0x5A00
+#define WDTHOLD			0x0080
+
+// Clock system
+extern volatile uint8_t CSCTL0_H;
+extern volatile uint16_t CSCTL1, CSCTL2, CSCTL3;
+#define DCORSEL			0x0080
+#define DCOFSEL0		0x0002
+#define DCOFSEL1		0x0004
+#define SELA_1			0x0100
+#define SELS_3			0x0030
+#define SELM_3			0x0003
+#define DIVA_0			0x0000
+#define DIVS_0			0x0000
+#define DIVM_0			0x0000
+
+// Ports
+extern volatile uint16_t PJDIR, PJOUT, PJREN;
+extern volatile uint16_t P1DIR, P1OUT, P1REN;
+extern volatile uint16_t P2DIR, P2OUT, P2REN, P2SEL0, P2SEL1, P2IES, P2IE, P2IFG;
+#define P2IN			(sim_p2in())
+
+// Timer_B0
+extern volatile uint16_t TB0CTL, TB0CCTL0, TB0CCTL1, TB0CCR0, TB0CCR1;
+#define TB0R			(sim_tb0r())
+#define TBSSEL_2		0x0200
+#define ID_2			0x0080
+#define MC_0			0x0000
+#define MC_2			0x0020
+#define MC_3			0x0030
+#define TBCLR			0x0004
+#define CM_1			0x4000
+#define CCIS_0			0x0000
+#define CAP				0x0100
+#define CCIE			0x0010
+#define CCIFG			0x0001
+
+// Timer_A0, on ACLK
+extern volatile uint16_t TA0CTL, TA0CCTL1, TA0CCR1, TA0IV;
+#define TA0R			(sim_ta0r())
+#define TASSEL_1		0x0100
+#define TACLR			0x0004
+
+// eUSCI_A0
+extern volatile uint16_t UCA0CTLW0, UCA0BRW, UCA0STATW, UCA0TXBUF, UCA0IE;
+#define UCSWRST			0x0001
+#define UCSSEL_2		0x0080
+#define UCSYNC			0x0100
+#define UCMST			0x0800
+#define UCBUSY			0x0001
+
+// DMA
+extern volatile uint16_t DMACTL0, DMA0CTL, DMA0SA, DMA0DA, DMA0SZ, DMAIV;
+#define DMA0TSEL_15		0x000F
+#define DMADT_0			0x0000
+#define DMASRCINCR_3	0x0300
+#define DMASRCBYTE		0x0040
+#define DMADSTBYTE		0x0080
+#define DMAEN			0x0010
+#define DMAIFG			0x0008
+#define DMAIE			0x0004
+
+// ADC10_B and REF
+extern volatile uint16_t ADC10CTL0, ADC10CTL1, ADC10CTL2, ADC10MCTL0, REFCTL0;
+#define ADC10MEM0		(sim_adc())
+#define ADC10SHT_2		0x0200
+#define ADC10ON			0x0010
+#define ADC10ENC		0x0002
+#define ADC10SC			0x0001
+#define ADC10SHP		0x0200
+#define ADC10BUSY		0x0001
+#define ADC10RES		0x0010
+#define ADC10SREF_1		0x0010
+#define ADC10INCH_10	0x000A
+#define REFON			0x0001
+
+#endif // TAGSIM_MSP430_H_
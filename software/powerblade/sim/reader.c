@@ -0,0 +1,367 @@
+/*
+ * Reader side of the link: PIE command frames as rising edges on RX_PIN,
+ * and Miller or FM0 decoding of what comes back on TX_PIN
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "tagsim.h"
+
+#define PILOT_HALVES	32			// TRext = 1, 16 bits of tone
+#define PILOT_SHORT		8			// TRext = 0, 4 bits
+#define PREAMBLE		0x17		// 010111
+#define PREAMBLE_LEN	6
+#define MILLER_HALF_0	0xAA		// Subcarrier bits of a half bit in phase 0, LSB first
+#define MILLER_HALF_1	0x55
+
+static reader_cfg_t cfg;
+static uint32_t rand_state;
+
+void reader_init(const reader_cfg_t* c, uint32_t seed) {
+	cfg = *c;
+	rand_state = seed ? seed : 1;
+}
+
+// Miller M for the next Query and the replies after it
+void reader_set_m(uint8_t m) {
+	cfg.m = m;
+}
+
+// Uniform in (0, 1), xorshift32
+double reader_rand(void) {
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+	return (rand_state + 0.5) / 4294967296.0;
+}
+
+static double gauss(void) {
+	return sqrt(-2 * log(reader_rand())) * cos(2 * M_PI * reader_rand());
+}
+
+/**************************************************************************
+   COMMAND SECTION
+ **************************************************************************/
+static void put(frame_t* f, uint32_t value, int len) {
+	while(len--) {
+		f->bits[f->len++] = (value >> len) & 0x01;
+	}
+}
+
+uint32_t bits_value(const uint8_t* bits, int len) {
+	uint32_t v = 0;
+	while(len--) {
+		v = (v << 1) | *bits++;
+	}
+	return v;
+}
+
+// CRC-16/Gen2 as sent: preset FFFF, poly 1021, ones' complement
+uint16_t bits_crc16(const uint8_t* bits, int len) {
+	uint16_t crc = 0xFFFF;
+	while(len--) {
+		crc = ((crc >> 15) ^ *bits++) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return ~crc;
+}
+
+// CRC-5: preset 01001, poly x^5 + x^3 + 1
+static uint8_t bits_crc5(const uint8_t* bits, int len) {
+	uint8_t crc = 0x09;
+	while(len--) {
+		crc = (((crc >> 4) ^ *bits++) & 0x01) ? ((crc << 1) ^ 0x09) & 0x1F : (crc << 1) & 0x1F;
+	}
+	return crc;
+}
+
+static void put_crc16(frame_t* f) {
+	put(f, bits_crc16(f->bits, f->len), 16);
+}
+
+// EBV, 7 bits per block, the extension bit set on all but the last
+static void put_ebv(frame_t* f, uint16_t value) {
+	int shift = 0;
+	while((value >> shift) >= 0x80) {
+		shift += 7;
+	}
+	for(; shift > 0; shift -= 7) {
+		put(f, 0x80 | ((value >> shift) & 0x7F), 8);
+	}
+	put(f, value & 0x7F, 8);
+}
+
+// DR, M, TRext and Sel from the reader config
+void frame_query(frame_t* f, uint8_t session, uint8_t target, uint8_t q) {
+	f->len = 0;
+	f->query = 1;
+	f->crc = 1;
+	f->code_len = 4;
+	put(f, 0x8, 4);
+	put(f, cfg.dr, 1);
+	put(f, cfg.m == 8 ? 3 : cfg.m == 4 ? 2 : cfg.m == 2 ? 1 : 0, 2);
+	put(f, cfg.trext, 1);
+	put(f, cfg.sel, 2);
+	put(f, session, 2);
+	put(f, target, 1);
+	put(f, q, 4);
+	put(f, bits_crc5(f->bits, f->len), 5);
+}
+
+void frame_query_rep(frame_t* f, uint8_t session) {
+	f->len = 0;
+	f->query = 0;
+	f->crc = 0;
+	f->code_len = 2;
+	put(f, 0x0, 2);
+	put(f, session, 2);
+}
+
+// UpDn 110 for Q + 1, 011 for Q - 1, 000 to keep Q
+void frame_query_adjust(frame_t* f, uint8_t session, int step) {
+	f->len = 0;
+	f->query = 0;
+	f->crc = 0;
+	f->code_len = 4;
+	put(f, 0x9, 4);
+	put(f, session, 2);
+	put(f, step > 0 ? 0x6 : step < 0 ? 0x3 : 0x0, 3);
+}
+
+void frame_ack(frame_t* f, uint16_t rn) {
+	f->len = 0;
+	f->query = 0;
+	f->crc = 0;
+	f->code_len = 2;
+	put(f, 0x1, 2);
+	put(f, rn, 16);
+}
+
+void frame_nak(frame_t* f) {
+	f->len = 0;
+	f->query = 0;
+	f->crc = 0;
+	f->code_len = 8;
+	put(f, 0xC0, 8);
+}
+
+void frame_req_rn(frame_t* f, uint16_t rn) {
+	f->len = 0;
+	f->query = 0;
+	f->crc = 1;
+	f->code_len = 8;
+	put(f, 0xC1, 8);
+	put(f, rn, 16);
+	put_crc16(f);
+}
+
+// WordPtr below 128 fits in one EBV block
+void frame_read(frame_t* f, uint8_t bank, uint16_t ptr, uint8_t count, uint16_t handle) {
+	f->len = 0;
+	f->query = 0;
+	f->crc = 1;
+	f->code_len = 8;
+	put(f, 0xC2, 8);
+	put(f, bank, 2);
+	put(f, ptr & 0x7F, 8);
+	put(f, count, 8);
+	put(f, handle, 16);
+	put_crc16(f);
+}
+
+// Mask of up to 32 bits at bit Pointer, Truncate off
+void frame_select(frame_t* f, uint8_t target, uint8_t action, uint8_t bank, uint16_t ptr,
+		uint8_t len, uint32_t mask) {
+	f->len = 0;
+	f->query = 0;
+	f->crc = 1;
+	f->code_len = 4;
+	put(f, 0xA, 4);
+	put(f, target, 3);
+	put(f, action, 3);
+	put(f, bank, 2);
+	put_ebv(f, ptr);
+	put(f, len, 8);
+	put(f, mask, len);
+	put(f, 0, 1);
+	put_crc16(f);
+}
+
+/**************************************************************************
+   PIE SECTION
+ **************************************************************************/
+// Every symbol ends in a low pulse, so a rising edge closes the delimiter,
+// data-0, RTcal, TRcal and each data symbol. Sends the frame from now and
+// returns the time of the last edge. With bit_errors some data symbols go
+// out as the other one, counted in f->flips
+double reader_send(frame_t* f) {
+	double t = sim_time + cfg.delim;
+	double last = sim_time;
+	double pw = cfg.tari / 2;					// Gen2 allows 0.265 to 0.525 Tari
+	unsigned i;
+	int n = f->len + (f->query ? 4 : 3);
+
+	f->flips = 0;
+	for(i = 0; i < n; i++) {
+		double edge = t + cfg.jitter * gauss();
+		if(edge < last) {
+			edge = last;
+		}
+		double fall = edge - (i == 0 ? cfg.delim : pw);
+		tags_fall(fall > last ? fall : last);
+		tags_edge(edge);
+		last = edge;
+
+		if(i == 0) {
+			t += cfg.tari;							// data-0
+		}
+		else if(i == 1) {
+			t += cfg.rtcal;
+		}
+		else if(i == 2 && f->query) {
+			t += cfg.trcal;
+		}
+		else if(i + 1 < n) {						// Nothing follows the last edge
+			unsigned b = i - (f->query ? 3 : 2);
+			uint8_t bit = f->bits[b];
+			if(cfg.bit_errors > 0 && reader_rand() < cfg.bit_errors) {
+				bit ^= 1;
+				if(f->flips++ == 0) {
+					f->first_flip = b;
+				}
+			}
+			t += bit ? cfg.data1 : cfg.tari;
+		}
+	}
+	return last;
+}
+
+/**************************************************************************
+   MILLER SECTION
+ **************************************************************************/
+// Level of SPI bit h
+static int level_at(const reply_t* r, unsigned h) {
+	return (r->data[h / 8] >> (h % 8)) & 0x01;
+}
+
+// Half bit h: its phase, -1 for anything else, -2 for no subcarrier at all
+static int half_at(const reply_t* r, unsigned h) {
+	unsigned pos = h * cfg.m;
+	uint8_t mask = (1 << cfg.m) - 1;
+	uint8_t chips = (r->data[pos / 8] >> (pos % 8)) & mask;
+
+	if(chips == (MILLER_HALF_0 & mask)) {
+		return 0;
+	}
+	if(chips == (MILLER_HALF_1 & mask)) {
+		return 1;
+	}
+	return chips ? -1 : -2;
+}
+
+// FM0, one level per half bit: it inverts at every bit boundary and again
+// in the middle of a '0'. The pilot (TRext = 1 only) and preamble must match
+// Gen2 figure 6.11 in either polarity, and what follows the dummy '1' is
+// padding. Returns len or -1
+static int fm0_decode(const reply_t* r, uint8_t* bits, int len) {
+	static const char pilot_header[] = "101010101010101010101010" "110100100011";
+	const char* header = cfg.trext ? pilot_header : pilot_header + 24;
+	unsigned hdr = strlen(header);
+	unsigned halves = hdr + 2 * (len + 1);
+	unsigned h;
+	int i;
+
+	if(r->bits < halves || r->bits - halves >= 8) {
+		return -1;
+	}
+	int flip = level_at(r, 0) ^ 1;
+	for(h = 0; h < hdr; h++) {
+		if((level_at(r, h) ^ flip) != header[h] - '0') {
+			return -1;
+		}
+	}
+
+	int level = level_at(r, hdr - 1);
+	for(i = 0; i <= len; i++) {
+		int first = level_at(r, hdr + 2 * i);
+		int second = level_at(r, hdr + 2 * i + 1);
+		int bit = first == second;
+
+		if(first == level) {						// No flip at the boundary
+			return -1;
+		}
+		if(i == len && !bit) {						// Dummy '1'
+			return -1;
+		}
+		bits[i] = bit;
+		level = second;
+	}
+	for(h = halves; h < r->bits; h++) {
+		if(level_at(r, h)) {
+			return -1;
+		}
+	}
+	return len;
+}
+
+// Each half bit is M subcarrier bits, 0xAA or 0x55 LSB first cut to M. A
+// data bit is '1' if its halves differ. Between two '0's the phase
+// inverts, otherwise it carries on. A reply that ends mid byte is padded
+// with no subcarrier. FM0 is M = 1 here. Returns the len data bits after
+// the preamble, EOS dropped, or -1 if the reply is anything else. bits
+// needs room for the EOS
+int reader_decode(const reply_t* r, uint8_t* bits, int len) {
+	unsigned halves = r->bits / cfg.m;
+	unsigned pilot = cfg.trext ? PILOT_HALVES : PILOT_SHORT;
+	unsigned h;
+	int n = 0;
+	int prev = 1;
+	int phase = -1;
+
+	if(cfg.m == 1) {
+		return fm0_decode(r, bits, len);
+	}
+
+	if(halves >= 2 && half_at(r, halves - 1) == -2 && half_at(r, halves - 2) == -2) {
+		halves -= 2;
+	}
+	if(r->bits % 8 || halves < pilot || (halves - pilot) % 2) {
+		return -1;
+	}
+	for(h = 0; h < halves; h++) {
+		if(half_at(r, h) < 0) {
+			return -1;
+		}
+	}
+
+	for(h = pilot; h < halves; h += 2) {
+		int first = half_at(r, h);
+		int second = half_at(r, h + 1);
+		int bit = first != second;
+
+		if(phase >= 0 && first != (phase ^ (!prev && !bit))) {
+			return -1;
+		}
+		phase = second;
+		prev = bit;
+
+		if(n < PREAMBLE_LEN) {
+			if(bit != ((PREAMBLE >> (PREAMBLE_LEN - 1 - n)) & 0x01)) {
+				return -1;
+			}
+			n++;
+			continue;
+		}
+		if(n - PREAMBLE_LEN > len) {
+			return -1;
+		}
+		bits[n - PREAMBLE_LEN] = bit;
+		n++;
+	}
+
+	n -= PREAMBLE_LEN;
+	if(n != len + 1 || bits[len] != 1) {		// EOS
+		return -1;
+	}
+	return len;
+}
@@ -0,0 +1,500 @@
+/*
+ * Register model for the parts of the MSP430FR5738 the tag firmware uses:
+ * Timer_B0 capture/compare on SMCLK/4, Timer_A0 CCR1 on ACLK, eUSCI_A0 as
+ * an SPI master fed by DMA0, the RX_PIN port interrupt, and ADC10_B for the
+ * RNG seed. Everything
+ * else reads back what was written. Time only moves when the reader asks
+ * for it; ISRs take no time, but waking from LPM3/4 does. Built with
+ * TX_BITBANG, the transmit loop in TIMER_B1 takes the time of its
+ * instructions instead, BB_* in tagsim.h
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "msp430.h"
+#include "tagsim.h"
+
+volatile uint16_t WDTCTL;
+volatile uint8_t CSCTL0_H;
+volatile uint16_t CSCTL1, CSCTL2, CSCTL3;
+volatile uint16_t PJDIR, PJOUT, PJREN;
+volatile uint16_t P1DIR, P1OUT, P1REN;
+volatile uint16_t P2DIR, P2OUT, P2REN, P2SEL0, P2SEL1, P2IES, P2IE, P2IFG;
+volatile uint16_t TB0CTL, TB0CCTL0, TB0CCTL1, TB0CCR0, TB0CCR1;
+volatile uint16_t TA0CTL, TA0CCTL1, TA0CCR1, TA0IV;
+volatile uint16_t UCA0CTLW0, UCA0BRW, UCA0STATW, UCA0TXBUF, UCA0IE;
+volatile uint16_t DMACTL0, DMA0CTL, DMA0SA, DMA0DA, DMA0SZ, DMAIV;
+volatile uint16_t ADC10CTL0, ADC10CTL1, ADC10CTL2, ADC10MCTL0, REFCTL0;
+
+double sim_time;
+periph_stats_t periph_stats;
+
+static double smclk_hz;
+static double tb0_base;				// Time TB0R was last cleared
+static double tb0_tick;				// Seconds per TB0 count
+static double aclk_hz;
+static double ta0_count;			// ACLK counts since TACLR
+static double ta0_at;				// Time ta0_count is up to
+
+static const char* dma_src;			// Host pointers behind DMA0SA and DMA0DA
+static const volatile void* dma_dst;
+
+static bool tx_active;
+static double tx_dma;				// DMA0 moves the last byte into UCA0TXBUF
+static double tx_end;
+static reply_t tx;
+static bool tx_ready;				// tx holds a reply not yet collected
+
+static uint16_t adc_noise = 0xACE1;
+
+static uint16_t sr;					// Status register bits main() sleeps with
+static bool rx_high;				// Envelope detector output
+static double wake_time;			// LPM3/4 exit
+static double wake_at;				// Pending wake from LPM3/4
+static double deep_since;			// Start of the current LPM3/4 stretch, or -1
+
+#ifdef TX_BITBANG
+static bool bb_isr;					// In TIMER_B1
+static bool bb_active;				// Loop running, bb_bits bodies so far
+static bool bb_nop;					// Last TB0R read was still waiting
+static double bb_read;				// Time of the last TB0R read
+static unsigned bb_bits;
+static double bb_edge[REPLY_MAX + 1];	// P2OUT write for each bit
+#endif
+
+// id picks the ADC noise, so tags seed their RNGs apart
+void periph_reset(double dco_error, double wake, double aclk, unsigned id) {
+	sim_time = 0;
+	smclk_hz = SMCLK_HZ * (1 + dco_error);
+	tb0_tick = TB0_DIV / smclk_hz;
+	tb0_base = 0;
+	aclk_hz = aclk;
+	ta0_count = 0;
+	ta0_at = 0;
+	adc_noise = 0xACE1 ^ (id * 0x1021);
+	if(adc_noise == 0) {
+		adc_noise = 1;
+	}
+	tx_active = 0;
+	tx_ready = 0;
+#ifdef TX_BITBANG
+	bb_isr = 0;
+	bb_active = 0;
+#endif
+	sr = 0;
+	rx_high = 1;						// Carrier on
+	wake_time = wake;
+	wake_at = INFINITY;
+	deep_since = -1;
+	memset(&periph_stats, 0, sizeof(periph_stats));
+}
+
+/**************************************************************************
+   REGISTER SECTION
+ **************************************************************************/
+static bool tb0_running(void) {
+	return (TB0CTL & MC_3) != MC_0;
+}
+
+// TBCLR is only seen here, so apply it before the counter is looked at. A
+// stopped timer reads 0, the firmware always clears it when it starts again
+static void tb0_sync(void) {
+	if((TB0CTL & TBCLR) || !tb0_running()) {
+		TB0CTL &= ~TBCLR;
+		tb0_base = sim_time;
+	}
+}
+
+static double tb0_counts(void) {
+	tb0_sync();
+	return (sim_time - tb0_base) / tb0_tick + 1e-6;
+}
+
+// ACLK stops in LPM4 (OSCOFF)
+static bool ta0_running(void) {
+	return (TA0CTL & TASSEL_1) && (TA0CTL & MC_3) != MC_0 && !(sr & OSCOFF);
+}
+
+// Bring the count up to now, before TA0 or the status register changes
+static void ta0_sync(void) {
+	if(TA0CTL & TACLR) {
+		TA0CTL &= ~TACLR;
+		ta0_count = 0;
+	}
+	else if(ta0_running()) {
+		ta0_count += (sim_time - ta0_at) * aclk_hz;
+	}
+	ta0_at = sim_time;
+}
+
+uint16_t sim_ta0r(void) {
+	ta0_sync();
+	return (uint16_t)(uint64_t)(ta0_count + 1e-6);
+}
+
+#ifdef TX_BITBANG
+static void bb_poll(void);
+#endif
+
+uint16_t sim_tb0r(void) {
+#ifdef TX_BITBANG
+	if(bb_isr && TB0CCTL1 == 0) {	// Only the transmit loop reads it like this
+		bb_poll();
+	}
+#endif
+	return (uint16_t)(uint64_t) tb0_counts();
+}
+
+// The wait in the transmit loop goes round once more
+void sim_nop(void) {
+#ifdef TX_BITBANG
+	bb_nop = 1;
+#endif
+}
+
+// DMA addresses are 20 bits on the part. On the host they are pointers, kept
+// aside and matched against the register they were written to
+void sim_write_addr(uintptr_t addr, uintptr_t val) {
+	if(addr == (uintptr_t)(uint16_t)(uintptr_t) &DMA0SA) {
+		dma_src = (const char*) val;
+	}
+	else if(addr == (uintptr_t)(uint16_t)(uintptr_t) &DMA0DA) {
+		dma_dst = (const volatile void*) val;
+	}
+}
+
+// LPM bits set by main() and changed by the ISRs on the way out
+void sim_sr_bis(uint16_t bits) {
+	ta0_sync();
+	sr |= bits;
+}
+
+void sim_sr_bic(uint16_t bits) {
+	ta0_sync();
+	sr &= ~bits;
+}
+
+uint16_t sim_p2in(void) {
+	return rx_high ? RX_BIT : 0;
+}
+
+// Temperature sensor noise, for rng_seed()
+uint16_t sim_adc(void) {
+	adc_noise = (adc_noise >> 1) ^ (-(adc_noise & 1) & 0xB400);
+	return 0x180 + (adc_noise & 0x0F);
+}
+
+/**************************************************************************
+   EVENT SECTION
+ **************************************************************************/
+// Next time TB0R reaches TB0CCR1 with the compare interrupt armed
+static double compare_time(void) {
+	if(!tb0_running() || !(TB0CCTL1 & CCIE) || (TB0CCTL1 & CAP) || (TB0CCTL1 & CCIFG)) {
+		return INFINITY;
+	}
+	double counts = tb0_counts();
+	uint64_t now = (uint64_t) counts;
+	uint32_t ahead = (uint16_t)(TB0CCR1 - (uint16_t) now);
+	if(ahead == 0) {
+		ahead = 0x10000;				// Just passed, next time round
+	}
+	return tb0_base + (now + ahead) * tb0_tick;
+}
+
+// Next time TA0R reaches TA0CCR1 with the interrupt armed
+static double ta0_compare_time(void) {
+	if(!ta0_running() || !(TA0CCTL1 & CCIE) || (TA0CCTL1 & CCIFG)) {
+		return INFINITY;
+	}
+	ta0_sync();
+	uint64_t now = (uint64_t)(ta0_count + 1e-6);
+	uint32_t ahead = (uint16_t)(TA0CCR1 - (uint16_t) now);
+	if(ahead == 0) {
+		ahead = 0x10000;
+	}
+	return sim_time + (now + ahead - ta0_count) / aclk_hz;
+}
+
+// Releasing UCSWRST with DMA0 armed on UCA0TXIFG starts a reply
+static void tx_check(void) {
+	if(tx_active || (UCA0CTLW0 & UCSWRST) || !(DMA0CTL & DMAEN) ||
+			(DMACTL0 & 0x1F) != DMA0TSEL_15 || dma_dst != &UCA0TXBUF) {
+		return;
+	}
+	unsigned len = DMA0SZ;
+	if(len * 8 > REPLY_MAX) {
+		len = REPLY_MAX / 8;
+	}
+	tx.start = sim_time;
+	tx.bit_time = (UCA0BRW ? UCA0BRW : 1) / smclk_hz;
+	tx.bits = len * 8;
+	tx.bit_min = tx.bit_max = tx.bit_time;	// The SPI clock is the only clock
+	tx.edge_dev = 0;
+	memcpy(tx.data, dma_src, len);
+	tx_dma = sim_time + (len > 2 ? len - 2 : 0) * 8 * tx.bit_time;
+	tx_end = sim_time + tx.bits * tx.bit_time;
+	tx_active = 1;
+	UCA0STATW |= UCBUSY;
+}
+
+// The last byte goes into UCA0TXBUF as the one before it starts shifting
+// out, two bytes before the end
+static void tx_dma_done(void) {
+	tx_dma = INFINITY;
+	DMA0SZ = 0;
+	DMA0CTL = (DMA0CTL & ~DMAEN) | DMAIFG;
+}
+
+// Last bit out
+static void tx_finish(void) {
+	tx_active = 0;
+	tx_ready = 1;
+	periph_stats.replies++;
+	UCA0STATW &= ~UCBUSY;
+}
+
+#ifdef TX_BITBANG
+// Every TB0R read in the transmit loop. Reads that found the time not yet
+// up went round the wait once, otherwise the next bit was written on the
+// way here. Bit 0 is written before the first read
+static void bb_poll(void) {
+	double cycle = 1 / smclk_hz;
+	double top;
+
+	if(!bb_active) {
+		bb_active = 1;
+		bb_bits = 0;
+		top = sim_time + BB_ENTRY_CYCLES * cycle;
+	}
+	else if(bb_nop) {
+		sim_time = bb_read + BB_POLL_CYCLES * cycle;
+		top = -1;
+	}
+	else {
+		top = bb_read + BB_EXIT_CYCLES * cycle;
+	}
+
+	if(top >= 0 && bb_bits < REPLY_MAX) {
+		unsigned shift = BB_SHIFT_CYCLES * (bb_bits % 8);
+		bb_edge[bb_bits] = top + (BB_EDGE_CYCLES + shift) * cycle;
+		if(bb_bits % 8 == 0) {
+			tx.data[bb_bits / 8] = 0;
+		}
+		if(P2OUT & TX_BIT) {
+			tx.data[bb_bits / 8] |= 1 << (bb_bits % 8);
+		}
+		bb_bits++;
+		sim_time = top + (BB_BODY_CYCLES + shift) * cycle;
+	}
+	bb_read = sim_time;
+	bb_nop = 0;
+}
+
+// Loop done, the last read found the last bit's time up. Bit lengths, and
+// transitions against the even grid that fits the bit starts best
+static void bb_finish(void) {
+	bb_active = 0;
+	bb_edge[bb_bits] = bb_read + BB_EXIT_CYCLES / smclk_hz;
+
+	double sk = 0, st = 0, skk = 0, skt = 0;
+	unsigned k;
+	for(k = 0; k < bb_bits; k++) {
+		double t = bb_edge[k] - bb_edge[0];
+		sk += k;
+		st += t;
+		skk += (double) k * k;
+		skt += k * t;
+	}
+	double n = bb_bits;
+	double slope = bb_bits > 1 ? (n * skt - sk * st) / (n * skk - sk * sk) : 0;
+	double offset = bb_edge[0] + (st - slope * sk) / n;
+
+	tx.start = bb_edge[0];
+	tx.bits = bb_bits;
+	tx.bit_time = (bb_edge[bb_bits] - tx.start) / bb_bits;
+	tx.bit_min = INFINITY;
+	tx.bit_max = 0;
+	tx.edge_dev = 0;
+	for(k = 0; k < bb_bits; k++) {
+		if(k + 1 < bb_bits) {			// The loop leaves TX_PIN as the last bit left it
+			double len = bb_edge[k + 1] - bb_edge[k];
+			tx.bit_min = fmin(tx.bit_min, len);
+			tx.bit_max = fmax(tx.bit_max, len);
+		}
+		bool now = (tx.data[k / 8] >> (k % 8)) & 1;
+		bool before = k ? (tx.data[(k - 1) / 8] >> ((k - 1) % 8)) & 1 : 0;
+		if(now != before) {
+			tx.edge_dev = fmax(tx.edge_dev, fabs(bb_edge[k] - (offset + k * slope)));
+		}
+	}
+	tx_ready = 1;
+	periph_stats.replies++;
+}
+#endif
+
+// LPM3/4 time, from the first ISR that leaves SCG1 set to the edge that
+// starts the wake
+static void deep_track(void) {
+	if((sr & SCG1) && deep_since < 0) {
+		deep_since = sim_time;
+		periph_stats.sleeps++;
+	}
+}
+
+static void deep_end(void) {
+	if(deep_since >= 0) {
+		periph_stats.deep += sim_time - deep_since;
+		deep_since = -1;
+	}
+}
+
+// Run pending ISRs in priority order until the CPU would go back to LPM
+static void dispatch(void) {
+	int n;
+	for(n = 0; n < STORM_LIMIT; n++) {
+		tb0_sync();
+		if((TB0CCTL0 & (CCIE | CCIFG)) == (CCIE | CCIFG)) {
+			periph_stats.timer_b++;
+			TIMER_B();
+		}
+		else if((TB0CCTL1 & (CCIE | CCIFG)) == (CCIE | CCIFG)) {
+			periph_stats.timer_b1++;
+			periph_stats.tx_ends += !(UCA0CTLW0 & UCSWRST);
+#ifdef TX_BITBANG
+			bb_isr = 1;
+			TIMER_B1();
+			bb_isr = 0;
+			if(bb_active) {
+				bb_finish();
+			}
+#else
+			TIMER_B1();
+#endif
+		}
+		else if((TA0CCTL1 & (CCIE | CCIFG)) == (CCIE | CCIFG)) {
+			periph_stats.timer_a0++;
+			TA0CCTL1 &= ~CCIFG;				// Reading TA0IV clears it
+			TA0IV = 2;
+			TIMERA0_IV_ISR();
+			TA0IV = 0;
+		}
+		else if((DMA0CTL & (DMAIE | DMAIFG)) == (DMAIE | DMAIFG)) {
+			periph_stats.dma++;
+			DMA0CTL &= ~DMAIFG;				// Reading DMAIV clears it
+			DMAIV = 2;
+			DMA_ISR();
+			DMAIV = 0;
+		}
+		else if(P2IE & P2IFG & RX_BIT) {
+			periph_stats.port2++;
+			PORT2_ISR();
+		}
+		else {
+			tx_check();
+			deep_track();
+			return;
+		}
+		tx_check();
+	}
+
+	// A flag nobody clears, drop it so the run can go on
+	periph_stats.storms++;
+	TB0CCTL0 &= ~CCIFG;
+	TB0CCTL1 &= ~CCIFG;
+	TA0CCTL1 &= ~CCIFG;
+	DMA0CTL &= ~DMAIFG;
+	P2IFG &= ~RX_BIT;
+	deep_track();
+}
+
+void periph_run_to(double t) {
+	while(1) {
+		double tc = compare_time();
+		double ta = ta0_compare_time();
+		double td = tx_active ? fmin(tx_dma, tx_end) : INFINITY;
+		double next = fmin(fmin(tc, ta), td);
+		if(wake_at < next) {
+			next = wake_at;
+		}
+		if(next > t) {
+			break;
+		}
+		sim_time = next;
+		if(next == wake_at) {
+			wake_at = INFINITY;
+		}
+		else if(tc < td && tc <= ta) {
+			TB0CCTL1 |= CCIFG;
+		}
+		else if(ta < td) {
+			TA0CCTL1 |= CCIFG;
+		}
+		else if(tx_dma <= tx_end) {
+			tx_dma_done();
+		}
+		else {
+			tx_finish();
+		}
+		dispatch();
+	}
+	if(sim_time < t) {					// A bit-banged reply may have run past t
+		sim_time = t;
+	}
+}
+
+// Rising edge from the envelope detector on RX_PIN: a TB0.CCI0A capture
+// while the pin is routed to the timer, otherwise the port interrupt. From
+// LPM3/4 that ISR runs wake_time later, and edges meanwhile are lost
+void periph_edge(double t) {
+	periph_run_to(t);
+	rx_high = 1;
+	if((P2SEL0 & P2SEL1 & RX_BIT) && tb0_running() && (TB0CCTL0 & CAP) && (TB0CCTL0 & CM_1)) {
+		if(TB0CCTL0 & CCIFG) {
+			periph_stats.overruns++;
+		}
+		TB0CCR0 = sim_tb0r();
+		TB0CCTL0 |= CCIFG;
+		dispatch();
+	}
+	else if(!(P2SEL0 & RX_BIT) && !(P2SEL1 & RX_BIT) && !(P2IES & RX_BIT) &&
+			(P2IE & RX_BIT) && !(P2IFG & RX_BIT)) {
+		P2IFG |= RX_BIT;
+		if(sr & SCG1) {
+			deep_end();
+			periph_stats.wakes++;
+			wake_at = t + wake_time;
+		}
+		else {
+			dispatch();
+		}
+	}
+	else {
+		periph_stats.missed++;
+	}
+}
+
+// Start of a PIE low pulse, or the carrier going off
+void periph_fall(double t) {
+	periph_run_to(t);
+	rx_high = 0;
+}
+
+// Seconds spent in LPM3/4 so far
+double periph_deep(void) {
+	return periph_stats.deep + (deep_since >= 0 ? sim_time - deep_since : 0);
+}
+
+bool periph_busy(void) {
+	return tx_active;
+}
+
+// Collect the reply that finished since the last call
+bool periph_reply(reply_t* r) {
+	if(!tx_ready) {
+		return 0;
+	}
+	memcpy(r, &tx, sizeof(tx));
+	tx_ready = 0;
+	return 1;
+}
@@ -0,0 +1,181 @@
+/*
+ * Several tags against one reader. The Makefile links the firmware and
+ * tag_periph.c into one object with their data and bss renamed tag_data and
+ * tag_bss, so the whole state of a tag, registers and sim_time included, is
+ * those two sections. Each tag keeps a copy and tag_use() swaps it in. With
+ * one tag nothing is ever swapped
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tagsim.h"
+
+extern char __start_tag_data[], __stop_tag_data[];
+extern char __start_tag_bss[], __stop_tag_bss[];
+
+static unsigned tag_n = 1;
+static unsigned tag_in;				// Whose state is in the sections now
+static char* tag_state[TAGS_MAX];
+
+static size_t data_len(void) {
+	return __stop_tag_data - __start_tag_data;
+}
+
+static size_t bss_len(void) {
+	return __stop_tag_bss - __start_tag_bss;
+}
+
+void tag_use(unsigned k) {
+	if(k == tag_in) {
+		return;
+	}
+	memcpy(tag_state[tag_in], __start_tag_data, data_len());
+	memcpy(tag_state[tag_in] + data_len(), __start_tag_bss, bss_len());
+	memcpy(__start_tag_data, tag_state[k], data_len());
+	memcpy(__start_tag_bss, tag_state[k] + data_len(), bss_len());
+	tag_in = k;
+}
+
+// n tags, each booted from the same clean state. DCO errors are spread
+// evenly over dco_spread around dco_error
+void tags_reset(unsigned n, double dco_error, double dco_spread, double wake, double aclk) {
+	static char* clean;
+	unsigned k;
+
+	if(n < 1 || n > TAGS_MAX) {
+		fprintf(stderr, "tagsim: 1 to %u tags\n", TAGS_MAX);
+		exit(2);
+	}
+	clean = malloc(data_len() + bss_len());
+	memcpy(clean, __start_tag_data, data_len());
+	memcpy(clean + data_len(), __start_tag_bss, bss_len());
+	for(k = 0; k < n; k++) {
+		tag_state[k] = malloc(data_len() + bss_len());
+		memcpy(tag_state[k], clean, data_len() + bss_len());
+	}
+	tag_n = n;
+	tag_in = 0;
+	for(k = 0; k < n; k++) {
+		double offset = n > 1 ? dco_spread * ((double) k / (n - 1) - 0.5) : 0;
+		tag_use(k);
+		periph_reset(dco_error + offset, wake, aclk, k);
+		tag_main();
+	}
+	tag_use(0);
+	free(clean);
+}
+
+// The TX_BITBANG loop runs in TIMER_B1, so a tag sending a reply comes
+// back past the time asked for, as one tag alone does. Bring the others up
+// to it, until a pass leaves every tag at the same time
+static void tags_sync(void) {
+	unsigned k;
+	bool again;
+	double t;
+
+	do {
+		t = 0;
+		for(k = 0; k < tag_n; k++) {
+			tag_use(k);
+			if(sim_time > t) {
+				t = sim_time;
+			}
+		}
+		again = 0;
+		for(k = 0; k < tag_n; k++) {
+			tag_use(k);
+			if(sim_time < t) {
+				periph_run_to(t);
+				again |= sim_time > t;
+			}
+		}
+	} while(again);
+}
+
+unsigned tags_count(void) {
+	return tag_n;
+}
+
+void tags_run_to(double t) {
+	unsigned k;
+	for(k = 0; k < tag_n; k++) {
+		tag_use(k);
+		periph_run_to(t);
+	}
+	tags_sync();
+}
+
+void tags_edge(double t) {
+	unsigned k;
+	for(k = 0; k < tag_n; k++) {
+		tag_use(k);
+		periph_edge(t);
+	}
+	tags_sync();
+}
+
+void tags_fall(double t) {
+	unsigned k;
+	for(k = 0; k < tag_n; k++) {
+		tag_use(k);
+		periph_fall(t);
+	}
+	tags_sync();
+}
+
+bool tags_busy(void) {
+	unsigned k;
+	for(k = 0; k < tag_n; k++) {
+		tag_use(k);
+		if(periph_busy()) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Collect every reply that finished since the last call. Returns how many
+// there were, the first in r and from. Any two of them overlap at the reader
+unsigned tags_reply(reply_t* r, unsigned* from) {
+	static reply_t other;
+	unsigned count = 0;
+	unsigned k;
+	for(k = 0; k < tag_n; k++) {
+		tag_use(k);
+		if(periph_reply(count ? &other : r)) {
+			if(count++ == 0) {
+				*from = k;
+			}
+		}
+	}
+	return count;
+}
+
+// Counters over every tag. deep is LPM3/4 time per tag, the stretch under
+// way included, and busy the tags still replying
+void tags_stats(periph_stats_t* total, double* deep, unsigned* busy) {
+	unsigned k;
+	memset(total, 0, sizeof(*total));
+	*deep = 0;
+	*busy = 0;
+	for(k = 0; k < tag_n; k++) {
+		tag_use(k);
+		total->timer_b += periph_stats.timer_b;
+		total->timer_b1 += periph_stats.timer_b1;
+		total->timer_a0 += periph_stats.timer_a0;
+		total->dma += periph_stats.dma;
+		total->replies += periph_stats.replies;
+		total->tx_ends += periph_stats.tx_ends;
+		total->storms += periph_stats.storms;
+		total->overruns += periph_stats.overruns;
+		total->port2 += periph_stats.port2;
+		total->sleeps += periph_stats.sleeps;
+		total->wakes += periph_stats.wakes;
+		total->missed += periph_stats.missed;
+		total->deep += periph_stats.deep;
+		*deep += periph_deep() / tag_n;
+		*busy += periph_busy();
+	}
+}
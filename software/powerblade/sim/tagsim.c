@@ -0,0 +1,921 @@
+/*
+ * tagsim - run the PowerBlade Gen2 tag firmware against a simulated reader
+ *
+ * main.c, gen2.c, miller.c and rng.c are built for the host against
+ * msp430.h in this directory. The reader sends PIE commands as edges on
+ * the Timer_B0 capture input, with Gaussian jitter, and decodes the Miller
+ * replies the firmware shifts out through eUSCI_A0 and DMA0. It runs Q
+ * rounds of Query/QueryRep, optionally each after a Select and with the
+ * Q algorithm's QueryAdjusts, ACKs every RN16, NAKs a lost EPC and
+ * optionally reads the EPC bank back. With --tags it runs several copies
+ * of the firmware at once (tags.c). Reports EPC reads per second and the
+ * T1 turnaround, and exits non-zero when an expectation fails.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen2.h"
+#include "meter.h"
+#include "tagsim.h"
+
+#define REPLY_BITS		256			// Longest decoded reply and its EOS
+#define T3				20e-6		// Extra wait after an empty slot
+#define TS				1.5e-3		// CW after the carrier comes on, before the first command
+#define EPC_BANK_WORDS	(1 + EPC_LEN / 16)	// StoredCRC, PC and EPC
+
+typedef struct {
+	bool set;
+	double lo, hi;
+} range_t;
+
+typedef struct {
+	uint64_t count;
+	double total, min, max;
+} span_t;
+
+typedef enum {
+	slot_empty,
+	slot_reply,						// One RN16, read or not
+	slot_collided					// Nothing decodable, as far as the reader knows two tags or more
+} slot_t;
+
+static reader_cfg_t cfg = {
+	.tari = 25e-6,
+	.data1 = 50e-6,
+	.rtcal = 75e-6,
+	.trcal = 106.7e-6,				// DR = 64/3, BLF = 200kHz
+	.delim = 12.5e-6,
+	.dr = 1,
+	.m = 8,
+	.trext = 1,
+};
+static double t1_tol = 0.1;			// BLF tolerance, around nominal T1 and BLF
+static double t1_nominal, t1_max;
+static double blf_nominal;
+static double t2;					// Reader CW after a reply, 10 Tpri
+static uint8_t q_start = 0;
+static double q_adapt;				// Q algorithm step C, 0 for a fixed Q
+static uint8_t session = 0;
+static uint8_t read_words;
+static bool read_bank;
+static bool req_rn_again;
+static bool read_user;
+static double meter_period = 0.1;	// New record from the measurement side
+static double round_gap;			// CW between rounds, tag timeout runs out
+static double carrier_off;			// No carrier between rounds, then TS of CW
+static double off_total;
+static uint8_t m_later;				// M to switch to halfway through
+static bool no_flip;				// Stay on target A
+static bool select_on;				// Select before every Query
+static uint8_t select_target = SEL_TARGET_SL;
+static uint8_t select_action;
+static uint8_t select_bank;
+static uint16_t select_ptr;			// Bits
+static uint32_t select_mask;			// 16 bits
+static bool verbose;
+
+static uint64_t sent_select, sent_query, sent_adjust, sent_rep, sent_ack, sent_nak, sent_req_rn, sent_read;
+static uint64_t got_rn16, got_epc, got_handle, got_read;
+static uint64_t decode_errors, crc_errors, early, late, lost_epc, bad_reads;
+static uint64_t corrupted, corrupted_crc, wasted, select_replies, collisions;
+static unsigned reply_from;			// Tag that sent the last reply
+static uint64_t tag_epcs[TAGS_MAX];
+static uint64_t reads, user_reads;
+static span_t t1;
+static span_t blf;
+static span_t tx_bit;				// Subcarrier bit lengths, shortest and longest of each reply
+static span_t read_gap;				// Between one EPC and the next
+static double last_read = -1;
+static double tx_edge_dev;			// Furthest transition from an even grid
+
+static uint32_t meter_seq;
+static double meter_next;
+static double meter_fed[256];		// By the low byte of the sequence
+static long meter_seen = -1;
+static uint64_t bad_records;
+static span_t meter_age;			// Record fed to first EPC carrying it
+
+static bool failed;
+
+static void fail(const char* fmt, const char* what, double a, double b) {
+	printf("FAIL: ");
+	printf(fmt, what, a, b);
+	printf("\n");
+	failed = 1;
+}
+
+static void span_add(span_t* s, double v) {
+	if(s->count == 0 || v < s->min) {
+		s->min = v;
+	}
+	if(s->count == 0 || v > s->max) {
+		s->max = v;
+	}
+	s->total += v;
+	s->count++;
+}
+
+/**************************************************************************
+   LINK SECTION
+ **************************************************************************/
+// A reply that started after the reader stopped listening. It still blocks
+// the next command, the tag does not capture while it transmits
+static void drain_late(void) {
+	static reply_t r;
+	unsigned from;
+	if(!tags_busy()) {
+		return;
+	}
+	late++;
+	while(tags_busy()) {
+		tags_run_to(sim_time + 100e-6);
+	}
+	tags_reply(&r, &from);
+	tags_run_to(sim_time + t2);
+}
+
+// Send a command and listen until T1 max for a reply of len data bits.
+// Returns len, 0 for no reply, -1 for a reply that did not decode or
+// replies from more than one tag
+static int exchange(frame_t* f, uint8_t* bits, int len) {
+	static reply_t r;
+	unsigned count;
+
+	drain_late();
+	double last = reader_send(f);
+	if(f->flips) {
+		corrupted++;
+		corrupted_crc += f->crc && f->first_flip >= f->code_len;
+	}
+	tags_run_to(last + t1_max);
+	while(tags_busy()) {
+		tags_run_to(sim_time + 100e-6);
+	}
+	count = tags_reply(&r, &reply_from);
+	if(count == 0) {
+		tags_run_to(sim_time + T3);
+		drain_late();
+		return 0;
+	}
+	if(f->flips && f->crc && f->first_flip >= f->code_len) {
+		wasted++;						// Should have failed its CRC
+	}
+	tags_run_to(sim_time + t2);
+	if(count > 1) {
+		collisions++;
+		return -1;
+	}
+	if(r.start < last) {
+		early++;						// Tag took part of the command for a whole one
+		return -1;
+	}
+	span_add(&t1, r.start - last);
+	span_add(&blf, 1 / (2 * r.bit_time));
+	span_add(&tx_bit, r.bit_min);
+	span_add(&tx_bit, r.bit_max);
+	tx_edge_dev = fmax(tx_edge_dev, r.edge_dev);
+
+	int n = reader_decode(&r, bits, len);
+	if(n < 0) {
+		decode_errors++;
+		if(verbose) {
+			printf("%10.6f undecodable reply, %u subcarrier bits\n", r.start, r.bits);
+		}
+	}
+	return n;
+}
+
+// Data bits followed by a CRC-16 over them
+static bool crc_ok(const uint8_t* bits, int len) {
+	if(len < 16 || bits_crc16(bits, len - 16) != bits_value(bits + len - 16, 16)) {
+		crc_errors++;
+		return 0;
+	}
+	return 1;
+}
+
+/**************************************************************************
+   METERING SECTION
+ **************************************************************************/
+// Record number seq as the measurement side would hand it over. Zero is
+// the empty record the tag boots with
+static void meter_gen(uint32_t seq, meter_t* m) {
+	memset(m, 0, sizeof(*m));
+	if(seq == 0) {
+		return;
+	}
+	m->sequence = seq;
+	m->scale = 0x4E2A0000 | (seq & 0xFFFF);
+	m->vrms = 118 + seq % 5;
+	m->flags = seq & 0x03;
+	m->true_power = 600 + (seq * 37) % 900;
+	m->apparent_power = m->true_power + 40;
+	m->watt_hours = 100000 + seq * 13;
+}
+
+// Hand the tag a new record every meter_period, between commands
+static void meter_feed(void) {
+	meter_t m;
+	if(meter_period <= 0 || sim_time < meter_next) {
+		return;
+	}
+	meter_gen(++meter_seq, &m);
+	unsigned k;
+	for(k = 0; k < tags_count(); k++) {
+		tag_use(k);
+		meter_set(&m);
+	}
+	meter_fed[meter_seq & 0xFF] = sim_time;
+	meter_next += meter_period;
+}
+
+// Latest record fed whose sequence ends in seq8, -1 if none
+static long meter_find(uint8_t seq8) {
+	long seq;
+	for(seq = meter_seq; seq >= 0 && seq + 256 > meter_seq; seq--) {
+		if((seq & 0xFF) == seq8) {
+			return seq;
+		}
+	}
+	return -1;
+}
+
+// PC, marker, then the record tail. Returns the sequence it carries
+static long check_epc(const uint8_t* epc) {
+	meter_t m;
+	long seq = meter_find(bits_value(epc + 32, 8));
+
+	if(seq >= 0) {
+		meter_gen(seq, &m);
+	}
+	if(seq < 0 || bits_value(epc, 16) != EPC_PC || bits_value(epc + 16, 16) != EPC_MARKER ||
+			bits_value(epc + 40, 8) != m.vrms || bits_value(epc + 48, 16) != m.true_power ||
+			bits_value(epc + 64, 16) != (m.watt_hours & 0xFFFF)) {
+		bad_records++;
+		return -1;
+	}
+	if(seq != meter_seen) {
+		meter_seen = seq;
+		span_add(&meter_age, sim_time - meter_fed[seq & 0xFF]);
+	}
+	return seq;
+}
+
+/**************************************************************************
+   ACCESS SECTION
+ **************************************************************************/
+// Req_RN for a handle
+static bool open_tag(uint16_t rn16, uint16_t* handle) {
+	static uint8_t bits[REPLY_BITS];
+	frame_t f;
+
+	frame_req_rn(&f, rn16);
+	sent_req_rn++;
+	int n = exchange(&f, bits, RN16_LEN + CRC_LEN);
+	if(n <= 0 || !crc_ok(bits, n)) {
+		return 0;
+	}
+	got_handle++;
+	*handle = bits_value(bits, 16);
+	return 1;
+}
+
+// Read count words into words. A count of 0 reads to the end of the bank,
+// len words
+static bool read_mem(uint16_t handle, uint8_t bank, uint16_t ptr, uint8_t count, uint8_t len, uint16_t* words) {
+	static uint8_t bits[REPLY_BITS];
+	frame_t f;
+	int i;
+
+	frame_read(&f, bank, ptr, count, handle);
+	sent_read++;
+	int n = exchange(&f, bits, 1 + len * 16 + RN16_LEN + CRC_LEN);
+	if(n <= 0 || !crc_ok(bits, n)) {
+		return 0;
+	}
+	got_read++;
+	if(bits[0] != 0 || bits_value(bits + n - 32, 16) != handle) {
+		bad_reads++;
+		return 0;
+	}
+	for(i = 0; i < len; i++) {
+		words[i] = bits_value(bits + 1 + 16 * i, 16);
+	}
+	return 1;
+}
+
+// The EPC bank from the PC word must match the EPC just received, the whole
+// bank must start with its CRC, and user memory must hold the whole record
+// behind it. Whole banks are read with a WordCount of 0
+static void access(uint16_t rn16, const uint8_t* epc, long seq) {
+	uint16_t handle;
+	uint16_t words[METER_WORDS];
+	meter_t m;
+	int i;
+
+	if(!open_tag(rn16, &handle)) {
+		return;
+	}
+	if(req_rn_again) {						// New RN16 back, the handle must still work
+		uint16_t rn;
+		if(!open_tag(handle, &rn)) {
+			return;
+		}
+		if(!read_mem(handle, BANK_EPC, 1, 1, 1, words)) {
+			bad_reads++;
+			return;
+		}
+	}
+	if(read_words && read_mem(handle, BANK_EPC, 1, read_words, read_words, words)) {
+		for(i = 0; i < read_words; i++) {
+			if(words[i] != bits_value(epc + 16 * i, 16)) {
+				bad_reads++;
+				break;
+			}
+		}
+	}
+	if(read_bank && read_mem(handle, BANK_EPC, 0, 0, EPC_BANK_WORDS, words)) {
+		for(i = 0; i < EPC_BANK_WORDS; i++) {
+			if(words[i] != bits_value(epc + 16 * (i ? i - 1 : EPC_BANK_WORDS - 1), 16)) {
+				bad_reads++;
+				break;
+			}
+		}
+	}
+	if(read_user && read_mem(handle, BANK_USER, 0, 0, METER_WORDS, words)) {
+		meter_gen(seq, &m);
+		for(i = 0; i < METER_WORDS; i++) {
+			if(words[i] != meter_word(&m, i)) {
+				bad_records++;
+				return;
+			}
+		}
+		user_reads++;
+	}
+}
+
+// The EPC did not come back: the tag goes back to arbitrate, unread
+static void nak(void) {
+	static uint8_t bits[REPLY_BITS];
+	frame_t f;
+
+	frame_nak(&f);
+	sent_nak++;
+	exchange(&f, bits, RN16_LEN);
+}
+
+// One slot after a Query, QueryAdjust or QueryRep
+static slot_t slot(frame_t* f) {
+	static uint8_t bits[REPLY_BITS];
+	static uint8_t epc[REPLY_BITS];
+	frame_t ack;
+
+	meter_feed();
+	int n = exchange(f, bits, RN16_LEN);
+	if(n == 0) {
+		return slot_empty;
+	}
+	if(n < 0) {
+		return slot_collided;
+	}
+	got_rn16++;
+	uint16_t rn16 = bits_value(bits, 16);
+
+	frame_ack(&ack, rn16);
+	sent_ack++;
+	n = exchange(&ack, epc, EPC_LEN + CRC_LEN);
+	if(n <= 0) {
+		lost_epc++;
+		nak();
+		return slot_reply;
+	}
+	if(!crc_ok(epc, n)) {
+		nak();
+		return slot_reply;
+	}
+	got_epc++;
+	reads++;
+	tag_epcs[reply_from]++;
+	if(last_read >= 0) {
+		span_add(&read_gap, sim_time - last_read);
+	}
+	last_read = sim_time;
+	long seq = check_epc(epc);
+	if(verbose) {
+		printf("%10.6f EPC", sim_time);
+		int i;
+		for(i = 0; i + 16 <= n - 16; i += 16) {
+			printf(" %04x", bits_value(epc + i, 16));
+		}
+		printf("\n");
+	}
+	if((read_words || read_bank || read_user || req_rn_again) && seq >= 0) {
+		access(rn16, epc, seq);
+	}
+	return slot_reply;
+}
+
+// Select has no reply, the reader waits T4 (2 RTcal) before the Query
+static void select_send(void) {
+	static uint8_t bits[REPLY_BITS];
+	frame_t f;
+
+	frame_select(&f, select_target, select_action, select_bank, select_ptr, 16, select_mask);
+	sent_select++;
+	if(exchange(&f, bits, RN16_LEN) != 0) {
+		select_replies++;
+	}
+	tags_run_to(sim_time + 2 * cfg.rtcal);
+}
+
+// Rounds of 2^Q slots. A tag flips its flag once read, so a round with
+// no replies means everything was read and the reader turns to the other
+// target, as in inventory_model.py. With no_flip it stays on A and only a
+// Select puts the tag back there. With q_adapt the Q algorithm (Gen2
+// annex D) moves Qfp by C on every empty or collided slot, and a
+// QueryAdjust starts 2^Q slots again whenever Q rounds to another value
+static void run(double seconds) {
+	uint8_t target = 0;
+	uint8_t q = q_start;
+	double qfp = q_start;
+	frame_t f;
+
+	while(sim_time < seconds) {
+		unsigned left;
+		bool heard = 0;
+
+		if(m_later && sim_time >= seconds / 2) {
+			reader_set_m(m_later);
+			m_later = 0;
+		}
+
+		if(select_on) {
+			select_send();
+		}
+		frame_query(&f, session, target, q);
+		sent_query++;
+		left = 1u << q;
+		while(1) {
+			slot_t s = slot(&f);
+			heard |= s != slot_empty;
+			left--;
+			if(s == slot_empty) {
+				qfp = fmax(qfp - q_adapt, 0);
+			}
+			else if(s == slot_collided) {
+				qfp = fmin(qfp + q_adapt, 15);
+			}
+			if(sim_time >= seconds) {
+				break;
+			}
+			if(lround(qfp) != q) {
+				int step = lround(qfp) > q ? 1 : -1;
+				q += step;
+				frame_query_adjust(&f, session, step);
+				sent_adjust++;
+				left = 1u << q;
+			}
+			else if(left == 0) {
+				break;
+			}
+			else {
+				frame_query_rep(&f, session);
+				sent_rep++;
+			}
+		}
+		if(carrier_off > 0 && sim_time < seconds) {
+			// Close the last slot, so the tag read in it flips its flag
+			// before the field goes
+			frame_query_rep(&f, session);
+			sent_rep++;
+			heard |= slot(&f) != slot_empty;
+		}
+		if(!heard && !no_flip) {
+			target ^= 1;
+		}
+		tags_run_to(sim_time + round_gap);
+		if(carrier_off > 0) {
+			tags_fall(sim_time);
+			tags_edge(sim_time + carrier_off);
+			off_total += carrier_off;
+			tags_run_to(sim_time + TS);
+		}
+	}
+}
+
+/**************************************************************************
+   MAIN
+ **************************************************************************/
+static void usage(void) {
+	fprintf(stderr,
+		"usage: tagsim [options]\n"
+		"  --seconds S            simulated run time (default 1)\n"
+		"  --tari US              data-0 length, data-1 is twice this (default 25)\n"
+		"  --trcal US             TRcal (default 106.7, BLF 200kHz at DR 64/3)\n"
+		"  --blf KHZ              TRcal for this BLF at the DR given\n"
+		"  --dr 8|64/3            divide ratio in the Query (default 64/3)\n"
+		"  --m M                  Miller M in the Query, 2, 4 or 8, or 1 for FM0 (default 8)\n"
+		"  --m-later M            switch to M halfway through the run\n"
+		"  --trext 0|1            TRext in the Query (default 1)\n"
+		"  --jitter US            reader edge jitter, standard deviation (default 0)\n"
+		"  --bit-errors P         chance each command bit is sent as the other (default 0)\n"
+		"  --dco-error PCT        tag DCO frequency error (default 0)\n"
+		"  --tags N               N tags at once, 1 to 64 (default 1)\n"
+		"  --dco-spread PCT       tag DCO errors spread evenly over this range (default 0)\n"
+		"  --q Q                  Q of every round, the first with --q-adapt (default 0)\n"
+		"  --q-adapt C            Q algorithm with QueryAdjust, Qfp step C (0.1 to 0.5)\n"
+		"  --session S            Query session 0 to 3 (default 0)\n"
+		"  --no-flip              stay on target A when a round is empty\n"
+		"  --select WHAT          Select before every Query, mask matching the EPC marker\n"
+		"                         (marker), the user memory scale (user), or neither (other)\n"
+		"  --select-target T      sl, or s0 to s3 for a session flag (default sl)\n"
+		"  --select-action N      Select Action 0 to 7 (default 0)\n"
+		"  --sel all|sl|notsl     Query Sel (default all)\n"
+		"  --read N               read N EPC bank words back after each EPC (max 5)\n"
+		"  --read-bank            read the whole EPC bank after each EPC, WordCount 0\n"
+		"  --req-rn-again         second Req_RN with the handle before the Reads\n"
+		"  --user                 read the metering record from user memory after each EPC\n"
+		"  --meter-period S       new metering record every S seconds, 0 for none (default 0.1)\n"
+		"  --round-gap US         reader CW between rounds (default 0)\n"
+		"  --carrier-off MS       reader carrier off between rounds, then 1.5ms of CW (default 0)\n"
+		"  --wake-us US           tag LPM3/4 exit time (default 100)\n"
+		"  --aclk-khz KHZ         tag ACLK, the VLO, for the persistence timers (default 10)\n"
+		"  --t1-tol F             reply must start by nominal T1 * (1 + F) + 2us (default 0.1)\n"
+		"  --seed N               reader random seed (default 1)\n"
+		"  --expect-reads R       at least R EPC reads per second\n"
+		"  --expect-tag-reads R   at least R EPC reads per second of every tag\n"
+		"  --expect-none          the tag never answers a Query\n"
+		"  --expect-gap LO:HI     every time between EPC reads in range, in ms\n"
+		"  --expect-t1 LO:HI      every T1 in range, in us\n"
+		"  --expect-ua UA         average tag current at most UA\n"
+		"  --expect-idle-ua UA    tag current with the carrier off at most UA\n"
+		"  --brief                one line summary\n"
+		"  --verbose              list every EPC\n");
+	exit(2);
+}
+
+static void parse_range(range_t* r, const char* arg) {
+	if(sscanf(arg, "%lf:%lf", &r->lo, &r->hi) != 2) {
+		usage();
+	}
+	r->set = 1;
+}
+
+int main(int argc, char** argv) {
+	double seconds = 1;
+	double dco_error = 0;
+	double dco_spread = 0;
+	unsigned tag_n = 1;
+	double expect_reads = 0;
+	double expect_tag_reads = 0;
+	range_t expect_t1 = { 0 };
+	range_t expect_gap = { 0 };
+	double expect_ua = 0;
+	double expect_idle_ua = 0;
+	double wake = 100e-6;
+	double aclk = 10e3;
+	uint32_t seed = 1;
+	bool brief = 0;
+	bool expect_none = 0;
+	double blf_khz = 0;
+
+	int i;
+	for(i = 1; i < argc; i++) {
+		const char* a = argv[i];
+		const char* v = (i + 1 < argc) ? argv[i + 1] : NULL;
+		if(strcmp(a, "--verbose") == 0) {
+			verbose = 1;
+			continue;
+		}
+		if(strcmp(a, "--req-rn-again") == 0) {
+			req_rn_again = 1;
+			continue;
+		}
+		if(strcmp(a, "--read-bank") == 0) {
+			read_bank = 1;
+			continue;
+		}
+		if(strcmp(a, "--user") == 0) {
+			read_user = 1;
+			continue;
+		}
+		if(strcmp(a, "--brief") == 0) {
+			brief = 1;
+			continue;
+		}
+		if(strcmp(a, "--no-flip") == 0) {
+			no_flip = 1;
+			continue;
+		}
+		if(strcmp(a, "--expect-none") == 0) {
+			expect_none = 1;
+			continue;
+		}
+		if(!v) {
+			usage();
+		}
+		i++;
+		if(strcmp(a, "--seconds") == 0) {
+			seconds = atof(v);
+		}
+		else if(strcmp(a, "--tari") == 0) {
+			cfg.tari = atof(v) * 1e-6;
+			cfg.data1 = 2 * cfg.tari;
+			cfg.rtcal = cfg.tari + cfg.data1;
+			cfg.delim = cfg.tari / 2;
+		}
+		else if(strcmp(a, "--trcal") == 0) {
+			cfg.trcal = atof(v) * 1e-6;
+		}
+		else if(strcmp(a, "--blf") == 0) {
+			blf_khz = atof(v);
+		}
+		else if(strcmp(a, "--dr") == 0) {
+			if(strcmp(v, "8") == 0) {
+				cfg.dr = 0;
+			}
+			else if(strcmp(v, "64/3") == 0) {
+				cfg.dr = 1;
+			}
+			else {
+				usage();
+			}
+		}
+		else if(strcmp(a, "--m") == 0) {
+			cfg.m = atoi(v);
+			if(cfg.m != 1 && cfg.m != 2 && cfg.m != 4 && cfg.m != 8) {
+				usage();
+			}
+		}
+		else if(strcmp(a, "--trext") == 0) {
+			cfg.trext = atoi(v) != 0;
+		}
+		else if(strcmp(a, "--m-later") == 0) {
+			m_later = atoi(v);
+			if(m_later != 1 && m_later != 2 && m_later != 4 && m_later != 8) {
+				usage();
+			}
+		}
+		else if(strcmp(a, "--jitter") == 0) {
+			cfg.jitter = atof(v) * 1e-6;
+		}
+		else if(strcmp(a, "--bit-errors") == 0) {
+			cfg.bit_errors = atof(v);
+		}
+		else if(strcmp(a, "--dco-error") == 0) {
+			dco_error = atof(v) / 100;
+		}
+		else if(strcmp(a, "--tags") == 0) {
+			tag_n = atoi(v);
+			if(tag_n < 1 || tag_n > TAGS_MAX) {
+				usage();
+			}
+		}
+		else if(strcmp(a, "--dco-spread") == 0) {
+			dco_spread = atof(v) / 100;
+		}
+		else if(strcmp(a, "--q-adapt") == 0) {
+			q_adapt = atof(v);
+		}
+		else if(strcmp(a, "--q") == 0) {
+			q_start = atoi(v) & 0x0F;
+		}
+		else if(strcmp(a, "--session") == 0) {
+			session = atoi(v) & 0x03;
+		}
+		else if(strcmp(a, "--select") == 0) {
+			select_on = 1;
+			if(strcmp(v, "marker") == 0 || strcmp(v, "other") == 0) {
+				select_bank = BANK_EPC;
+				select_ptr = 0x20;				// After StoredCRC and PC
+				select_mask = EPC_MARKER ^ (v[0] == 'o');
+			}
+			else if(strcmp(v, "user") == 0) {
+				select_bank = BANK_USER;
+				select_ptr = 0x20;				// High word of the scale
+				select_mask = 0x4E2A;
+			}
+			else {
+				usage();
+			}
+		}
+		else if(strcmp(a, "--select-target") == 0) {
+			if(strcmp(v, "sl") == 0) {
+				select_target = SEL_TARGET_SL;
+			}
+			else if(v[0] == 's' && v[1] >= '0' && v[1] <= '3' && !v[2]) {
+				select_target = v[1] - '0';
+			}
+			else {
+				usage();
+			}
+		}
+		else if(strcmp(a, "--select-action") == 0) {
+			select_action = atoi(v) & 0x07;
+		}
+		else if(strcmp(a, "--sel") == 0) {
+			if(strcmp(v, "all") == 0) {
+				cfg.sel = 0;
+			}
+			else if(strcmp(v, "sl") == 0) {
+				cfg.sel = SEL_SL;
+			}
+			else if(strcmp(v, "notsl") == 0) {
+				cfg.sel = SEL_NOT_SL;
+			}
+			else {
+				usage();
+			}
+		}
+		else if(strcmp(a, "--read") == 0) {
+			read_words = atoi(v);
+			if(read_words > EPC_BANK_WORDS - 1) {
+				usage();
+			}
+		}
+		else if(strcmp(a, "--meter-period") == 0) {
+			meter_period = atof(v);
+		}
+		else if(strcmp(a, "--round-gap") == 0) {
+			round_gap = atof(v) * 1e-6;
+		}
+		else if(strcmp(a, "--carrier-off") == 0) {
+			carrier_off = atof(v) * 1e-3;
+		}
+		else if(strcmp(a, "--wake-us") == 0) {
+			wake = atof(v) * 1e-6;
+		}
+		else if(strcmp(a, "--aclk-khz") == 0) {
+			aclk = atof(v) * 1e3;
+		}
+		else if(strcmp(a, "--t1-tol") == 0) {
+			t1_tol = atof(v);
+		}
+		else if(strcmp(a, "--seed") == 0) {
+			seed = strtoul(v, NULL, 0);
+		}
+		else if(strcmp(a, "--expect-reads") == 0) {
+			expect_reads = atof(v);
+		}
+		else if(strcmp(a, "--expect-tag-reads") == 0) {
+			expect_tag_reads = atof(v);
+		}
+		else if(strcmp(a, "--expect-t1") == 0) {
+			parse_range(&expect_t1, v);
+		}
+		else if(strcmp(a, "--expect-gap") == 0) {
+			parse_range(&expect_gap, v);
+		}
+		else if(strcmp(a, "--expect-ua") == 0) {
+			expect_ua = atof(v);
+		}
+		else if(strcmp(a, "--expect-idle-ua") == 0) {
+			expect_idle_ua = atof(v);
+		}
+		else {
+			usage();
+		}
+	}
+
+	// Gen2 T1: max(RTcal, 10 Tpri), BLF = DR / TRcal
+	double dr = cfg.dr ? 64.0 / 3 : 8;
+	if(blf_khz > 0) {
+		cfg.trcal = dr / (blf_khz * 1e3);
+	}
+	double tpri = cfg.trcal / dr;
+	blf_nominal = 1 / tpri;
+	t1_nominal = fmax(cfg.rtcal, 10 * tpri);
+	t1_max = t1_nominal * (1 + t1_tol) + 2e-6;
+	t2 = 10 * tpri;
+
+	reader_init(&cfg, seed);
+	tags_reset(tag_n, dco_error, dco_spread, wake, aclk);
+	run(seconds);
+
+	periph_stats_t st;
+	double deep_time;
+	unsigned busy;
+	tags_stats(&st, &deep_time, &busy);
+
+	double rate = reads / sim_time;
+	double t1_avg = t1.count ? t1.total / t1.count : 0;
+	uint64_t tag_min = tag_epcs[0];
+	unsigned k;
+	for(k = 1; k < tag_n; k++) {
+		tag_min = tag_epcs[k] < tag_min ? tag_epcs[k] : tag_min;
+	}
+
+	// Awake is LPM1 with the DCO running, the ISRs themselves are short. The
+	// tag only sleeps with the carrier off, so idle is that time alone. Per
+	// tag, with several
+	double deep = deep_time / sim_time;
+	double ua = deep * I_LPM4_UA + (1 - deep) * I_LPM1_UA;
+	double idle = off_total > 0 ? fmin(deep_time / off_total, 1) : 0;
+	double idle_ua = idle * I_LPM4_UA + (1 - idle) * I_LPM1_UA;
+
+	if(brief) {
+		printf("%8.1f reads/s  T1 %6.2f/%6.2f/%6.2fus  BLF %5.1fkHz  %5.1fuA  %llu early  %llu late  %llu wasted  %llu decode  %llu CRC  %llu storms  %llu collisions  %.1f/s slowest tag\n",
+				rate, t1.min * 1e6, t1_avg * 1e6, t1.max * 1e6,
+				(blf.count ? blf.total / blf.count : 0) * 1e-3, ua, (unsigned long long) early,
+				(unsigned long long) late, (unsigned long long) wasted,
+				(unsigned long long) decode_errors, (unsigned long long) crc_errors,
+				(unsigned long long) st.storms, (unsigned long long) collisions, tag_min / sim_time);
+	}
+	else {
+		printf("%.3fs simulated, Tari %.2fus, TRcal %.1fus, DR %s, M %u, TRext %u, Sel %u, jitter %.1fus, DCO %+.1f%%, Q %u%s, session %u\n",
+				sim_time, cfg.tari * 1e6, cfg.trcal * 1e6, cfg.dr ? "64/3" : "8", cfg.m, cfg.trext,
+				cfg.sel, cfg.jitter * 1e6, dco_error * 100, q_start, q_adapt > 0 ? " adaptive" : "", session);
+		printf("%-16s Select %llu, Query %llu, QueryAdjust %llu, QueryRep %llu, ACK %llu, NAK %llu, Req_RN %llu, Read %llu\n",
+				"commands", (unsigned long long) sent_select, (unsigned long long) sent_query,
+				(unsigned long long) sent_adjust, (unsigned long long) sent_rep,
+				(unsigned long long) sent_ack, (unsigned long long) sent_nak, (unsigned long long) sent_req_rn,
+				(unsigned long long) sent_read);
+		printf("%-16s RN16 %llu, EPC %llu, handle %llu, Read %llu\n", "replies",
+				(unsigned long long) got_rn16, (unsigned long long) got_epc,
+				(unsigned long long) got_handle, (unsigned long long) got_read);
+		printf("%-16s %llu undecodable, %llu bad CRC, %llu early, %llu late, %llu ACKs unanswered, %llu bad Read\n",
+				"errors", (unsigned long long) decode_errors, (unsigned long long) crc_errors,
+				(unsigned long long) early, (unsigned long long) late, (unsigned long long) lost_epc,
+				(unsigned long long) bad_reads);
+		printf("%-16s %llu corrupted, %llu of them with a CRC, %llu replies to those\n", "bit errors",
+				(unsigned long long) corrupted, (unsigned long long) corrupted_crc,
+				(unsigned long long) wasted);
+		printf("%-16s %llu EPCs, %.1f per second, %llu user memory reads, %.1f min, %.1f max ms apart\n", "reads",
+				(unsigned long long) reads, rate, (unsigned long long) user_reads,
+				read_gap.min * 1e3, read_gap.max * 1e3);
+		if(tag_n > 1) {
+			printf("%-16s %u, %llu collisions, %.1f min, %.1f average EPCs per second per tag, DCO spread %.1f%%\n",
+					"tags", tag_n, (unsigned long long) collisions, tag_min / sim_time,
+					rate / tag_n, dco_spread * 100);
+		}
+		printf("%-16s %u fed, %llu bad, %.1f min, %.1f avg, %.1f max ms from meter_set() to EPC\n",
+				"records", meter_seq, (unsigned long long) bad_records, meter_age.min * 1e3,
+				(meter_age.count ? meter_age.total / meter_age.count : 0) * 1e3, meter_age.max * 1e3);
+		printf("%-16s %.2f min, %.2f avg, %.2f max us, nominal %.1fus, reader waits %.1fus\n", "T1",
+				t1.min * 1e6, t1_avg * 1e6, t1.max * 1e6, t1_nominal * 1e6, t1_max * 1e6);
+		printf("%-16s %.1f min, %.1f max kHz, nominal %.1fkHz\n", "BLF",
+				blf.min * 1e-3, blf.max * 1e-3, blf_nominal * 1e-3);
+		printf("%-16s %.0f min, %.0f max SMCLK cycles per subcarrier bit, transitions within %.0fns of an even grid\n",
+				"TX", tx_bit.min * SMCLK_HZ * (1 + dco_error), tx_bit.max * SMCLK_HZ * (1 + dco_error),
+				tx_edge_dev * 1e9);
+		printf("%-16s %.1fuA average, %.1fuA idle, LPM4 %.1f%% of the time, %llu sleeps, %llu wakes, %llu edges missed (LPM1 only %.1fuA)\n",
+				"power", ua, idle_ua, deep * 100, (unsigned long long) st.sleeps,
+				(unsigned long long) st.wakes, (unsigned long long) st.missed, I_LPM1_UA);
+		printf("%-16s TIMER_B %llu, TIMER_B1 %llu (%llu timeouts), TIMERA0_IV %llu, DMA %llu, PORT2 %llu, %llu storms, %llu capture overruns\n",
+				"ISRs", (unsigned long long) st.timer_b,
+				(unsigned long long) st.timer_b1,
+				(unsigned long long)(st.timer_b1 - st.replies - busy - st.tx_ends),
+				(unsigned long long) st.timer_a0,
+				(unsigned long long) st.dma, (unsigned long long) st.port2,
+				(unsigned long long) st.storms, (unsigned long long) st.overruns);
+	}
+
+	if(st.storms) {
+		fail("%s: %.0f ISRs back to back, %.0f times", "interrupt storm", STORM_LIMIT, st.storms);
+	}
+	if(decode_errors || crc_errors || bad_reads) {
+		fail("%s: %.0f undecodable or bad CRC, %.0f bad Read", "replies",
+				decode_errors + crc_errors, bad_reads);
+	}
+	if(bad_records) {
+		fail("%s: %.0f EPCs or user memory reads did not match a record fed (%.0f fed)", "meter", bad_records, meter_seq);
+	}
+	if(wasted) {
+		fail("%s: %.0f replies to %.0f corrupted commands", "CRC", wasted, corrupted_crc);
+	}
+	if(blf.count && (blf.min < blf_nominal * (1 - t1_tol) || blf.max > blf_nominal * (1 + t1_tol))) {
+		fail("%s %.1f:%.1fkHz, off nominal by more than the tolerance", "BLF", blf.min * 1e-3, blf.max * 1e-3);
+	}
+	if(select_replies) {
+		fail("%s: %.0f replies to %.0f Selects", "Select", select_replies, sent_select);
+	}
+	if(expect_none && got_rn16) {
+		fail("%s: %.0f RN16s, expected none after %.0f Queries", "inventory", got_rn16, sent_query);
+	}
+	if(tag_min / sim_time < expect_tag_reads) {
+		fail("%s %.1f per second from the slowest tag, expected %.1f", "reads", tag_min / sim_time, expect_tag_reads);
+	}
+	if(rate < expect_reads) {
+		fail("%s %.1f per second, expected %.0f", "reads", rate, expect_reads);
+	}
+	if(expect_ua > 0 && ua > expect_ua) {
+		fail("%s %.1fuA average, expected at most %.1fuA", "power", ua, expect_ua);
+	}
+	if(expect_idle_ua > 0 && (off_total == 0 || idle_ua > expect_idle_ua)) {
+		fail("%s %.1fuA idle, expected at most %.1fuA", "power", idle_ua, expect_idle_ua);
+	}
+	if(expect_t1.set && (late || t1.count == 0 ||
+			t1.min * 1e6 < expect_t1.lo || t1.max * 1e6 > expect_t1.hi)) {
+		fail("%s %.2f:%.2fus outside the expected range", "T1", t1.min * 1e6, t1.max * 1e6);
+	}
+	if(expect_gap.set && (read_gap.count == 0 ||
+			read_gap.min * 1e3 < expect_gap.lo || read_gap.max * 1e3 > expect_gap.hi)) {
+		fail("%s %.1f:%.1fms between EPC reads, outside the expected range", "reads",
+				read_gap.min * 1e3, read_gap.max * 1e3);
+	}
+	printf("%s\n", failed ? "FAILED" : "PASSED");
+	return failed;
+}
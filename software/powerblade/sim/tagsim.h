@@ -0,0 +1,141 @@
+#ifndef TAGSIM_H_
+#define TAGSIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**************************************************************************
+   TAG SECTION
+ **************************************************************************/
+#define SMCLK_HZ		24e6		// DCORSEL + DCOFSEL0 + DCOFSEL1, SMCLK = DCO
+#define TB0_DIV			4			// ID_2
+#define STORM_LIMIT		64			// Back to back ISRs before we call it a storm
+#define RX_BIT			0x0002		// P2.1, RX_PIN in main.c
+#define TX_BIT			0x0001		// P2.0, TX_PIN
+
+// Rough supply current at 3V for the power model
+#define I_LPM1_UA		300.0		// CPU off, DCO at 24MHz clocking TB0 or the SPI
+#define I_LPM4_UA		6.0			// Clocks off, RAM and the port interrupt kept
+
+#define REPLY_MAX		8192		// Subcarrier bits in one reply
+
+// CPU cycles of the TX_BITBANG loop in TIMER_B1, counted from the CPUXv2
+// instruction timings of the loop as written, FRAM served from the cache.
+// Not measured on the part
+#define BB_ENTRY_CYCLES	35			// Interrupt to the top of the loop
+#define BB_EDGE_CYCLES	30			// Top of the loop to the P2OUT write
+#define BB_BODY_CYCLES	37			// Top of the loop to the first TB0R read
+#define BB_SHIFT_CYCLES	4			// Per place of 1 << (txBitCount % 8)
+#define BB_POLL_CYCLES	9			// One pass of the wait for TB0R
+#define BB_EXIT_CYCLES	8			// TB0R read to the top of the loop
+
+// One backscattered reply, as shifted out of UCA0SIMO
+typedef struct {
+	double start;					// Seconds, first subcarrier bit
+	double bit_time;				// Seconds per subcarrier bit
+	unsigned bits;
+	uint8_t data[REPLY_MAX / 8];	// LSB first, as the SPI sends it
+	double bit_min, bit_max;		// Seconds, shortest and longest subcarrier bit
+	double edge_dev;				// Seconds, furthest transition from an even grid
+} reply_t;
+
+typedef struct {
+	uint64_t timer_b;				// ISR runs
+	uint64_t timer_b1;
+	uint64_t timer_a0;
+	uint64_t dma;
+	uint64_t replies;
+	uint64_t tx_ends;				// TIMER_B1 runs that end an SPI reply
+	uint64_t storms;				// STORM_LIMIT ISRs without returning to LPM
+	uint64_t overruns;				// Capture with CCIFG still set (COV)
+	uint64_t port2;
+	uint64_t sleeps;				// Times into LPM3/4
+	uint64_t wakes;					// by the port interrupt
+	uint64_t missed;				// Edges that hit neither the timer nor the port
+	double deep;					// Seconds in LPM3/4, closed stretches
+} periph_stats_t;
+
+// Firmware entry points, main() is renamed by the Makefile
+int tag_main(void);
+void TIMER_B(void);
+void TIMER_B1(void);
+void TIMERA0_IV_ISR(void);
+void DMA_ISR(void);
+void PORT2_ISR(void);
+
+// tag_periph.c
+extern double sim_time;
+extern periph_stats_t periph_stats;
+void periph_reset(double dco_error, double wake, double aclk, unsigned id);
+void periph_run_to(double t);
+void periph_edge(double t);
+void periph_fall(double t);
+double periph_deep(void);
+bool periph_busy(void);
+bool periph_reply(reply_t* r);
+
+// tags.c, several tags at once. Each has its own copy of the firmware and
+// tag_periph.c data, swapped in by tag_use(). sim_time and periph_stats are
+// the tag's in use, the tags_* calls leave every tag at the same time
+#define TAGS_MAX		64
+
+void tags_reset(unsigned n, double dco_error, double dco_spread, double wake, double aclk);
+unsigned tags_count(void);
+void tag_use(unsigned k);
+void tags_run_to(double t);
+void tags_edge(double t);
+void tags_fall(double t);
+bool tags_busy(void);
+unsigned tags_reply(reply_t* r, unsigned* from);
+void tags_stats(periph_stats_t* total, double* deep, unsigned* busy);
+
+/**************************************************************************
+   READER SECTION
+ **************************************************************************/
+#define FRAME_MAX		128			// Command bits
+
+typedef struct {
+	double tari;					// Seconds, data-0
+	double data1;
+	double rtcal;
+	double trcal;
+	double delim;
+	uint8_t dr;						// Query DR: 0 is 8, 1 is 64/3
+	uint8_t m;						// Miller M asked for, 2, 4 or 8, or 1 for FM0
+	uint8_t trext;					// Query TRext: 16 bits of Miller tone or the FM0 pilot, or 4 and none
+	uint8_t sel;					// Query Sel: 0 is All, 2 ~SL, 3 SL
+	double jitter;					// Edge jitter, standard deviation in seconds
+	double bit_errors;				// Chance a data symbol goes out as the other one
+} reader_cfg_t;
+
+typedef struct {
+	uint8_t bits[FRAME_MAX];		// One per byte, in air order
+	unsigned len;
+	bool query;						// Full preamble with TRcal
+	bool crc;						// Protected by a CRC-5 or CRC-16
+	uint8_t code_len;				// Command code bits
+	unsigned flips;					// Symbols corrupted on the way, set by reader_send()
+	unsigned first_flip;
+} frame_t;
+
+// reader.c
+void reader_init(const reader_cfg_t* cfg, uint32_t seed);
+double reader_send(frame_t* f);
+int reader_decode(const reply_t* r, uint8_t* bits, int len);
+double reader_rand(void);
+void reader_set_m(uint8_t m);
+
+void frame_query(frame_t* f, uint8_t session, uint8_t target, uint8_t q);
+void frame_query_rep(frame_t* f, uint8_t session);
+void frame_query_adjust(frame_t* f, uint8_t session, int step);
+void frame_ack(frame_t* f, uint16_t rn);
+void frame_nak(frame_t* f);
+void frame_req_rn(frame_t* f, uint16_t rn);
+void frame_read(frame_t* f, uint8_t bank, uint16_t ptr, uint8_t count, uint16_t handle);
+void frame_select(frame_t* f, uint8_t target, uint8_t action, uint8_t bank, uint16_t ptr,
+		uint8_t len, uint32_t mask);
+
+uint32_t bits_value(const uint8_t* bits, int len);
+uint16_t bits_crc16(const uint8_t* bits, int len);
+
+#endif // TAGSIM_H_
@@ -0,0 +1,195 @@
+/*
+ * Reply waveform check: every Miller M and FM0 reply the encoder can build
+ * is compared bit for bit with one built straight from the Gen2 rules, and
+ * decoded again by the reader, with and without TRext. Covers the compile
+ * time EPC templates too
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "miller.h"
+#include "tagsim.h"
+
+#define WAVE_MAX		(REPLY_MAX / 8)
+#define DATA_MAX		255			// Longest reply checked, data bits
+
+// FM0 pilot of twelve zeros with TRext = 1, then 1010v1 (Gen2 figure 6.11),
+// one level per half bit starting high. TRext = 0 starts at the preamble
+static const char fm0_pilot[] = "101010101010101010101010";
+static const char fm0_preamble[] = "110100100011";
+
+static const uint8_t ms[] = { 8, 4, 2, 1 };
+static int failures;
+
+static uint8_t trext;
+
+static void fail(const char* what, uint8_t m, int len) {
+	printf("FAIL: %s, M %u, TRext %u, %d data bits\n", what, m, trext, len);
+	failures++;
+}
+
+static void put_level(uint8_t* wave, unsigned* pos, int level) {
+	if(level) {
+		wave[*pos / 8] |= 0x01 << (*pos % 8);
+	}
+	(*pos)++;
+}
+
+// A half bit of Miller is M subcarrier bits, phase 0 starting low
+static void put_half(uint8_t* wave, unsigned* pos, uint8_t m, int phase) {
+	uint8_t i;
+	for(i = 0; i < m; i++) {
+		put_level(wave, pos, (i & 1) ^ phase);
+	}
+}
+
+// Reply for data bits and the EOS straight from the rules: FM0 inverts at
+// every boundary and in the middle of a '0'. Miller inverts in the middle
+// of a '1' and between two '0's, after 16 bits of tone (4 without TRext)
+// and 010111. Returns the bits used, the rest of the last byte is left with
+// no subcarrier
+static unsigned reference(uint8_t* wave, uint8_t m, const uint8_t* bits, int len) {
+	static const uint8_t preamble[] = { 0, 1, 0, 1, 1, 1 };
+	unsigned pos = 0;
+	int i;
+
+	memset(wave, 0, WAVE_MAX);
+	if(m == 1) {
+		int level = 0;
+		for(i = 0; trext && fm0_pilot[i]; i++) {
+			level = fm0_pilot[i] - '0';
+			put_level(wave, &pos, level);
+		}
+		for(i = 0; fm0_preamble[i]; i++) {
+			level = fm0_preamble[i] - '0';
+			put_level(wave, &pos, level);
+		}
+		for(i = 0; i <= len; i++) {
+			int bit = i < len ? bits[i] : 1;
+			level ^= 1;
+			put_level(wave, &pos, level);
+			level ^= !bit;
+			put_level(wave, &pos, level);
+		}
+		return pos;
+	}
+
+	int phase = 0;
+	int prev = 1;
+	for(i = 0; i < (trext ? LEN_TONE : LEN_TONE_SHORT) * 2; i++) {
+		put_half(wave, &pos, m, phase);
+	}
+	for(i = 0; i < LEN_PMBL + len + LEN_EOS; i++) {
+		int bit = i < LEN_PMBL ? preamble[i] : i < LEN_PMBL + len ? bits[i - LEN_PMBL] : 1;
+		phase ^= !bit && !prev;
+		put_half(wave, &pos, m, phase);
+		phase ^= bit;
+		put_half(wave, &pos, m, phase);
+		prev = bit;
+	}
+	return pos;
+}
+
+// Encoder output against the reference and back through the reader. The
+// tag leaves miller_pilot_skip() bytes off the front without TRext
+static void check(const char* what, const char* buf, const miller_state_t* st,
+		uint8_t m, const uint8_t* bits, int len) {
+	static uint8_t wave[WAVE_MAX];
+	static reply_t r;
+	static uint8_t decoded[DATA_MAX + LEN_EOS];
+	uint16_t skip = trext ? 0 : miller_pilot_skip();
+	uint16_t n = miller_len(st) - skip;
+	unsigned used = reference(wave, m, bits, len);
+
+	buf += skip;
+	if(n != (used + 7) / 8) {
+		fail(what, m, len);
+		printf("      %u bytes, expected %u\n", n, (used + 7) / 8);
+		return;
+	}
+	if(memcmp(buf, wave, n) != 0) {
+		fail(what, m, len);
+		return;
+	}
+	r.bits = n * 8;
+	memcpy(r.data, buf, n);
+	if(reader_decode(&r, decoded, len) != len || memcmp(decoded, bits, len) != 0) {
+		fail("reader decode", m, len);
+	}
+}
+
+static void random_bits(uint8_t* bits, int len) {
+	int i;
+	for(i = 0; i < len; i++) {
+		bits[i] = reader_rand() < 0.5;
+	}
+}
+
+// Odd bits one at a time, then whole bytes, over whatever the buffer held
+static void encode(char* buf, miller_state_t* st, const uint8_t* bits, int len) {
+	int i = 0;
+	for(; i < len % 8; i++) {
+		miller_bit(buf, st, bits[i]);
+	}
+	for(; i < len; i += 8) {
+		miller_put(buf, st, bits_value(bits + i, 8));
+	}
+	miller_eos(buf, st);
+}
+
+int main(void) {
+	static char buf[WAVE_MAX];
+	static uint8_t bits[DATA_MAX];
+	reader_cfg_t cfg;
+	miller_state_t st;
+	unsigned i, k;
+	int len, t;
+
+	memset(&cfg, 0, sizeof(cfg));
+	for(t = 1; t >= 0; t--) {
+		for(i = 0; i < sizeof(ms); i++) {
+			uint8_t m = ms[i];
+			trext = t;
+			cfg.m = m;
+			cfg.trext = trext;
+			reader_init(&cfg, 1 + m);
+			miller_m = m;
+
+			// Run time replies: RN16, handle, Reads with their odd header bit
+			for(len = 0; len <= DATA_MAX; len++) {
+				for(k = 0; k < 4; k++) {
+					random_bits(bits, len);
+					memset(buf, k & 1 ? 0xFF : 0x00, sizeof(buf));
+					miller_start(buf, &st);
+					encode(buf, &st, bits, len);
+					check("run time reply", buf, &st, m, bits, len);
+				}
+			}
+
+			// EPC from the template: PC and marker, then a tail
+			for(k = 0; k < 16; k++) {
+				for(len = 0; len < EPC_BASE_LEN; len++) {
+					bits[len] = (EPC_BASE_BITS >> (EPC_BASE_LEN - 1 - len)) & 0x01;
+				}
+				random_bits(bits + EPC_BASE_LEN, EPC_TAIL_LEN + CRC_LEN);
+				memset(buf, 0xFF, sizeof(buf));
+				miller_epc_tail(&st);
+				memcpy(buf, miller_template(), st.index + (st.fill != 0));
+				encode(buf, &st, bits + EPC_BASE_LEN, EPC_TAIL_LEN + CRC_LEN);
+				check("EPC template", buf, &st, m, bits, EPC_LEN + CRC_LEN);
+				if(miller_len(&st) != miller_epc_len()) {
+					fail("EPC length", m, EPC_LEN + CRC_LEN);
+				}
+			}
+		}
+	}
+
+	if(failures) {
+		printf("%d FAILED\n", failures);
+		return 1;
+	}
+	printf("waveform: M 8, 4, 2 and FM0, TRext 1 and 0, every length to %d bits, and the EPC templates\n", DATA_MAX);
+	printf("PASSED\n");
+	return 0;
+}
@@ -0,0 +1,930 @@
+#include <msp430.h> 
+#include <stdint.h>
+#include <string.h>
+
+#include "gen2.h"
+#include "meter.h"
+#include "miller.h"
+#include "rng.h"
+#include "tag.h"
+
+#if defined (UPLINK_GEN2)
+#include "clock.h"
+#endif
+
+#define RF_TIMEOUT		1500		// Longer than the longest TRcal (200us)
+#define RX_LOW_CHECK	240			// 40us, longer than any PIE low pulse
+#define RX_CW_CHECK		60000		// 10ms between carrier checks under CW
+
+// SMCLK cycles per subcarrier bit (half a BLF cycle) the SPI can clock out
+#define CHIP_MIN		18			// BLF 640kHz
+#define CHIP_MAX		300			// BLF 40kHz
+
+#define INV_S0			0x01		// inv_flags, inventoried flags set = B
+#define INV_S1			0x02
+#define INV_S2_S3		0x0C
+#define INV_SL			0x10		// SL, set = asserted
+
+// Persistence, in ticks of TA0.CCR1. TA0 counts ACLK, which runs through
+// LPM3: XT1 in the metering image, the VLO (6 to 14kHz) standalone
+#if defined (UPLINK_GEN2)
+#define PERSIST_TICK	8192		// 250ms at 32768Hz
+#else
+#define PERSIST_TICK	2500		// 250ms at 10kHz
+#endif
+#define PERSIST_S1		8			// S1 B to A, 2s (1.2 to 3.3s over the VLO range)
+#define PERSIST_OFF		16			// S2, S3 and SL without a carrier, over 2s at any VLO
+
+uint16_t crc_base_bits;
+uint16_t crc_bits;
+
+typedef enum {
+	rf_idle,
+	rf_inInv_d0,
+	rf_inInv_RTCal,
+	rf_inInv_TRCal,
+	rf_inInv_query,
+	rf_inInv_reply,
+	rf_inInv_txEnd,		// Last bytes shifting out, CCR1 at the end
+	rf_sleep			// No carrier, LPM4 until RX_PIN rises, or stopped
+} rf_mode_t;
+
+typedef enum {
+	inv_query,			// Ready, waiting for a Query
+	inv_arbitrate,		// In a round, counting slots
+	inv_ack,			// RN16 sent, waiting for the ACK
+	inv_acked,			// EPC sent, Req_RN gets a handle
+	inv_open			// Handle issued, Read allowed
+} inv_mode_t;
+
+volatile rf_mode_t rf_mode;
+inv_mode_t inv_mode;
+uint8_t rx_low;			// RX_PIN was low at the last timeout
+
+// Globals used in preamble timing capture
+uint16_t d0_len;
+uint16_t rt_len;
+volatile uint16_t rt_pivot;
+uint16_t tr_len;
+
+// Reply link, from the last Query
+uint16_t tx_chip;		// SMCLK cycles per subcarrier bit, UCA0BRW
+uint16_t t1_pri;		// 10 Tpri in timer ticks, T1 is the longer of this and RTcal
+
+// Globals used for commands (from inventory round)
+uint16_t query_bittime;
+uint8_t inv_flags;		// Inventoried flag per session and SL, INV_*
+uint8_t persist_s1;		// Ticks until S1 goes back to A, 0 when not counting
+uint8_t persist_off;	// Ticks until S2, S3 and SL go with the carrier off
+uint8_t session;
+uint8_t q;
+uint16_t slot;
+uint16_t rn16;
+uint16_t handle;
+char rn16_buf[RN16_REPLY_LEN];		// Header from the template, RN16 and EOS patched per reply
+char epc_buf[EPC_REPLY_LEN];		// Template, then the record, CRC and EOS staged while idle
+uint8_t epc_m;						// M both buffers hold, 0 before the first copy
+uint16_t epc_len;
+char reply_buf[READ_REPLY_LEN];								// Handle and Read replies
+const char* txBuf;
+uint16_t txLen;			// Reply length in bytes, 8 subcarrier bits each
+uint8_t tx_skip;		// Bytes of tone or pilot left off the front of every reply, TRext = 0
+
+// EPC tail staging, see epc_stage_step()
+char stage_buf[EPC_TAIL_REPLY_LEN];		// Tail for the next record, copied over when complete
+meter_t meter_stage;
+uint8_t stage_pos;						// Next step, 0 when idle
+uint16_t stage_crc;
+miller_state_t stage_st;
+
+char cmd_reply(gen2_cmd_t cmd);
+char link_set(uint8_t dr, uint8_t m, uint8_t trext);
+char slot_start(void);
+char slot_reply(void);
+void inv_wait(void);
+void inv_done(void);
+void persist_update(uint8_t before);
+void persist_run(void);
+void select_run(void);
+char select_match(uint8_t bank, uint16_t ptr, uint8_t len, uint16_t pos);
+void read_reply(uint8_t bank, uint16_t ptr, uint8_t count);
+uint16_t mem_size(uint8_t bank);
+uint16_t mem_word(uint8_t bank, uint16_t ptr);
+void epc_stage_step(void);
+void tx_start(const char* buf, uint16_t len);
+void rx_restart(void);
+void rx_sleep(void);
+
+// Link defaults, RNG and the first (empty) EPC. Uses the ADC for the seed,
+// so it runs before anything else sets the ADC up
+void tag_init(void) {
+	rf_mode = rf_sleep;
+	inv_mode = inv_query;
+	inv_flags = 0;
+	persist_s1 = 0;
+	persist_off = 0;
+	tag_reads = 0;
+
+	// BLF 200kHz at M = 8 until the first Query says otherwise
+	miller_m = 8;
+	tx_skip = 0;
+	tx_chip = 60;
+	t1_pri = 300;
+
+	rng_seed();
+
+	const uint32_t epc_base_bits = EPC_BASE_BITS;
+	crc_base_bits = calc_crc(0x0000, (char*)&epc_base_bits, EPC_BASE_LEN / 8);
+
+	// Empty record until the first meter_set()
+	meter_new = 1;
+	do {
+		epc_stage_step();
+	} while(stage_pos);
+}
+
+// Take RX_PIN, TX_PIN and eUSCI_A0 and listen for a reader. If there is no
+// carrier the first timeout puts the tag to sleep until there is
+void tag_start(void) {
+	// Set up RX input
+	P2DIR &= ~RX_PIN;							// Set RX to input
+	P2SEL0 |= RX_PIN;							// Set to TB0.CCR0A
+	P2SEL1 |= RX_PIN;
+
+	// Set up TX output
+	P2SEL0 &= ~TX_PIN;
+	P2SEL1 &= ~TX_PIN;
+	P2DIR |= TX_PIN;
+	P2OUT &= ~TX_PIN;
+
+	UCA0CTLW0 = UCSWRST;						// SPI only sends, DMA0 feeds it
+	UCA0IE = 0;
+
+#if defined (UPLINK_GEN2)
+	clock_hold(1);
+#endif
+	inv_mode = inv_query;
+	rx_low = 0;
+	rx_restart();
+}
+
+// Let go of Timer_B0, eUSCI_A0, DMA0 and both pins (inputs), for whatever
+// uses them next. A reply in progress is cut short
+void tag_stop(void) {
+	__disable_interrupt();
+	TB0CCTL0 = 0;
+	TB0CCTL1 = 0;
+	TB0CTL = TBSSEL_2 + MC_0 + ID_2;
+	DMA0CTL = 0;
+	UCA0CTLW0 = UCSWRST;
+
+	P2IE &= ~RX_PIN;
+	P2IFG &= ~RX_PIN;
+	P2SEL0 &= ~(RX_PIN + TX_PIN);
+	P2SEL1 &= ~(RX_PIN + TX_PIN);
+	P2DIR &= ~TX_PIN;
+	TA0CCTL1 = 0;
+
+	rf_mode = rf_sleep;
+	inv_mode = inv_query;
+	inv_flags = 0;							// As if powered down
+	persist_s1 = 0;
+	persist_off = 0;
+#if defined (UPLINK_GEN2)
+	clock_hold(0);
+#endif
+	__enable_interrupt();
+}
+
+// Act on a finished command. Returns 1 with txBuf and txLen set if it
+// needs a reply
+char cmd_reply(gen2_cmd_t cmd) {
+	uint16_t pos;
+	uint16_t rn;
+
+	switch(cmd) {
+	case cmd_query:
+		if(inv_mode == inv_acked || inv_mode == inv_open) {
+			if(cmd_field(10, 2) == session) {
+				inv_done();
+			}
+		}
+		session = cmd_field(10, 2);
+		if(((inv_flags >> session) & 0x01) != cmd_field(12, 1)) {		// Not our target
+			inv_mode = inv_query;
+			return 0;
+		}
+		if(cmd_field(8, 2) == SEL_SL && !(inv_flags & INV_SL)) {
+			inv_mode = inv_query;
+			return 0;
+		}
+		if(cmd_field(8, 2) == SEL_NOT_SL && (inv_flags & INV_SL)) {
+			inv_mode = inv_query;
+			return 0;
+		}
+		q = cmd_field(13, 4);
+		rng_mix(rt_len ^ query_bittime);		// Reader timing against the DCO
+
+		if(!link_set(cmd_field(4, 1), cmd_field(5, 2), cmd_field(7, 1))) {
+			inv_mode = inv_query;
+			return 0;
+		}
+		return slot_start();
+	case cmd_query_adjust:
+		if(inv_mode == inv_query || cmd_field(4, 2) != session) {
+			return 0;
+		}
+		if(inv_mode == inv_acked || inv_mode == inv_open) {
+			inv_done();
+			return 0;
+		}
+		switch(cmd_field(6, 3)) {
+		case 6:									// Up
+			if(q < 15) {
+				q++;
+			}
+			break;
+		case 3:									// Down
+			if(q > 0) {
+				q--;
+			}
+			break;
+		}
+		return slot_start();
+	case cmd_query_rep:
+		if(inv_mode == inv_query || cmd_field(2, 2) != session) {
+			return 0;
+		}
+		if(inv_mode == inv_acked || inv_mode == inv_open) {
+			inv_done();
+			return 0;
+		}
+		if(inv_mode == inv_ack) {				// Collided or missed, sit out the round
+			inv_wait();
+			return 0;
+		}
+		slot--;
+		return slot_reply();
+	case cmd_nak:
+		if(inv_mode != inv_query) {
+			inv_wait();
+		}
+		return 0;
+	case cmd_ack:
+		rn = cmd_field(2, RN16_LEN);
+		if(((inv_mode == inv_ack || inv_mode == inv_acked) && rn == rn16) ||
+				(inv_mode == inv_open && rn == handle)) {
+			if(inv_mode == inv_ack) {
+				inv_mode = inv_acked;
+			}
+
+			txBuf = epc_buf;
+			txLen = epc_len;
+			tag_reads++;
+
+			P1OUT ^= I_PIN;
+			P1OUT ^= I_PIN;
+			return 1;
+		}
+		if(inv_mode != inv_query && inv_mode != inv_arbitrate) {
+			inv_wait();
+		}
+		return 0;
+	case cmd_req_rn:
+		// The first Req_RN hands out the handle. Once open, each one gets a
+		// new RN16 back and the handle stays as it is
+		rn = cmd_field(8, RN16_LEN);
+		if((inv_mode == inv_acked && rn == rn16) || (inv_mode == inv_open && rn == handle)) {
+			rn = rng_next();
+			if(inv_mode == inv_acked) {
+				inv_mode = inv_open;
+				handle = rn;
+			}
+
+			miller_state_t st;
+			miller_start(reply_buf, &st);
+			miller_put(reply_buf, &st, rn >> 8);
+			miller_put(reply_buf, &st, rn & 0xFF);
+			uint16_t crc = crc16_bits(0x0000, rn, RN16_LEN);
+			miller_put(reply_buf, &st, crc >> 8);
+			miller_put(reply_buf, &st, crc & 0xFF);
+			miller_eos(reply_buf, &st);
+
+			txBuf = reply_buf;
+			txLen = miller_len(&st);
+			return 1;
+		}
+		return 0;
+	case cmd_read:
+		pos = READ_HDR_LEN;
+		uint8_t bank = cmd_field(8, 2);
+		uint16_t ptr = cmd_ebv(&pos);
+		uint8_t count = cmd_field(pos, 8);
+		rn = cmd_field(pos + 8, RN16_LEN);
+		if(inv_mode != inv_open || rn != handle) {
+			return 0;
+		}
+		read_reply(bank, ptr, count);
+		return 1;
+	case cmd_select:
+		select_run();
+		inv_mode = inv_query;
+		return 0;
+	default:		// Bad CRCs and anything unsupported
+		return 0;
+	}
+}
+
+// Reply link from the Query: BLF = DR / TRcal, M from its M field (1 for
+// FM0), and the long pilot only with TRext. Returns 0 if we can't reply on
+// it (BLF out of range) or while the buffers are still being staged at a
+// new M; the tag sits the round out
+char link_set(uint8_t dr, uint8_t m, uint8_t trext) {
+	uint16_t chip;
+	uint16_t pri;
+
+	// TRcal is in timer ticks of 4 SMCLK cycles, and Tpri = TRcal / DR
+	if(dr) {									// DR = 64/3
+		chip = (3 * tr_len + 16) >> 5;
+		pri = (15 * tr_len + 16) >> 5;
+	}
+	else {										// DR = 8
+		chip = (tr_len + 2) >> 2;
+		pri = (5 * tr_len + 2) >> 2;
+	}
+	if(chip < CHIP_MIN || chip > CHIP_MAX) {
+		return 0;
+	}
+	tx_chip = chip;
+	t1_pri = pri;
+
+	m = 1 << m;
+	if(m != miller_m) {							// Restage both buffers at the new M
+		miller_m = m;
+		stage_pos = 0;
+		meter_new = 1;
+	}
+	tx_skip = trext ? 0 : miller_pilot_skip();
+	return epc_m == miller_m;
+}
+
+// Pick a slot in 0..2^Q-1
+char slot_start(void) {
+	slot = rng_next() & ((1 << q) - 1);
+	return slot_reply();
+}
+
+// Reply with a new RN16 once the slot counter reaches 0
+char slot_reply(void) {
+	if(slot != 0) {
+		inv_mode = inv_arbitrate;
+		return 0;
+	}
+
+	inv_mode = inv_ack;	// Prepare for next R->T
+	rn16 = rng_next();
+
+	miller_state_t st;
+	miller_hdr_tail(&st);
+	miller_put(rn16_buf, &st, rn16 >> 8);
+	miller_put(rn16_buf, &st, rn16 & 0xFF);
+	miller_eos(rn16_buf, &st);
+
+	txBuf = rn16_buf;
+	txLen = miller_len(&st);
+	return 1;
+}
+
+// Stay in the round without replying until the next Query or QueryAdjust
+void inv_wait(void) {
+	slot = 0x7FFF;
+	inv_mode = inv_arbitrate;
+}
+
+// Read in this round, flip the flag so the next round looks for the other
+void inv_done(void) {
+	uint8_t before = inv_flags;
+	inv_flags ^= 1 << session;
+	inv_mode = inv_query;
+	persist_update(before);
+}
+
+// S1 going to B starts its timer, S1 back at A stops it
+void persist_update(uint8_t before) {
+	if(!(inv_flags & INV_S1)) {
+		persist_s1 = 0;
+	}
+	else if(!(before & INV_S1)) {
+		persist_s1 = PERSIST_S1;
+		persist_run();
+	}
+}
+
+// Tick every PERSIST_TICK while either timer counts, TIMERA0_IV_ISR stops
+void persist_run(void) {
+	if(!(TA0CCTL1 & CCIE)) {
+		TA0CCR1 = TA0R + PERSIST_TICK;
+		TA0CCTL1 = CCIE;
+	}
+}
+
+// Select: what the Action does to the flag if the mask matches (high
+// nibble) or not (low nibble). SEL_A asserts SL or sets the inventoried
+// flag to A, SEL_B deasserts SL or sets B
+#define SEL_A		1
+#define SEL_B		2
+#define SEL_NEGATE	3
+
+static const uint8_t select_actions[8] = {
+	0x12, 0x10, 0x02, 0x30, 0x21, 0x20, 0x01, 0x03
+};
+
+// Select from cmd_buf: Target, Action and MemBank, then the Pointer EBV,
+// Length and Mask. Truncate is ignored, the whole EPC is always sent
+void select_run(void) {
+	uint16_t pos = SELECT_HDR_LEN;
+	uint8_t target = cmd_field(4, 3);
+	uint8_t act = select_actions[cmd_field(7, 3)];
+	uint8_t bank = cmd_field(10, 2);
+	uint16_t ptr = cmd_ebv(&pos);
+	uint8_t len = cmd_field(pos, 8);
+	uint8_t before = inv_flags;
+	uint8_t flag;
+
+	if(target == SEL_TARGET_SL) {
+		flag = INV_SL;
+	}
+	else if(target < SEL_TARGET_SL) {
+		flag = 1 << target;
+	}
+	else {
+		return;									// RFU
+	}
+
+	act = select_match(bank, ptr, len, pos + 8) ? act >> 4 : act & 0x0F;
+	if(act == SEL_NEGATE) {
+		inv_flags ^= flag;
+	}
+	else if((act == SEL_A) == (flag == INV_SL)) {	// SL asserted or B
+		inv_flags |= flag;
+	}
+	else if(act) {
+		inv_flags &= ~flag;
+	}
+	persist_update(before);
+}
+
+// Length bits of a bank from bit Pointer against the Mask at bit pos of
+// cmd_buf, a word at a time. Bits past the end of the bank don't match
+char select_match(uint8_t bank, uint16_t ptr, uint8_t len, uint16_t pos) {
+	if((uint32_t)ptr + len > (uint32_t)mem_size(bank) * 16) {
+		return 0;
+	}
+	while(len) {
+		uint8_t n = 16 - (ptr & 0x0F);			// Bits left in this word
+		if(n > len) {
+			n = len;
+		}
+		uint16_t word = mem_word(bank, ptr >> 4) >> (16 - (ptr & 0x0F) - n);
+		if((word ^ cmd_field(pos, n)) & (0xFFFF >> (16 - n))) {
+			return 0;
+		}
+		ptr += n;
+		pos += n;
+		len -= n;
+	}
+	return 1;
+}
+
+// Read reply: header '0', the words, handle and CRC-16. A bad range gets
+// header '1' and an error code instead of the words
+void read_reply(uint8_t bank, uint16_t ptr, uint8_t count) {
+	miller_state_t st;
+	uint16_t crc;
+	uint16_t size = mem_size(bank);
+	uint8_t err = ERR_OTHER;
+
+	if(ptr >= size) {
+		err = ERR_OVERRUN;
+		count = 0;
+	}
+	else {
+		if(count == 0) {					// Zero reads to the end of the bank
+			count = size - ptr;
+		}
+		if(count > size - ptr) {
+			err = ERR_OVERRUN;
+			count = 0;
+		}
+	}
+
+	miller_start(reply_buf, &st);
+	if(count) {
+		miller_bit(reply_buf, &st, 0);
+		crc = crc16_bits(0x0000, 0, 1);
+		while(count--) {
+			uint16_t word = mem_word(bank, ptr++);
+			miller_put(reply_buf, &st, word >> 8);
+			miller_put(reply_buf, &st, word & 0xFF);
+			crc = crc16_bits(crc, word, 16);
+		}
+	}
+	else {
+		miller_bit(reply_buf, &st, 1);
+		miller_put(reply_buf, &st, err);
+		crc = crc16_bits(0x0000, 1, 1);
+		crc = crc16_bits(crc, err, 8);
+	}
+	miller_put(reply_buf, &st, handle >> 8);
+	miller_put(reply_buf, &st, handle & 0xFF);
+	crc = crc16_bits(crc, handle, RN16_LEN);
+	miller_put(reply_buf, &st, crc >> 8);
+	miller_put(reply_buf, &st, crc & 0xFF);
+	miller_eos(reply_buf, &st);
+
+	txBuf = reply_buf;
+	txLen = miller_len(&st);
+}
+
+// Words in a memory bank
+uint16_t mem_size(uint8_t bank) {
+	switch(bank) {
+	case BANK_EPC:
+		return 1 + EPC_LEN / 16;
+	case BANK_USER:
+		return METER_WORDS;
+	default:
+		return 0;
+	}
+}
+
+// EPC bank: StoredCRC, PC, marker, then the record in the EPC tail.
+// User memory: the whole record behind that EPC
+uint16_t mem_word(uint8_t bank, uint16_t ptr) {
+	if(bank == BANK_USER) {
+		return meter_word(&meter_epc, ptr);
+	}
+	switch(ptr) {
+	case 0:
+		return crc_bits;
+	case 1:
+		return EPC_PC;
+	case 2:
+		return EPC_MARKER;
+	default:
+		ptr = (ptr - 3) * 2;
+		return ((uint16_t)meter_tail_byte(&meter_epc, ptr) << 8) | meter_tail_byte(&meter_epc, ptr + 1);
+	}
+}
+
+// One step of encoding a new record into the EPC tail: a record byte each,
+// then the CRC and EOS, then the copy into epc_buf. Called where the tag is
+// idle (end of a reply, RX timeout, a command we don't answer) and never
+// while epc_buf is going out. Until the copy an ACK gets the previous
+// record, so neither the ACK nor the Read path ever encode anything. The
+// copy waits until no reader holds the tag, so the EPC and user memory it
+// reads stay the same record. After a new M the copy also brings in that
+// M's template and header
+void epc_stage_step(void) {
+	uint8_t data;
+
+	if(stage_pos == 0) {
+		if(!meter_new) {
+			return;
+		}
+		meter_new = 0;
+		meter_stage = meter;
+		stage_crc = crc_base_bits;
+		miller_epc_tail(&stage_st);
+		if(stage_st.fill) {							// Template bits in the first byte
+			stage_buf[0] = miller_template()[stage_st.index];
+		}
+		stage_st.index = 0;
+	}
+
+	if(stage_pos < EPC_TAIL_LEN / 8) {
+		data = meter_tail_byte(&meter_stage, stage_pos);
+		miller_put(stage_buf, &stage_st, data);
+		stage_crc = calc_crc(stage_crc, (char*)&data, 1);
+		stage_pos++;
+	}
+	else if(stage_pos == EPC_TAIL_LEN / 8) {
+		miller_put(stage_buf, &stage_st, stage_crc >> 8);
+		miller_put(stage_buf, &stage_st, stage_crc & 0xFF);
+		miller_eos(stage_buf, &stage_st);
+		stage_pos++;
+	}
+	else if(inv_mode != inv_acked && inv_mode != inv_open) {	// Hold still while a reader has us
+		miller_state_t st;
+		miller_epc_tail(&st);
+		uint16_t base = st.index;
+		if(epc_m != miller_m) {
+			memcpy(epc_buf, miller_template(), base);
+			miller_start(rn16_buf, &st);
+			epc_m = miller_m;
+			epc_len = miller_epc_len();
+		}
+		memcpy(epc_buf + base, stage_buf, epc_len - base);
+		meter_epc = meter_stage;
+		crc_bits = stage_crc;
+		stage_pos = 0;
+	}
+}
+
+#pragma vector=TIMERB0_VECTOR
+__interrupt void TIMER_B (void) {
+
+	uint16_t bittime;
+
+	// Clear interrupt
+	TB0CCTL0 &= ~CCIFG;
+
+	// Indicate RX
+	//LED2_OUT ^= LED2_PIN;
+
+	switch(rf_mode) {
+	case rf_idle:
+		TB0CTL |= TBCLR;
+		rf_mode = rf_inInv_d0;
+		break;
+	case rf_inInv_d0:
+		rf_mode = rf_inInv_RTCal;
+		d0_len = TB0CCR0;
+		rt_len = TB0CCR0;
+		break;
+	case rf_inInv_RTCal:
+		rf_mode = rf_inInv_TRCal;
+		rt_len = TB0CCR0 - rt_len;
+		rt_pivot = rt_len >> 1;
+		query_bittime = TB0CCR0;
+		cmd_start();
+		break;
+	case rf_inInv_TRCal:
+	case rf_inInv_query:
+		bittime = TB0CCR0 - query_bittime;
+		query_bittime = TB0CCR0;
+		if(rf_mode == rf_inInv_TRCal) {
+			rf_mode = rf_inInv_query;
+			if(bittime > rt_len) {		// TRcal, only a Query has the full preamble
+				tr_len = bittime;
+				break;
+			}
+		}
+
+		cmd_cur <<= 1;
+		if(bittime > rt_pivot) {		// Received a '1'
+			cmd_cur |= 0x01;
+			cmd_crc16 ^= 0x8000;
+			cmd_crc5 ^= 0x80;
+		}
+		cmd_crc16 = (cmd_crc16 & 0x8000) ? (cmd_crc16 << 1) ^ P_CCITT : cmd_crc16 << 1;
+		cmd_crc5 = (cmd_crc5 & 0x80) ? (cmd_crc5 << 1) ^ CRC5_POLY : cmd_crc5 << 1;
+		cmd_count++;
+		if(!(cmd_count & 7) && cmd_count <= CMD_BUF_LEN * 8) {
+			cmd_buf[(cmd_count >> 3) - 1] = cmd_cur;
+		}
+
+		if(cmd_count == cmd_len) {
+			gen2_cmd_t cmd = cmd_step();
+			if(cmd == cmd_none) {
+				break;
+			}
+			if(cmd_reply(cmd)) {
+				rf_mode = rf_inInv_reply;
+
+				// Switch to replying mode, T1 counts from the last edge
+				TB0CCTL0 = 0;	// Turn off capture
+				bittime = rt_len > t1_pri ? rt_len : t1_pri;
+				TB0CCR1 = query_bittime + bittime;
+				TB0CCTL1 = CCIE;
+				if((uint16_t)(TB0R - query_bittime) >= bittime) {
+					TB0CCTL1 |= CCIFG;		// Reply took longer to build than T1
+				}
+			}
+			else {
+				rf_mode = rf_idle;
+				epc_stage_step();			// Nothing comes before T1 is up
+			}
+		}
+		break;
+	}
+
+	if(rf_mode != rf_inInv_reply) {
+		// Stalve timeout
+		TB0CCR1 = TB0R + RF_TIMEOUT;
+		TB0CCTL1 = CCIE;
+		rx_low = 0;
+	}
+}
+
+// Shift a reply out of UCA0SIMO (TX_PIN) in SPI master mode, LSB first.
+// DMA0 refills UCA0TXBUF on each UCA0TXIFG, so the CPU sleeps through the
+// reply and every bit lasts exactly tx_chip SMCLK cycles. SPI mode has no
+// TX complete interrupt, so the end is a CCR1 compare, see DMA_ISR
+void tx_start(const char* buf, uint16_t len) {
+	UCA0CTLW0 = UCSWRST;
+	UCA0CTLW0 |= UCMST + UCSYNC + UCSSEL_2;		// 3-pin SPI master from SMCLK
+	UCA0BRW = tx_chip;
+
+	P2SEL0 &= ~TX_PIN;							// TX_PIN to UCA0SIMO
+	P2SEL1 |= TX_PIN;
+
+	DMACTL0 = DMA0TSEL_15;						// Trigger on UCA0TXIFG
+	__data16_write_addr((unsigned short)&DMA0SA, (unsigned long)buf);
+	__data16_write_addr((unsigned short)&DMA0DA, (unsigned long)&UCA0TXBUF);
+	DMA0SZ = len;
+	DMA0CTL = DMADT_0 + DMASRCINCR_3 + DMASRCBYTE + DMADSTBYTE + DMAIE + DMAEN;
+
+	UCA0CTLW0 &= ~UCSWRST;						// UCA0TXIFG rises and starts the DMA
+}
+
+// Back to waiting for the next reader command
+void rx_restart(void) {
+	TB0CCTL1 = 0;						// Disable interrupt
+
+	// Restore idle state (Set up timer capture)
+	TB0CCTL0 = CM_1 + CCIS_0 + CAP;  	// Capture on rising edge for preamble
+	TB0CCTL0 &= ~CCIFG;
+	TB0CTL = TBSSEL_2 + MC_2 + TBCLR + ID_2;
+	TB0CCTL0 |= CCIE;
+	rf_mode = rf_idle;
+	TB0CCR1 = RF_TIMEOUT;
+	TB0CCTL1 = CCIE;
+}
+
+// No carrier: stop TB0 so nothing requests SMCLK and the DCO can stop in
+// LPM4 (LPM3 in the metering image, which keeps ACLK), and let a port interrupt on RX_PIN catch the carrier coming back.
+// The round is lost with the field, as if the tag had powered down: S0
+// goes now, S2, S3 and SL after PERSIST_OFF, and S1 keeps counting
+void rx_sleep(void) {
+	TB0CCTL0 = 0;
+	TB0CCTL1 = 0;
+	TB0CTL = TBSSEL_2 + MC_0 + ID_2;
+
+	P2SEL0 &= ~RX_PIN;						// RX_PIN to GPIO input
+	P2SEL1 &= ~RX_PIN;
+	P2IES &= ~RX_PIN;						// Rising edge
+	P2IFG &= ~RX_PIN;
+	P2IE |= RX_PIN;
+
+	rf_mode = rf_sleep;
+	inv_mode = inv_query;
+	inv_flags &= ~INV_S0;
+	if(inv_flags & (INV_S2_S3 | INV_SL)) {
+		persist_off = PERSIST_OFF;
+		persist_run();
+	}
+#if defined (UPLINK_GEN2)
+	clock_hold(0);
+#endif
+}
+
+#pragma vector=TIMERB1_VECTOR
+__interrupt void TIMER_B1 (void) {
+
+	if(rf_mode == rf_inInv_reply) {
+		const char *buf = txBuf + tx_skip;	// Without TRext, start past the long pilot
+		uint16_t len = txLen - tx_skip;
+		TB0CCTL1 = 0;						// No timeout while replying
+
+#ifdef TX_BITBANG
+		// Old busy-wait transmit, kept to compare bit timing on a scope. Whole
+		// timer ticks only, so BLF is rounded to 6MHz / 2n
+		uint16_t timerVal = TB0CCR1;
+		uint16_t txBitCount = 0;
+		uint16_t txBitLen = len * 8;
+
+		__disable_interrupt();
+
+		while(txBitCount < txBitLen) {
+			timerVal += tx_chip >> 2;
+
+			uint16_t txIndex = txBitCount / 8; 			// Which byte
+			char bitMask = 1 << (txBitCount % 8);		// Bit mask
+			char set = buf[txIndex] & bitMask;
+
+			if(set) {
+				P2OUT |= TX_PIN;
+				P2OUT |= TX_PIN;
+			}
+			else {
+				P2OUT &= ~TX_PIN;
+				P2OUT &= ~TX_PIN;
+			}
+
+			txBitCount++;
+
+			while((int16_t)(TB0R - timerVal) < 0) {		// Long replies wrap TB0R
+				_nop();
+			}
+		}
+
+		rx_restart();
+
+		__enable_interrupt();
+#else
+		tx_start(buf, len);
+#endif
+	}
+	else if(rf_mode == rf_inInv_txEnd) {
+		if(UCA0STATW & UCBUSY) {			// A tick early, wait out the bit
+			TB0CCR1 += tx_chip >> 2;
+			TB0CCTL1 = CCIE;
+			return;
+		}
+		P2SEL1 &= ~TX_PIN;					// TX_PIN back to GPIO (low)
+		UCA0CTLW0 = UCSWRST;
+		rx_restart();
+	}
+	else {		// Timeout
+		rf_mode = rf_idle;
+		P1OUT ^= I_PIN;
+		epc_stage_step();
+
+		// Under CW a command can start at any time, so keep the timer and
+		// look again later, sooner while a record is being staged. RX_PIN
+		// low for two checks in a row is no carrier: the reader is gone
+		if(P2IN & RX_PIN) {
+			rx_low = 0;
+			TB0CCR1 += (stage_pos || meter_new) ? RF_TIMEOUT : RX_CW_CHECK;
+			TB0CCTL1 = CCIE;				// Clears CCIFG
+		}
+		else if(!rx_low) {
+			rx_low = 1;
+			TB0CCR1 += RX_LOW_CHECK;
+			TB0CCTL1 = CCIE;
+		}
+		else {
+			rx_sleep();
+#if !defined (UPLINK_GEN2)
+			// LPM3 keeps ACLK while a persistence timer counts
+			__bis_SR_register_on_exit((persist_s1 || persist_off) ? LPM3_bits : LPM4_bits);
+#endif
+		}
+	}
+}
+
+// Carrier back, this edge is the start of the reader's settling time (at
+// least 1.5ms of CW before the first command), so there is time to wake
+#pragma vector=PORT2_VECTOR
+__interrupt void PORT2_ISR (void) {
+	P2IE &= ~RX_PIN;
+	P2IFG &= ~RX_PIN;
+	P2SEL0 |= RX_PIN;						// Back to TB0.CCR0A
+	P2SEL1 |= RX_PIN;
+#if defined (UPLINK_GEN2)
+	clock_hold(1);
+#endif
+	rx_restart();
+	rx_low = 0;
+	persist_off = 0;						// Powered again, S2, S3 and SL stay
+	__bic_SR_register_on_exit(SCG1 + OSCOFF);	// LPM1, SMCLK runs TB0 again
+}
+
+// Persistence tick, through LPM3 with the carrier off. With nothing left to
+// count the timer stops, and the standalone tag goes on down to LPM4
+#pragma vector=TIMER0_A1_VECTOR
+__interrupt void TIMERA0_IV_ISR (void) {
+
+	switch (__even_in_range(TA0IV, 14)) {
+	case 2:									// CCR1
+		if(persist_s1 && !--persist_s1) {
+			inv_flags &= ~INV_S1;
+		}
+		if(persist_off && !--persist_off) {
+			inv_flags &= ~(INV_S2_S3 | INV_SL);
+		}
+		if(persist_s1 || persist_off) {
+			TA0CCR1 += PERSIST_TICK;
+			break;
+		}
+		TA0CCTL1 = 0;
+#if !defined (UPLINK_GEN2)
+		if(rf_mode == rf_sleep) {
+			__bis_SR_register_on_exit(LPM4_bits);
+		}
+#endif
+		break;
+	default:
+		break;
+	}
+}
+
+#pragma vector=DMA_VECTOR
+__interrupt void DMA_ISR (void) {
+
+	switch (__even_in_range(DMAIV, 16)) {
+	case 0:
+		break;								// No interrupt
+	case 2:									// DMA0, last byte is in UCA0TXBUF
+		// At most two bytes left to shift out, 16 bits of tx_chip SMCLK
+		// cycles each. TIMER_B1 hands the pin back then
+		rf_mode = rf_inInv_txEnd;
+		TB0CCR1 = TB0R + (tx_chip << 2) + 1;
+		TB0CCTL1 = CCIE;
+		epc_stage_step();					// DMA is done with the buffers
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,29 @@
+#ifndef TAG_H_
+#define TAG_H_
+
+#include <stdint.h>
+
+/**************************************************************************
+   TAG SECTION
+ **************************************************************************/
+// Gen2 tag on Timer_B0, eUSCI_A0 and DMA0, run entirely from their ISRs.
+// The reader's PIE edges come in on RX_PIN (TB0.CCI0A) and replies go out
+// on TX_PIN (UCA0SIMO). Needs SMCLK = 24MHz while a carrier is up, and
+// TA0 counting ACLK continuously: TA0.CCR1 times the inventoried flags.
+//
+// main.c here runs it on its own. With UPLINK_GEN2 it is built into the
+// metering image (low_power) as one of its uplinks, see uplink.h. It then
+// shares the MCU: the carrier holds the clock (clock_hold()) and the main
+// loop picks the low power mode
+#define RX_PIN		BIT1
+#define TX_PIN		BIT0
+
+#define I_PIN		BIT3
+
+uint16_t tag_reads;		// EPC replies sent, free running
+
+void tag_init(void);
+void tag_start(void);
+void tag_stop(void);
+
+#endif // TAG_H_
@@ -2,10 +2,14 @@
 // {BLE Address: Most recent sequence number} for each PowerBlade
 var powerblade_sequences = {};
 var powerblade_last_seens = {};
+// {BLE Address: last data packet, its scaling and output} to apply the
+//  history in the scan response to
+var powerblade_packets = {};
 var cleanup_timer = null;
 var CLEANUP_INTERVAL = 1*60*1000;
 
 var OLD_COMPANY_ID = 0x4908;
+var HISTORY_SERVICE_ID = 0x91;
 
 var parse_advertisement = function (advertisement, cb) {
 
@@ -16,6 +20,14 @@ var parse_advertisement = function (advertisement, cb) {
 
     // check for a valid advertisement packet
     if (advertisement.manufacturerData) {
+        // scan response with earlier seconds, for the last data packet
+        if (advertisement.manufacturerData.length >= 3 &&
+                advertisement.manufacturerData.readUIntLE(0,2) != OLD_COMPANY_ID &&
+                advertisement.manufacturerData[2] == HISTORY_SERVICE_ID) {
+            cb(parse_history(advertisement.advertiser_id, advertisement.manufacturerData.slice(3)));
+            return;
+        }
+
         if (advertisement.manufacturerData.length >= 19) {
 
             var company_id = advertisement.manufacturerData.readUIntLE(0,2);
@@ -99,6 +111,14 @@ var parse_advertisement = function (advertisement, cb) {
 					flags: flags
                 }
 
+                powerblade_packets[address] = {
+                    sequence_number: sequence_num,
+                    volt_scale: volt_scale,
+                    power_scale: power_scale,
+                    out: out,
+                    history_sent: false,
+                };
+
                 cb(out);
                 return;
             }
@@ -108,6 +128,44 @@ var parse_advertisement = function (advertisement, cb) {
     cb(null);
 }
 
+// Recent seconds from the scan response, newest first. The first byte is
+//  the low byte of the sequence number of the data packet it goes with,
+//  then five bytes per earlier second: V_RMS, real power, and apparent
+//  power, big-endian as in the data packet. Returns that packet's output
+//  with the history added, once, or null
+var HISTORY_ENTRY_LEN = 5;
+var parse_history = function (address, data) {
+    var packet = powerblade_packets[address];
+
+    // scan response must belong to the last advertisement heard
+    if (!packet || packet.history_sent || data.length < 1 ||
+            data[0] != (packet.sequence_number & 0xFF)) {
+        return null;
+    }
+    packet.history_sent = true;
+
+    var history = [];
+    var index;
+    for (index = 1; index + HISTORY_ENTRY_LEN <= data.length; index += HISTORY_ENTRY_LEN) {
+        history.push({
+            sequence_number: packet.sequence_number - 1 - history.length,
+            rms_voltage: (data.readUIntBE(index,1)*packet.volt_scale).toFixed(2),
+            power: (data.readUIntBE(index+1,2)*packet.power_scale).toFixed(2),
+            apparent_power: (data.readUIntBE(index+3,2)*packet.power_scale).toFixed(2),
+        });
+    }
+    if (history.length == 0) {
+        return null;
+    }
+
+    var out = {};
+    for (var key in packet.out) {
+        out[key] = packet.out[key];
+    }
+    out.history = history;
+    return out;
+}
+
 var cleanup_powerblades = function () {
     var curr_time = (new Date).getTime()/1000;
 
@@ -116,6 +174,7 @@ var cleanup_powerblades = function () {
         if ((curr_time - powerblade_last_seens[powerblade]) > 10) {
             delete powerblade_sequences[powerblade];
             delete powerblade_last_seens[powerblade];
+            delete powerblade_packets[powerblade];
         }
     }
 }